@@ -0,0 +1,496 @@
+/**
+ * @file bej_bench.c
+ * @brief Throughput benchmark suite
+ *
+ * Generates a batch of synthetic payloads and times each stage of the
+ * pipeline over the batch:
+ *
+ *   load            map a file
+ *   decode          decode into trees on the heap
+ *   decode_arena    decode into trees in an arena
+ *   validate        check the framing up front
+ *   decode_trusted  decode checked messages into an arena, no bounds checks
+ *   free            free the trees
+ *   emit            write the trees as JSON
+ *   transcode       stream BEJ to JSON without a tree
+ *   query           decode only the last leaf member of the root by path
+ *   decode_proj     decode with a projection selecting that leaf
+ *   push            push decoding in 64-byte chunks, as they arrive from MCTP
+ *   decode_par      decode with the root members split across threads
+ *   transcode_par   transcode with the root members split across threads
+ *   cache_hit       JSON text of repeated payloads from the decode cache
+ *   diff            compare against a copy with the queried leaf modified
+ *   end_to_end      map, decode, emit, free and unmap per message
+ *
+ * Every stage reports the best of several rounds as MB/s of BEJ input,
+ * messages per second and decoder allocations per message, as a table,
+ * CSV or JSON lines for tracking regressions.
+ *
+ * Usage: bej_bench [--depth N] [--fanout N] [--set-every N] [--strings PCT]
+ *                  [--string-len N] [--size BYTES[k|m]] [--messages N]
+ *                  [--rounds N] [--threads N] [--format text|csv|json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/bej_parse.h"
+#include "../include/bej_transcode.h"
+#include "../include/bej_query.h"
+#include "../include/bej_push.h"
+#include "../include/bej_parallel.h"
+#include "../include/bej_cache.h"
+#include "../include/bej_diff.h"
+#include "../include/bej_project.h"
+#include "../include/bej_validate.h"
+#include "bench_payload.h"
+
+#define BENCH_TEXT 0
+#define BENCH_CSV 1
+#define BENCH_JSON 2
+#define BENCH_PATH_SIZE 32
+#define BENCH_CHUNK 64
+
+/*result of one stage*/
+typedef struct BenchResult
+{
+  const char *name;
+  double seconds;      /*best round*/
+  size_t bytes;        /*BEJ bytes per round*/
+  uint32_t messages;   /*messages per round*/
+  uint64_t allocations; /*decoder allocations per round*/
+} BenchResult;
+
+/**
+ * @brief Returns a monotonic timestamp in seconds
+ */
+static double now_s(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Parses a byte count with an optional k or m suffix
+ */
+static size_t parse_size(const char *text)
+{
+  char *end;
+  size_t size = (size_t)strtoull(text, &end, 10);
+  if (*end == 'k' || *end == 'K') size <<= 10;
+  else if (*end == 'm' || *end == 'M') size <<= 20;
+  return size;
+}
+
+/**
+ * @brief Keeps the fastest round of a stage
+ */
+static void record(BenchResult *result, double seconds)
+{
+  if (result->seconds == 0 || seconds < result->seconds)
+    result->seconds = seconds;
+}
+
+/**
+ * @brief Prints one result
+ */
+static void print_result(const BenchResult *r, const BenchPayloadConfig *config,
+                         uint32_t root_fanout, int format)
+{
+  double mb_s = (double)r->bytes / r->seconds / 1e6;
+  double msgs_s = r->messages / r->seconds;
+  double allocs = (double)r->allocations / r->messages;
+
+  if (format == BENCH_CSV)
+  {
+    printf("%s,%u,%u,%u,%u,%u,%u,%u,%zu,%.6f,%.2f,%.1f,%.2f\n", r->name, config->depth,
+           config->fanout, root_fanout, config->set_every, config->string_pct,
+           config->string_len, r->messages, r->bytes, r->seconds, mb_s, msgs_s, allocs);
+  }
+  else if (format == BENCH_JSON)
+  {
+    printf("{\"benchmark\":\"%s\",\"depth\":%u,\"fanout\":%u,\"root_fanout\":%u,"
+           "\"set_every\":%u,\"string_pct\":%u,\"string_len\":%u,\"messages\":%u,"
+           "\"bytes\":%zu,\"seconds\":%.6f,\"mb_per_s\":%.2f,\"msgs_per_s\":%.1f,"
+           "\"allocs_per_msg\":%.2f}\n", r->name, config->depth, config->fanout,
+           root_fanout, config->set_every, config->string_pct, config->string_len,
+           r->messages, r->bytes, r->seconds, mb_s, msgs_s, allocs);
+  }
+  else
+  {
+    printf("%-14s %12.1f %14.0f %14.1f\n", r->name, mb_s, msgs_s, allocs);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  BenchPayloadConfig config = {3, 8, 4, 50, 16, 0};
+  uint32_t messages = 1000;
+  int rounds = 5;
+  uint32_t threads = 0;
+  int format = BENCH_TEXT;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!value)
+    {
+      fprintf(stderr, "missing value for %s\n", argv[i]);
+      return 2;
+    }
+    if (strcmp(argv[i], "--depth") == 0) config.depth = (uint32_t)atoi(value);
+    else if (strcmp(argv[i], "--fanout") == 0) config.fanout = (uint32_t)atoi(value);
+    else if (strcmp(argv[i], "--set-every") == 0) config.set_every = (uint32_t)atoi(value);
+    else if (strcmp(argv[i], "--strings") == 0) config.string_pct = (uint32_t)atoi(value);
+    else if (strcmp(argv[i], "--string-len") == 0) config.string_len = (uint32_t)atoi(value);
+    else if (strcmp(argv[i], "--size") == 0) config.size = parse_size(value);
+    else if (strcmp(argv[i], "--messages") == 0) messages = (uint32_t)atoi(value);
+    else if (strcmp(argv[i], "--rounds") == 0) rounds = atoi(value);
+    else if (strcmp(argv[i], "--threads") == 0) threads = (uint32_t)atoi(value);
+    else if (strcmp(argv[i], "--format") == 0)
+    {
+      if (strcmp(value, "csv") == 0) format = BENCH_CSV;
+      else if (strcmp(value, "json") == 0) format = BENCH_JSON;
+      else format = BENCH_TEXT;
+    }
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+    i++;
+  }
+  if (messages == 0) messages = 1;
+  if (rounds < 1) rounds = 1;
+
+  BenchPayload payload;
+  BejEncoder enc;
+  size_t *offsets = malloc(sizeof(size_t) * ((size_t)messages + 1));
+  BejSet **trees = malloc(sizeof(BejSet *) * messages);
+  if (!offsets || !trees || bench_payload_init(&payload, &config) != 0 ||
+      bej_encoder_init(&enc, 1 << 20) != 0)
+    return 1;
+
+  for (uint32_t m = 0; m < messages; m++)
+  {
+    offsets[m] = enc.len;
+    bench_payload_generate(&payload, &enc, m);
+  }
+  offsets[messages] = enc.len;
+  if (enc.error != BEJ_OK)
+    return 1;
+
+  /* load and end_to_end read the first message from a file */
+  char file[] = "/tmp/bej_bench_XXXXXX";
+  int fd = mkstemp(file);
+  if (fd < 0 || write(fd, enc.buf, offsets[1]) != (ssize_t)offsets[1])
+    return 1;
+  close(fd);
+
+  BenchResult load = {"load", 0, offsets[1] * messages, messages, 0};
+  BenchResult decode = {"decode", 0, enc.len, messages, 0};
+  BenchResult decode_arena = {"decode_arena", 0, enc.len, messages, 0};
+  BenchResult validate = {"validate", 0, enc.len, messages, 0};
+  BenchResult decode_trusted = {"decode_trusted", 0, enc.len, messages, 0};
+  BenchResult release = {"free", 0, enc.len, messages, 0};
+  BenchResult emit = {"emit", 0, enc.len, messages, 0};
+  BenchResult transcode = {"transcode", 0, enc.len, messages, 0};
+  BenchResult query = {"query", 0, enc.len, messages, 0};
+  BenchResult decode_projected = {"decode_proj", 0, enc.len, messages, 0};
+  BenchResult push = {"push", 0, enc.len, messages, 0};
+  BenchResult decode_parallel = {"decode_par", 0, enc.len, messages, 0};
+  BenchResult transcode_parallel = {"transcode_par", 0, enc.len, messages, 0};
+  BenchResult cache_hit = {"cache_hit", 0, enc.len, messages, 0};
+  BenchResult diff = {"diff", 0, enc.len, messages, 0};
+  BenchResult end_to_end = {"end_to_end", 0, offsets[1] * messages, messages, 0};
+
+  /* The last root member that is not a SET, every sibling before it is skipped */
+  char path[BENCH_PATH_SIZE] = "/";
+  for (uint32_t id = payload.root_fanout; id > 0; id--)
+  {
+    if (payload.members[id - 1].type != BEJ_SET)
+    {
+      snprintf(path, sizeof(path), "/%s", payload.members[id - 1].name);
+      break;
+    }
+  }
+
+  BejProjection projection;
+  const char *selected = path;
+  if (bej_projection_compile(&projection, payload.members, &selected, 1) != BEJ_OK)
+    return 1;
+
+  JsonWriter w;
+  BejArena arena;
+  BejDecoder ctx;
+  BejPushDecoder pusher;
+  BejSaxCallbacks no_events = {0};
+  bej_push_init(&pusher, payload.root, &no_events, NULL);
+  if (json_writer_init_buffer(&w, JSON_COMPACT) != 0)
+    return 1;
+  bej_arena_init(&arena, 0);
+  BejDecodeCache cache;
+  if (bej_cache_init(&cache, messages, JSON_COMPACT) != 0)
+    return 1;
+
+  /* Same messages with the last byte of the queried leaf flipped */
+  uint8_t *changed = malloc(enc.len);
+  if (!changed)
+    return 1;
+  memcpy(changed, enc.buf, enc.len);
+  for (uint32_t m = 0; m < messages; m++)
+  {
+    uint16_t id;
+    uint8_t type;
+    uint32_t length;
+    bej_decoder_init(&ctx, changed + offsets[m], offsets[m + 1] - offsets[m]);
+    if (bej_query_locate(&ctx, payload.root, path, NULL) != BEJ_OK || !bej_read_tag(&ctx, &id, &type) ||
+        !bej_read_length(&ctx, &length) || length == 0)
+      return 1;
+    changed[ctx.cursor - changed + length - 1] ^= 1;
+  }
+
+  uint64_t check = 0;
+  for (int r = 0; r < rounds; r++)
+  {
+    double start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      BejMapping map;
+      if (bej_map_file(file, &map) != BEJ_OK)
+        return 1;
+      /* Touch every page so the mapping cost is included */
+      for (size_t i = 0; i < map.size; i += 4096)
+        check += map.data[i];
+      bej_unmap_file(&map);
+    }
+    record(&load, now_s() - start);
+
+    uint64_t allocations = 0;
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      trees[m] = bej_read_value(&ctx, payload.root);
+      if (!trees[m])
+        return 1;
+      allocations += ctx.stats.allocations;
+    }
+    record(&decode, now_s() - start);
+    decode.allocations = allocations;
+
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      w.len = 0;
+      bej_to_json_writer(trees[m], payload.members, &w);
+      check += w.len;
+    }
+    record(&emit, now_s() - start);
+
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+      bej_free(trees[m]);
+    record(&release, now_s() - start);
+
+    allocations = 0;
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_arena_reset(&arena);
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      ctx.arena = &arena;
+      if (!bej_read_value(&ctx, payload.root))
+        return 1;
+      allocations += ctx.stats.allocations;
+    }
+    record(&decode_arena, now_s() - start);
+    decode_arena.allocations = allocations;
+
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      if (bej_validate(&ctx) != BEJ_OK)
+        return 1;
+    }
+    record(&validate, now_s() - start);
+
+    allocations = 0;
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_arena_reset(&arena);
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      ctx.arena = &arena;
+      ctx.flags = BEJ_DECODE_TRUSTED;
+      if (!bej_read_value(&ctx, payload.root))
+        return 1;
+      allocations += ctx.stats.allocations;
+    }
+    record(&decode_trusted, now_s() - start);
+    decode_trusted.allocations = allocations;
+
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      w.len = 0;
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      if (bej_transcode_writer(&ctx, payload.root, &w) != BEJ_OK)
+        return 1;
+      check += w.len;
+    }
+    record(&transcode, now_s() - start);
+
+    allocations = 0;
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      BejSet *value = bej_query(&ctx, payload.root, path);
+      if (!value)
+        return 1;
+      allocations += ctx.stats.allocations;
+      check += (uint64_t)value->type;
+      bej_free(value);
+    }
+    record(&query, now_s() - start);
+    query.allocations = allocations;
+
+    allocations = 0;
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      ctx.projection = &projection;
+      BejSet *root = bej_read_value(&ctx, payload.root);
+      if (!root)
+        return 1;
+      allocations += ctx.stats.allocations;
+      check += root->object_value.count;
+      bej_free(root);
+    }
+    record(&decode_projected, now_s() - start);
+    decode_projected.allocations = allocations;
+
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_push_reset(&pusher);
+      for (size_t at = offsets[m]; at < offsets[m + 1]; at += BENCH_CHUNK)
+      {
+        size_t n = offsets[m + 1] - at < BENCH_CHUNK ? offsets[m + 1] - at : BENCH_CHUNK;
+        bej_push_feed(&pusher, enc.buf + at, n);
+      }
+      if (bej_push_finish(&pusher) != BEJ_OK)
+        return 1;
+      check += pusher.stats.values;
+    }
+    record(&push, now_s() - start);
+
+    allocations = 0;
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      BejSet *root = bej_read_value_parallel(&ctx, payload.root, threads);
+      if (!root)
+        return 1;
+      allocations += ctx.stats.allocations;
+      bej_free(root);
+    }
+    record(&decode_parallel, now_s() - start);
+    decode_parallel.allocations = allocations;
+
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      w.len = 0;
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      if (bej_transcode_parallel(&ctx, payload.root, &w, threads) != BEJ_OK)
+        return 1;
+      check += w.len;
+    }
+    record(&transcode_parallel, now_s() - start);
+
+    /* Every round after the first is all hits */
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      const char *json;
+      size_t length;
+      if (bej_cache_json(&cache, enc.buf + offsets[m], offsets[m + 1] - offsets[m], payload.root,
+                         &json, &length) != BEJ_OK)
+        return 1;
+      check += length;
+    }
+    record(&cache_hit, now_s() - start);
+
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      BejDecoder other;
+      size_t operations;
+      bej_decoder_init(&ctx, enc.buf + offsets[m], offsets[m + 1] - offsets[m]);
+      bej_decoder_init(&other, changed + offsets[m], offsets[m + 1] - offsets[m]);
+      if (bej_diff(&ctx, &other, payload.root, NULL, &operations) != BEJ_OK || operations != 1)
+        return 1;
+      check += operations;
+    }
+    record(&diff, now_s() - start);
+
+    allocations = 0;
+    start = now_s();
+    for (uint32_t m = 0; m < messages; m++)
+    {
+      BejMapping map;
+      if (bej_map_file(file, &map) != BEJ_OK)
+        return 1;
+      bej_decoder_init(&ctx, map.data, map.size);
+      BejSet *root = bej_read_value(&ctx, payload.root);
+      if (!root)
+        return 1;
+      allocations += ctx.stats.allocations;
+      w.len = 0;
+      bej_to_json_writer(root, payload.members, &w);
+      check += w.len;
+      bej_free(root);
+      bej_unmap_file(&map);
+    }
+    record(&end_to_end, now_s() - start);
+    end_to_end.allocations = allocations;
+  }
+
+  if (format == BENCH_CSV)
+    printf("benchmark,depth,fanout,root_fanout,set_every,string_pct,string_len,"
+           "messages,bytes,seconds,mb_per_s,msgs_per_s,allocs_per_msg\n");
+  else if (format == BENCH_TEXT)
+  {
+    printf("%u messages, %zu bytes of BEJ, %.0f bytes each\n", messages, enc.len,
+           (double)enc.len / messages);
+    printf("%-14s %12s %14s %14s\n", "", "MB/s", "msgs/s", "allocs/msg");
+  }
+
+  const BenchResult *results[] = {&load, &decode, &decode_arena, &validate,
+                                  &decode_trusted, &release, &emit, &transcode, &query,
+                                  &decode_projected, &push, &decode_parallel,
+                                  &transcode_parallel, &cache_hit, &diff, &end_to_end};
+  for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++)
+    print_result(results[i], &payload.config, payload.root_fanout, format);
+
+  unlink(file);
+  bej_push_free(&pusher);
+  bej_cache_destroy(&cache);
+  bej_projection_free(&projection);
+  free(changed);
+  json_writer_free(&w);
+  bej_arena_destroy(&arena);
+  bej_encoder_free(&enc);
+  bench_payload_free(&payload);
+  free(offsets);
+  free(trees);
+  return check == 0;
+}
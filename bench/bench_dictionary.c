@@ -0,0 +1,128 @@
+/**
+ * @file bench_dictionary.c
+ * @brief Dictionary lookup benchmark
+ *
+ * Compares the linear scan of bej_find_in_dictionary() with the compiled
+ * lookup tables for dictionaries of growing size, in both directions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/dictionary.h"
+
+#define LOOKUPS 2000000
+
+/*"Property" and any uint32_t index*/
+typedef char BenchName[20];
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds
+ */
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Builds a dictionary with generated names and sequential IDs
+ *
+ * @param count Number of entries
+ * @param names Storage for count names
+ * @return Sentinel-terminated dictionary, free with free()
+ */
+static BejDictionary *make_dictionary(uint32_t count, BenchName *names)
+{
+  BejDictionary *dict = calloc(count + 1, sizeof(BejDictionary));
+  if (!dict)
+    return NULL;
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    snprintf(names[i], sizeof names[i], "Property%u", i);
+    dict[i].id = (uint16_t)i;
+    dict[i].name = names[i];
+    dict[i].type = BEJ_INTEGER;
+  }
+  dict[count].id = 255;
+  dict[count].name = NULL;
+  return dict;
+}
+
+/**
+ * @brief Times ID and name lookups with random keys
+ *
+ * @param dict Dictionary to search
+ * @param count Number of entries in it
+ * @param keys Random entry indexes
+ * @param names Names matching the entries
+ * @param id_ns Pointer to store nanoseconds per ID lookup
+ * @param name_ns Pointer to store nanoseconds per name lookup
+ * @return Checksum so the lookups are not optimized away
+ */
+static uint64_t run(BejDictionary *dict, const uint16_t *keys, const BenchName *names,
+                    double *id_ns, double *name_ns)
+{
+  uint64_t check = 0;
+
+  double start = now_ns();
+  for (uint32_t i = 0; i < LOOKUPS; i++)
+  {
+    const char *name = bej_find_in_dictionary(dict, keys[i], NULL);
+    check += (uintptr_t)name;
+  }
+  *id_ns = (now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  for (uint32_t i = 0; i < LOOKUPS; i++)
+  {
+    const char *name = names[keys[i]];
+    check += (uint64_t)bej_find_id_in_dictionary(dict, name, strlen(name), NULL);
+  }
+  *name_ns = (now_ns() - start) / LOOKUPS;
+
+  return check;
+}
+
+int main(void)
+{
+  const uint32_t sizes[] = {8, 64, 256, 1024, 4096};
+  uint16_t *keys = malloc(sizeof(uint16_t) * LOOKUPS);
+  if (!keys)
+    return 1;
+
+  printf("%8s %12s %12s %12s %12s\n", "entries", "scan id ns", "index id ns",
+         "scan name ns", "index name ns");
+
+  uint64_t check = 0;
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    uint32_t count = sizes[s];
+    BenchName *names = malloc(sizeof(BenchName) * count);
+    BejDictionary *dict = names ? make_dictionary(count, names) : NULL;
+    if (!dict)
+      return 1;
+
+    srand(1);
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+      keys[i] = (uint16_t)(rand() % count);
+
+    double scan_id, scan_name, index_id, index_name;
+    check += run(dict, keys, names, &scan_id, &scan_name);
+    if (bej_dictionary_compile(dict) != 0)
+      return 1;
+    check += run(dict, keys, names, &index_id, &index_name);
+
+    printf("%8u %12.1f %12.1f %12.1f %12.1f\n", count, scan_id, index_id, scan_name, index_name);
+
+    bej_dictionary_release(dict);
+    free(dict);
+    free(names);
+  }
+
+  free(keys);
+  return check == 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file bench_footprint.c
+ * @brief Memory footprint of decoded trees over varied fan-out
+ *
+ * Decodes generated payloads whose SETs have from 1 to 256 members and
+ * reports the bytes a decoded tree keeps, next to what the former fixed
+ * 32-pair arrays would have taken and to the size of a tape.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/bej_tape.h"
+#include "../include/bej_encode.h"
+
+#define FIXED_PAIRS 32
+
+/**
+ * @brief Appends a SET with @p fanout members, every eighth one a SET of 3
+ *
+ * @param enc Encoder receiving the payload
+ * @param fanout Number of root members
+ * @return Number of SETs in the payload
+ */
+static uint32_t generate(BejEncoder *enc, uint32_t fanout)
+{
+  uint32_t sets = 1;
+  size_t root = bej_encode_begin_set(enc, 0);
+  for (uint32_t i = 0; i < fanout; i++)
+  {
+    if (i % 8 == 7)
+    {
+      size_t set = bej_encode_begin_set(enc, (uint16_t)i);
+      for (uint16_t k = 0; k < 3; k++)
+        bej_encode_integer(enc, k, k);
+      bej_encode_end_set(enc, set);
+      sets++;
+    }
+    else
+      bej_encode_integer(enc, (uint16_t)i, (int64_t)i * 1000);
+  }
+  bej_encode_end_set(enc, root);
+  return sets;
+}
+
+int main(void)
+{
+  const uint32_t fanouts[] = {1, 4, 16, 32, 64, 256};
+
+  printf("%8s %8s %12s %12s %12s\n", "fan-out", "values", "exact B", "fixed-32 B", "tape B");
+  for (size_t f = 0; f < sizeof(fanouts) / sizeof(fanouts[0]); f++)
+  {
+    BejEncoder enc;
+    if (bej_encoder_init(&enc, 0) != 0)
+      return 1;
+    uint32_t sets = generate(&enc, fanouts[f]);
+
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
+    if (!root)
+      return 1;
+
+    BejTape tape;
+    bej_tape_init(&tape);
+    BejDecoder tape_ctx;
+    bej_decoder_init(&tape_ctx, enc.buf, enc.len);
+    if (bej_tape_decode(&tape_ctx, &tape) != BEJ_OK)
+      return 1;
+
+    /* Every pair array was FIXED_PAIRS long, SETs with more members overran it */
+    size_t members = ctx.stats.values - 1;
+    size_t fixed = ctx.stats.bytes_allocated - members * sizeof(JsonPair) +
+                   (size_t)sets * FIXED_PAIRS * sizeof(JsonPair);
+
+    if (fanouts[f] <= FIXED_PAIRS)
+      printf("%8u %8u %12zu %12zu %12zu\n", fanouts[f], ctx.stats.values,
+             ctx.stats.bytes_allocated, fixed, (size_t)tape.count * sizeof(BejTapeEntry));
+    else
+      printf("%8u %8u %12zu %12s %12zu\n", fanouts[f], ctx.stats.values,
+             ctx.stats.bytes_allocated, "overflow", (size_t)tape.count * sizeof(BejTapeEntry));
+
+    bej_tape_free(&tape);
+    bej_free(root);
+    bej_encoder_free(&enc);
+  }
+  return 0;
+}
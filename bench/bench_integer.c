@@ -0,0 +1,171 @@
+/**
+ * @file bench_integer.c
+ * @brief Integer decoding benchmark
+ *
+ * Decodes a stream of length-prefixed integer payloads, as they follow an
+ * INTEGER tag, with bej_read_integer() and with the byte loop it replaced,
+ * for several distributions of payload widths. Sensor readings are mostly
+ * one or two bytes, counters and timestamps four to eight.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/bej_parse.h"
+
+#define VALUES 1000000
+#define ROUNDS 20
+
+/*share of each payload width 1..8, in percent*/
+typedef struct WidthMix
+{
+  const char *name;
+  uint8_t percent[8];
+} WidthMix;
+
+static const WidthMix mixes[] = {
+  {"sensor", {60, 30, 0, 8, 0, 0, 0, 2}},
+  {"uniform", {13, 13, 13, 13, 12, 12, 12, 12}},
+  {"wide", {0, 0, 0, 40, 10, 10, 0, 40}},
+  {"one-byte", {100, 0, 0, 0, 0, 0, 0, 0}},
+};
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds
+ */
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Returns the next pseudo-random number
+ */
+static uint32_t next_random(uint32_t *state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+/**
+ * @brief Builds VALUES length-prefixed payloads with widths drawn from a mix
+ *
+ * @param mix Width distribution
+ * @param size Pointer to store the number of bytes
+ * @return Buffer, free with free()
+ */
+static uint8_t *make_stream(const WidthMix *mix, size_t *size)
+{
+  uint8_t *data = malloc((size_t)VALUES * 10);
+  if (!data)
+    return NULL;
+
+  uint32_t state = 12345;
+  size_t len = 0;
+  for (uint32_t i = 0; i < VALUES; i++)
+  {
+    uint32_t pick = next_random(&state) % 100;
+    uint32_t width = 1;
+    for (uint32_t sum = mix->percent[0]; width < 8 && pick >= sum; width++)
+      sum += mix->percent[width];
+
+    data[len++] = 1;
+    data[len++] = (uint8_t)width;
+    for (uint32_t b = 0; b < width; b++)
+      data[len++] = (uint8_t)next_random(&state);
+  }
+
+  *size = len;
+  return data;
+}
+
+/**
+ * @brief Reads a length nnint, a copy of bej_read_length() that the
+ *        compiler can inline here as it does inside bej_parse.c
+ */
+static int read_length(BejDecoder *ctx, uint32_t *length)
+{
+  if (ctx->cursor == ctx->end || *ctx->cursor > 4 ||
+      (size_t)(ctx->end - ctx->cursor) < 1 + (size_t)*ctx->cursor)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_TRUNCATED);
+    return 0;
+  }
+  uint32_t result = 0;
+  uint8_t size = *ctx->cursor++;
+  for (uint8_t i = 0; i < size; i++)
+    result |= (uint32_t)*ctx->cursor++ << (8 * i);
+  if ((size_t)(ctx->end - ctx->cursor) < result)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_TRUNCATED);
+    return 0;
+  }
+  *length = result;
+  return 1;
+}
+
+/**
+ * @brief Reads one payload a byte at a time, as bej_read_integer() used to
+ */
+static int64_t read_integer_loop(BejDecoder *ctx)
+{
+  uint32_t length;
+  if (!read_length(ctx, &length))
+    return 0;
+
+  const uint8_t *bytes = ctx->cursor;
+  uint64_t res = 0;
+  for (size_t i = 0; i < length && i < sizeof(res); i++)
+    res |= ((uint64_t)bytes[i]) << (8 * i);
+  if (length > 0 && length < sizeof(res) && (bytes[length - 1] & 0x80))
+    res |= UINT64_MAX << (8 * length);
+  ctx->cursor += length;
+  return (int64_t)res;
+}
+
+int main(void)
+{
+  printf("%10s %12s %12s %8s\n", "widths", "loop M/s", "kernel M/s", "speedup");
+
+  for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++)
+  {
+    size_t size;
+    uint8_t *data = make_stream(&mixes[m], &size);
+    if (!data)
+      return 1;
+
+    int64_t sum_loop = 0;
+    double start = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+      BejDecoder ctx;
+      bej_decoder_init(&ctx, data, size);
+      while (ctx.cursor < ctx.end)
+        sum_loop += read_integer_loop(&ctx);
+    }
+    double loop = (double)VALUES * ROUNDS / ((now_ns() - start) / 1e9) / 1e6;
+
+    int64_t sum_kernel = 0;
+    start = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+      BejDecoder ctx;
+      bej_decoder_init(&ctx, data, size);
+      while (ctx.cursor < ctx.end)
+        sum_kernel += bej_read_integer(&ctx);
+    }
+    double kernel = (double)VALUES * ROUNDS / ((now_ns() - start) / 1e9) / 1e6;
+
+    free(data);
+    if (sum_loop != sum_kernel)
+    {
+      fprintf(stderr, "%s: results differ\n", mixes[m].name);
+      return 1;
+    }
+    printf("%10s %12.0f %12.0f %7.2fx\n", mixes[m].name, loop, kernel, kernel / loop);
+  }
+  return 0;
+}
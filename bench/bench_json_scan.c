@@ -0,0 +1,122 @@
+/**
+ * @file bench_json_scan.c
+ * @brief JSON scanning benchmark
+ *
+ * Parses a generated, indented JSON document with long string values
+ * through json_read_value() once per scanning kernel the CPU supports,
+ * and reports the throughput of the parse and of the bare string scan.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/json_parse.h"
+#include "../include/json_scan.h"
+
+#define MEMBERS 20000
+#define ROUNDS 20
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds
+ */
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Builds an indented object with string, escaped string and integer members
+ *
+ * @param size Pointer to store the length of the text
+ * @return Null-terminated text, free with free()
+ */
+static char *make_document(size_t *size)
+{
+  size_t cap = (size_t)MEMBERS * 160 + 16;
+  char *text = malloc(cap);
+  if (!text)
+    return NULL;
+
+  size_t len = 0;
+  text[len++] = '{';
+  for (uint32_t i = 0; i < MEMBERS; i++)
+  {
+    const char *fmt;
+    if (i % 4 == 3)
+      fmt = "%s\n        \"Value%u\": %u";
+    else if (i % 4 == 2)
+      fmt = "%s\n        \"Path%u\": \"/redfish/v1/Systems/1/Memory/DIMM%u\\/Metrics\\n\"";
+    else
+      fmt = "%s\n        \"Description%u\": \"DDR5 registered memory module in slot %u of the board\"";
+    len += (size_t)snprintf(text + len, cap - len, fmt, i ? "," : "", i, i);
+  }
+  len += (size_t)snprintf(text + len, cap - len, "\n}");
+
+  *size = len;
+  return text;
+}
+
+int main(void)
+{
+  static const char *names[] = {"scalar", "sse2", "avx2"};
+  size_t size;
+  char *text = make_document(&size);
+  if (!text)
+    return 1;
+
+  printf("%8s %14s %14s\n", "kernel", "parse MB/s", "scan MB/s");
+
+  size_t check = 0;
+  for (int impl = JSON_SCAN_SCALAR; impl <= JSON_SCAN_AVX2; impl++)
+  {
+    if (json_scan_use((JsonScanImpl)impl) != 0)
+    {
+      printf("%8s %14s %14s\n", names[impl], "-", "-");
+      continue;
+    }
+
+    double start = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+      const char *p = text;
+      BejSet *root = json_read_value(&p);
+      if (!root)
+        return 1;
+      check += root->object_value.count;
+      json_free(root);
+    }
+    double parse = (double)size * ROUNDS / ((now_ns() - start) / 1e9) / 1e6;
+
+    /* Walks every string and the whitespace between them, builds nothing */
+    start = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+      const char *p = text;
+      while (*p)
+      {
+        p = json_scan_spaces(p);
+        if (*p == '\0')
+          break;
+        if (*p == '"')
+        {
+          int escaped;
+          const char *close = json_scan_string(p + 1, &escaped);
+          if (!close)
+            return 1;
+          check += (size_t)escaped;
+          p = close;
+        }
+        p++;
+      }
+    }
+    double scan = (double)size * ROUNDS / ((now_ns() - start) / 1e9) / 1e6;
+
+    printf("%8s %14.0f %14.0f\n", names[impl], parse, scan);
+  }
+
+  free(text);
+  return check == 0;
+}
@@ -0,0 +1,216 @@
+/**
+ * @file bench_payload.c
+ * @brief Synthetic Redfish payload generator
+ *
+ * Generates BEJ resources of configurable depth, fan-out, string and
+ * integer mix and size, along with a compiled dictionary that names every
+ * member. All levels share one member table whose SET entries point back
+ * to it, so any depth resolves without per-level tables.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_payload.h"
+
+#define BENCH_NAME_SIZE 24
+
+/**
+ * @brief Redfish property names, suffixed with the member ID
+ */
+static const char *const bench_names[] = {
+  "Status", "PowerState", "SerialNumber", "Manufacturer", "Model",
+  "CapacityMiB", "OperatingSpeedMhz", "FirmwareVersion", "PartNumber",
+  "Health", "State", "Location", "Oem", "Links", "Metrics"
+};
+
+/**
+ * @brief Returns the type of a member ID
+ */
+static BejType bench_member_type(const BenchPayloadConfig *config, uint32_t id)
+{
+  if (config->set_every && id % config->set_every == 0)
+    return BEJ_SET;
+  /* 37 is coprime with 100, so any 100 consecutive IDs hit every share */
+  return (id * 37) % 100 < config->string_pct ? BEJ_STRING : BEJ_INTEGER;
+}
+
+/**
+ * @brief Builds the root and member tables
+ *
+ * @param payload Payload whose config is set
+ * @param count Number of member IDs, 1 to count
+ * @return 0 on success, -1 on allocation failure
+ */
+static int bench_payload_tables(BenchPayload *payload, uint32_t count)
+{
+  payload->root = calloc(2, sizeof(BejDictionary));
+  payload->members = calloc((size_t)count + 1, sizeof(BejDictionary));
+  payload->names = malloc((size_t)count * BENCH_NAME_SIZE);
+  if (!payload->root || !payload->members || !payload->names)
+    return -1;
+
+  size_t kinds = sizeof(bench_names) / sizeof(bench_names[0]);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    char *name = payload->names + (size_t)i * BENCH_NAME_SIZE;
+    snprintf(name, BENCH_NAME_SIZE, "%s%u", bench_names[i % kinds], i + 1);
+
+    BejDictionary *entry = &payload->members[i];
+    entry->id = (uint16_t)(i + 1);
+    entry->name = name;
+    entry->type = bench_member_type(&payload->config, i + 1);
+    entry->children = entry->type == BEJ_SET ? payload->members : NULL;
+  }
+  payload->members[count].id = 255;
+
+  payload->root[0].id = 0;
+  payload->root[0].name = "root";
+  payload->root[0].type = BEJ_SET;
+  payload->root[0].children = payload->members;
+  payload->root[1].id = 255;
+
+  if (bej_dictionary_compile(payload->root) != 0 ||
+      bej_dictionary_compile(payload->members) != 0)
+    return -1;
+  return 0;
+}
+
+/**
+ * @brief Releases the tables
+ */
+static void bench_payload_release(BenchPayload *payload)
+{
+  if (payload->root)
+    bej_dictionary_release(payload->root);
+  if (payload->members)
+    bej_dictionary_release(payload->members);
+  free(payload->root);
+  free(payload->members);
+  free(payload->names);
+  payload->root = NULL;
+  payload->members = NULL;
+  payload->names = NULL;
+}
+
+/**
+ * @brief Prepares a generator and its dictionary
+ *
+ * With a target size the root fan-out is scaled from one sample payload,
+ * up to 65534 members.
+ *
+ * @param payload Generator to initialize
+ * @param config Shape of the payloads
+ * @return 0 on success, -1 on allocation failure
+ */
+int bench_payload_init(BenchPayload *payload, const BenchPayloadConfig *config)
+{
+  memset(payload, 0, sizeof(*payload));
+  payload->config = *config;
+  if (payload->config.fanout == 0)
+    payload->config.fanout = 1;
+  if (payload->config.string_pct > 100)
+    payload->config.string_pct = 100;
+  payload->root_fanout = payload->config.fanout;
+
+  payload->text = malloc(payload->config.string_len + 1);
+  if (!payload->text)
+    return -1;
+  for (uint32_t i = 0; i < payload->config.string_len; i++)
+    payload->text[i] = (char)('a' + i % 26);
+
+  if (bench_payload_tables(payload, payload->root_fanout) != 0)
+  {
+    bench_payload_free(payload);
+    return -1;
+  }
+  if (payload->config.size == 0)
+    return 0;
+
+  BejEncoder enc;
+  if (bej_encoder_init(&enc, 0) != 0)
+  {
+    bench_payload_free(payload);
+    return -1;
+  }
+  bench_payload_generate(payload, &enc, 0);
+  size_t per_member = enc.len / payload->root_fanout + 1;
+  bej_encoder_free(&enc);
+
+  size_t root_fanout = payload->config.size / per_member;
+  if (root_fanout < 1) root_fanout = 1;
+  if (root_fanout > 65534) root_fanout = 65534;
+  payload->root_fanout = (uint32_t)root_fanout;
+
+  uint32_t count = payload->root_fanout > payload->config.fanout
+                   ? payload->root_fanout : payload->config.fanout;
+  bench_payload_release(payload);
+  if (bench_payload_tables(payload, count) != 0)
+  {
+    bench_payload_free(payload);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Appends the members of one SET
+ *
+ * @param payload Generator
+ * @param enc Encoder
+ * @param level Nesting level of the SET, 0 for the root
+ * @param count Number of members
+ * @param seed Varies the integers between payloads
+ */
+static void bench_payload_members(const BenchPayload *payload, BejEncoder *enc,
+                                  uint32_t level, uint32_t count, uint32_t seed)
+{
+  const BenchPayloadConfig *config = &payload->config;
+  for (uint32_t id = 1; id <= count; id++)
+  {
+    BejType type = bench_member_type(config, id);
+    if (type == BEJ_SET)
+    {
+      size_t mark = bej_encode_begin_set(enc, (uint16_t)id);
+      if (level < config->depth)
+        bench_payload_members(payload, enc, level + 1, config->fanout, seed * 31 + id);
+      bej_encode_end_set(enc, mark);
+    }
+    else if (type == BEJ_STRING)
+    {
+      bej_encode_string(enc, (uint16_t)id, payload->text, config->string_len);
+    }
+    else
+    {
+      /* Spread the values over one to four bytes */
+      uint32_t mix = (seed + id) * 2654435761u;
+      bej_encode_integer(enc, (uint16_t)id, (int64_t)(mix >> (8 * (id % 4))) - 100);
+    }
+  }
+}
+
+/**
+ * @brief Appends one payload
+ *
+ * @param payload Generator
+ * @param enc Encoder receiving the payload
+ * @param seed Varies the integers between payloads
+ */
+void bench_payload_generate(const BenchPayload *payload, BejEncoder *enc, uint32_t seed)
+{
+  size_t root = bej_encode_begin_set(enc, 0);
+  bench_payload_members(payload, enc, 0, payload->root_fanout, seed);
+  bej_encode_end_set(enc, root);
+}
+
+/**
+ * @brief Releases a generator and its dictionary
+ *
+ * @param payload Generator to release
+ */
+void bench_payload_free(BenchPayload *payload)
+{
+  bench_payload_release(payload);
+  free(payload->text);
+  payload->text = NULL;
+}
@@ -0,0 +1,35 @@
+#ifndef BENCH_PAYLOAD_H
+#define BENCH_PAYLOAD_H
+
+#include "../include/bej_encode.h"
+
+/*shape of the generated payloads*/
+typedef struct BenchPayloadConfig
+{
+  uint32_t depth;      /*levels of SETs below the root*/
+  uint32_t fanout;     /*members per nested SET*/
+  uint32_t set_every;  /*every n-th member is a SET, 0 for none*/
+  uint32_t string_pct; /*share of the other members that are strings, 0-100*/
+  uint32_t string_len; /*bytes per string value*/
+  size_t size;         /*approximate bytes per payload, 0 keeps the root at fanout members*/
+} BenchPayloadConfig;
+
+/*synthetic Redfish-like resource and the dictionary describing it*/
+typedef struct BenchPayload
+{
+  BenchPayloadConfig config;
+  BejDictionary *root;    /*holds the root entry, pass to the decoders*/
+  BejDictionary *members; /*members of every SET, pass to bej_to_json_writer()*/
+  char *names;
+  char *text;             /*string value bytes*/
+  uint32_t root_fanout;   /*members of the root SET*/
+} BenchPayload;
+
+
+int bench_payload_init(BenchPayload *payload, const BenchPayloadConfig *config);
+
+void bench_payload_generate(const BenchPayload *payload, BejEncoder *enc, uint32_t seed);
+
+void bench_payload_free(BenchPayload *payload);
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * @file bench_tape.c
+ * @brief Tree versus tape decoding and traversal benchmark
+ *
+ * Decodes a batch of generated documents into BejSet trees and into tapes,
+ * keeps all of them in memory as a bulk export would, then walks every
+ * document summing its integers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/bej_tape.h"
+#include "../include/bej_encode.h"
+
+#define DOCUMENTS 20000
+#define MEMBERS 24
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds
+ */
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Appends one document: integers, strings and nested SETs
+ *
+ * @param enc Encoder receiving the document
+ * @param seed Varies the values between documents
+ */
+static void generate(BejEncoder *enc, uint32_t seed)
+{
+  size_t root = bej_encode_begin_set(enc, 0);
+  for (uint16_t i = 1; i <= MEMBERS; i++)
+  {
+    if (i % 6 == 0)
+    {
+      size_t set = bej_encode_begin_set(enc, i);
+      for (uint16_t k = 1; k <= 4; k++)
+        bej_encode_integer(enc, k, (int64_t)(seed * k));
+      bej_encode_end_set(enc, set);
+    }
+    else if (i % 4 == 0)
+      bej_encode_string(enc, i, "Enabled", 7);
+    else
+      bej_encode_integer(enc, i, (int64_t)seed + i);
+  }
+  bej_encode_end_set(enc, root);
+}
+
+/**
+ * @brief Sums the integers of a tree
+ */
+static int64_t sum_tree(const BejSet *val)
+{
+  if (val->type == BEJ_INTEGER)
+    return val->integer_value;
+  if (val->type != BEJ_SET)
+    return 0;
+
+  int64_t sum = 0;
+  for (uint16_t i = 0; i < val->object_value.count; i++)
+    sum += sum_tree(val->object_value.pairs[i].value);
+  return sum;
+}
+
+/**
+ * @brief Sums the integers of a tape in one linear scan
+ */
+static int64_t sum_tape(const BejTape *tape)
+{
+  int64_t sum = 0;
+  for (uint32_t i = 0; i < tape->count; i++)
+  {
+    if (tape->entries[i].type == BEJ_INTEGER)
+      sum += tape->entries[i].value.integer;
+  }
+  return sum;
+}
+
+int main(void)
+{
+  BejEncoder enc;
+  size_t *offsets = malloc(sizeof(size_t) * (DOCUMENTS + 1));
+  BejSet **trees = malloc(sizeof(BejSet *) * DOCUMENTS);
+  BejTape *tapes = malloc(sizeof(BejTape) * DOCUMENTS);
+  if (!offsets || !trees || !tapes || bej_encoder_init(&enc, 1 << 20) != 0)
+    return 1;
+
+  for (uint32_t d = 0; d < DOCUMENTS; d++)
+  {
+    offsets[d] = enc.len;
+    generate(&enc, d);
+  }
+  offsets[DOCUMENTS] = enc.len;
+  if (enc.error != BEJ_OK)
+    return 1;
+
+  BejDecoder ctx;
+  double start = now_ns();
+  for (uint32_t d = 0; d < DOCUMENTS; d++)
+  {
+    bej_decoder_init(&ctx, enc.buf + offsets[d], offsets[d + 1] - offsets[d]);
+    trees[d] = bej_read_value(&ctx, main_dictionary);
+    if (!trees[d])
+      return 1;
+  }
+  double tree_decode = (now_ns() - start) / DOCUMENTS;
+
+  start = now_ns();
+  for (uint32_t d = 0; d < DOCUMENTS; d++)
+  {
+    bej_tape_init(&tapes[d]);
+    bej_decoder_init(&ctx, enc.buf + offsets[d], offsets[d + 1] - offsets[d]);
+    if (bej_tape_decode(&ctx, &tapes[d]) != BEJ_OK)
+      return 1;
+  }
+  double tape_decode = (now_ns() - start) / DOCUMENTS;
+
+  int64_t tree_sum = 0, tape_sum = 0;
+  start = now_ns();
+  for (uint32_t d = 0; d < DOCUMENTS; d++)
+    tree_sum += sum_tree(trees[d]);
+  double tree_walk = (now_ns() - start) / DOCUMENTS;
+
+  start = now_ns();
+  for (uint32_t d = 0; d < DOCUMENTS; d++)
+    tape_sum += sum_tape(&tapes[d]);
+  double tape_walk = (now_ns() - start) / DOCUMENTS;
+
+  printf("%u documents, %zu bytes of BEJ\n", DOCUMENTS, enc.len);
+  printf("%-6s %14s %14s\n", "", "decode ns/doc", "walk ns/doc");
+  printf("%-6s %14.1f %14.1f\n", "tree", tree_decode, tree_walk);
+  printf("%-6s %14.1f %14.1f\n", "tape", tape_decode, tape_walk);
+
+  for (uint32_t d = 0; d < DOCUMENTS; d++)
+  {
+    bej_free(trees[d]);
+    bej_tape_free(&tapes[d]);
+  }
+  bej_encoder_free(&enc);
+  free(offsets);
+  free(trees);
+  free(tapes);
+  return tree_sum != tape_sum;
+}
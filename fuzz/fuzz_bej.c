@@ -0,0 +1,97 @@
+/**
+ * @file fuzz_bej.c
+ * @brief libFuzzer target for the validator and the decoder
+ *
+ * Validates each input and decodes it with bounds checks, and aborts
+ * unless both accept it or both reject it with the same error at the same
+ * offset. Accepted inputs are decoded again with BEJ_DECODE_TRUSTED,
+ * which must consume the same bytes and give the same JSON text. The
+ * input is copied to a buffer of its exact size so that AddressSanitizer
+ * catches any read past the end.
+ *
+ * Build: cmake -DBEJ_BUILD_FUZZERS=ON -DCMAKE_C_COMPILER=clang ..
+ * Run:   ./fuzz_bej corpus ../fuzz/seeds
+ * The seeds include depth_bomb.bin, SETs nested past BEJ_DECODE_DEPTH.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_validate.h"
+
+/* SETs over UINT16_MAX members may fail differently, see bej_validate() */
+#define FUZZ_MAX_COMPARED (3 * 65536)
+
+/**
+ * @brief Decodes a buffer into compact JSON text
+ *
+ * @param data BEJ data
+ * @param size Number of bytes
+ * @param flags Decoder flags
+ * @param ctx Decoder context, holds the error and cursor afterwards
+ * @param w Writer for the text
+ * @return 1 if the value was decoded, 0 on error
+ */
+static int fuzz_decode(const uint8_t *data, size_t size, uint32_t flags, BejDecoder *ctx,
+                       JsonWriter *w)
+{
+  bej_decoder_init(ctx, data, size);
+  ctx->flags = flags;
+  BejSet *root = bej_read_value(ctx, main_dictionary);
+  if (!root)
+    return 0;
+
+  bej_to_json_writer(root, main_dictionary, w);
+  bej_free(root);
+  return 1;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  uint8_t *copy = malloc(size ? size : 1);
+  if (!copy)
+    return 0;
+  memcpy(copy, data, size);
+
+  BejDecoder valid;
+  bej_decoder_init(&valid, copy, size);
+  BejError verdict = bej_validate(&valid);
+
+  BejDecoder checked;
+  JsonWriter text;
+  if (json_writer_init_buffer(&text, JSON_COMPACT) != 0)
+    abort();
+  int decoded = fuzz_decode(copy, size, 0, &checked, &text);
+
+  /* Running out of memory says nothing about the input */
+  if (checked.error != BEJ_ERR_NOMEM)
+  {
+    if ((verdict == BEJ_OK) != decoded)
+      abort();
+    if (size < FUZZ_MAX_COMPARED &&
+        (verdict != checked.error || valid.error_offset != checked.error_offset))
+      abort();
+  }
+
+  if (verdict == BEJ_OK && decoded)
+  {
+    if (valid.cursor != checked.cursor)
+      abort();
+
+    BejDecoder trusted;
+    JsonWriter trusted_text;
+    if (json_writer_init_buffer(&trusted_text, JSON_COMPACT) != 0)
+      abort();
+    if (!fuzz_decode(copy, size, BEJ_DECODE_TRUSTED, &trusted, &trusted_text) &&
+        trusted.error != BEJ_ERR_NOMEM)
+      abort();
+    if (trusted.error == BEJ_OK &&
+        (trusted.cursor != checked.cursor || trusted_text.len != text.len ||
+         memcmp(trusted_text.buf, text.buf, text.len) != 0))
+      abort();
+    json_writer_free(&trusted_text);
+  }
+
+  json_writer_free(&text);
+  free(copy);
+  return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef BEJ_ARENA_H
+#define BEJ_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BEJ_ARENA_ALIGN 8
+#define BEJ_ARENA_BLOCK_SIZE 4096
+
+/*one chunk of arena memory, data follows the header*/
+typedef struct BejArenaBlock
+{
+    struct BejArenaBlock *next;
+    size_t size;
+    size_t used;
+} BejArenaBlock;
+
+/*bump allocator, blocks are kept across resets*/
+typedef struct BejArena
+{
+    BejArenaBlock *head;
+    BejArenaBlock *current;
+    size_t block_size;
+} BejArena;
+
+
+void bej_arena_init(BejArena *arena, size_t block_size);
+
+void *bej_arena_alloc(BejArena *arena, size_t size);
+
+void bej_arena_reset(BejArena *arena);
+
+void bej_arena_destroy(BejArena *arena);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef BEJ_BATCH_H
+#define BEJ_BATCH_H
+
+#include "bej_parse.h"
+#include "bej_pool.h"
+
+/*how a batch is converted*/
+typedef struct BejBatchOptions
+{
+  uint32_t threads;       /*0: one per processor*/
+  int style;              /*JSON_PRETTY or JSON_COMPACT for per-file output*/
+  const char *output_dir; /*per-file output: <dir>/<name without extension>.json*/
+  int ndjson_fd;          /*>= 0: one compact line per file on this descriptor instead*/
+  BejDictionary *dict;    /*holds the root entry, main_dictionary or a loaded schema root*/
+} BejBatchOptions;
+
+typedef struct BejBatchStats
+{
+  size_t files;
+  size_t failed;
+  size_t bytes_in;
+  size_t bytes_out;
+  double seconds;
+  BejPoolStats pool;
+} BejBatchStats;
+
+
+BejError bej_batch_run(const char *const *files, size_t count, const BejBatchOptions *options,
+                       BejBatchStats *stats);
+
+#endif
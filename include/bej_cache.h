@@ -0,0 +1,57 @@
+#ifndef BEJ_CACHE_H
+#define BEJ_CACHE_H
+
+#include "bej_parse.h"
+
+/*one payload seen before, with what was produced from it*/
+typedef struct BejCacheEntry
+{
+  uint64_t hash;
+  const BejDictionary *dict;      /*dictionary the payload was decoded with*/
+  uint8_t *data;                  /*copy of the payload*/
+  size_t size;
+  BejArena arena;                 /*holds the tree*/
+  BejSet *tree;                   /*NULL until requested*/
+  char *json;                     /*NULL until requested*/
+  size_t json_length;
+  struct BejCacheEntry *newer;    /*LRU list*/
+  struct BejCacheEntry *older;
+  struct BejCacheEntry *chain;    /*hash bucket*/
+} BejCacheEntry;
+
+typedef struct BejCacheStats
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} BejCacheStats;
+
+/*bounded LRU of decode results keyed by payload bytes and dictionary, not thread-safe*/
+typedef struct BejDecodeCache
+{
+  BejCacheEntry **buckets;
+  uint32_t bucket_mask;
+  BejCacheEntry *newest;
+  BejCacheEntry *oldest;
+  size_t count;
+  size_t capacity;               /*most entries kept*/
+  int style;                     /*JSON_PRETTY or JSON_COMPACT*/
+  BejCacheStats stats;
+} BejDecodeCache;
+
+
+uint64_t bej_cache_hash(const uint8_t *data, size_t size, uint64_t seed);
+
+int bej_cache_init(BejDecodeCache *cache, size_t capacity, int style);
+
+BejError bej_cache_tree(BejDecodeCache *cache, const uint8_t *data, size_t size, BejDictionary *dict,
+                        const BejSet **tree);
+
+BejError bej_cache_json(BejDecodeCache *cache, const uint8_t *data, size_t size, BejDictionary *dict,
+                        const char **json, size_t *length);
+
+void bej_cache_clear(BejDecodeCache *cache);
+
+void bej_cache_destroy(BejDecodeCache *cache);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef BEJ_DIFF_H
+#define BEJ_DIFF_H
+
+#include "bej_parse.h"
+
+/*output is an RFC 6902 JSON Patch array turning the first value into the second*/
+
+BejError bej_diff(BejDecoder *from, BejDecoder *to, BejDictionary *dict, JsonWriter *w,
+                  size_t *operations);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef BEJ_ENCODE_H
+#define BEJ_ENCODE_H
+
+#include "bej_parse.h"
+
+/*state of one encode, the BEJ data is buf[0..len)*/
+typedef struct BejEncoder
+{
+  uint8_t *buf;
+  size_t len;
+  size_t cap;
+  int growable;   /*buf is owned and grows with realloc*/
+  BejError error; /*first error*/
+} BejEncoder;
+
+
+int bej_encoder_init(BejEncoder *enc, size_t capacity);
+
+void bej_encoder_init_buffer(BejEncoder *enc, uint8_t *buf, size_t size);
+
+void bej_encoder_reset(BejEncoder *enc);
+
+void bej_encoder_free(BejEncoder *enc);
+
+
+size_t bej_encode_begin_set(BejEncoder *enc, uint16_t id);
+
+void bej_encode_end_set(BejEncoder *enc, size_t mark);
+
+void bej_encode_integer(BejEncoder *enc, uint16_t id, int64_t value);
+
+void bej_encode_string(BejEncoder *enc, uint16_t id, const char *value, size_t length);
+
+size_t bej_encode_begin_array(BejEncoder *enc, uint16_t id);
+
+void bej_encode_end_array(BejEncoder *enc, size_t mark, uint16_t count);
+
+void bej_encode_null(BejEncoder *enc, uint16_t id);
+
+void bej_encode_boolean(BejEncoder *enc, uint16_t id, int value);
+
+void bej_encode_real(BejEncoder *enc, uint16_t id, double value);
+
+void bej_encode_enum(BejEncoder *enc, uint16_t id, uint16_t option);
+
+
+BejError bej_encode_tree(BejEncoder *enc, BejSet *root, BejDictionary *dict);
+
+BejError bej_encode_json(BejEncoder *enc, const char *text, BejDictionary *dict);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef BEJ_PARALLEL_H
+#define BEJ_PARALLEL_H
+
+#include "bej_parse.h"
+
+/*root SETs with fewer members are decoded on the calling thread*/
+#define BEJ_PARALLEL_MIN_MEMBERS 2
+
+BejSet *bej_read_value_parallel(BejDecoder *ctx, BejDictionary *dict, uint32_t threads);
+
+BejError bej_transcode_parallel(BejDecoder *ctx, BejDictionary *dict, JsonWriter *w, uint32_t threads);
+
+#endif
@@ -1,24 +1,118 @@
 #ifndef BEJ_PARSE_H
 #define BEJ_PARSE_H
 
+#include <stdio.h>
+#include <stddef.h>
+
 #include "objects.h"
 #include "dictionary.h"
-#define PAIR_BUFFER 32
+#include "bej_arena.h"
+#include "json_writer.h"
+
+/*decoder flags*/
+#define BEJ_DECODE_ZERO_COPY 0x01 /*strings point into the input buffer*/
+#define BEJ_DECODE_TRUSTED 0x02   /*input passed bej_validate(), reads skip bounds checks*/
+
+#define BEJ_DECODE_DEPTH 32 /*deepest SET and ARRAY nesting, deeper input fails with BEJ_ERR_LENGTH*/
+
+/*bej_projection_member() results besides a node index*/
+#define BEJ_PROJECTION_ALL -1  /*the whole member is selected*/
+#define BEJ_PROJECTION_SKIP -2 /*the member is not selected*/
+
+struct BejProjection;
+
+typedef enum BejError
+{
+  BEJ_OK = 0,
+  BEJ_ERR_TRUNCATED, /*value runs past the end of the buffer or SET*/
+  BEJ_ERR_TYPE,      /*unsupported BEJ type*/
+  BEJ_ERR_LENGTH,    /*SET has more than UINT16_MAX members, nnint over 4 bytes or above its field, integer wider than 64 bits, payload of the wrong size for its type, nesting over BEJ_DECODE_DEPTH, tape input over UINT32_MAX bytes or output full*/
+  BEJ_ERR_NOMEM,
+  BEJ_ERR_IO,        /*file could not be opened or mapped*/
+  BEJ_ERR_ABORTED,   /*stopped by a callback*/
+  BEJ_ERR_SCHEMA,    /*malformed dictionary, not the requested schema or name not in it*/
+  BEJ_ERR_SYNTAX,    /*malformed JSON text*/
+  BEJ_ERR_NOT_FOUND  /*queried property is not in the payload*/
+} BejError;
+
+typedef struct BejDecodeStats
+{
+  uint32_t values;
+  uint32_t allocations;
+  size_t bytes_allocated;
+} BejDecodeStats;
+
+/*state of one decode, one context per thread*/
+typedef struct BejDecoder
+{
+  const uint8_t *start;
+  const uint8_t *cursor; /*next byte to read*/
+  const uint8_t *end;    /*one past the last readable byte*/
+  const uint8_t *limit;  /*end of the whole buffer, for wide loads past a SET end*/
+  BejError error;        /*first error*/
+  size_t error_offset;   /*offset of the first error from start*/
+  BejArena *arena;       /*NULL: malloc*/
+  uint32_t flags;
+  const struct BejProjection *projection; /*NULL: every member*/
+  int32_t projection_node; /*node of the current SET, 0 is the root*/
+  uint32_t depth;          /*SETs and ARRAYs open around the cursor*/
+  BejDecodeStats stats;
+} BejDecoder;
+
+/*read-only view of a whole file*/
+typedef struct BejMapping
+{
+  const uint8_t *data;
+  size_t size;
+  uint8_t mapped; /*0: data is heap memory or NULL*/
+} BejMapping;
+
+
+
+
+
+uint8_t *bej_load_file(const char *file_name, size_t *size);
 
+BejError bej_map_file(const char *file_name, BejMapping *map);
 
+void bej_unmap_file(BejMapping *map);
 
+void bej_decoder_init(BejDecoder *ctx, const uint8_t *data, size_t size);
 
+void bej_decoder_fail(BejDecoder *ctx, BejError error);
 
-uint8_t *bej_load_file(const char *file_name);
+int bej_decoder_enter(BejDecoder *ctx);
 
+void bej_decoder_leave(BejDecoder *ctx);
 
-uint32_t bej_read_integer(const uint8_t **data);
+const char *bej_error_string(BejError error);
 
-char *bej_read_string(const uint8_t **data);
+int bej_read_tag(BejDecoder *ctx, uint16_t *id, uint8_t *type);
 
-BejSet *bej_read_object(const uint8_t **data, uint8_t parent_id, BejDictionary *dict);
+int bej_read_length(BejDecoder *ctx, uint32_t *length);
 
-BejSet *bej_read_value(const uint8_t **data, BejDictionary *dict);
+int bej_skip_value(BejDecoder *ctx);
+
+int32_t bej_projection_member(const BejDecoder *ctx, uint16_t id);
+
+
+int64_t bej_read_integer(BejDecoder *ctx);
+
+double bej_read_real(BejDecoder *ctx);
+
+int bej_read_boolean(BejDecoder *ctx);
+
+uint16_t bej_read_enum(BejDecoder *ctx);
+
+int bej_read_null(BejDecoder *ctx);
+
+int bej_read_array_header(BejDecoder *ctx, uint32_t *length, uint16_t *count);
+
+char *bej_read_string(BejDecoder *ctx);
+
+BejSet *bej_read_object(BejDecoder *ctx, uint16_t parent_id, BejDictionary *dict);
+
+BejSet *bej_read_value(BejDecoder *ctx, BejDictionary *dict);
 
 
 void bej_free(BejSet *val);
@@ -27,8 +121,14 @@ void bej_free(BejSet *val);
 
 
 
+void bej_to_json_writer(BejSet *val, BejDictionary *dict, JsonWriter *w);
+
+int bej_json_fwrite(void *user, const char *data, size_t length);
+
 void bej_to_json_val(BejSet *val, BejDictionary *dict, FILE *f, int depth);
 
+void bej_to_json_compact(BejSet *val, BejDictionary *dict, FILE *f);
+
 void bej_to_json_file(BejSet *root, const char *filename);
 #endif
 
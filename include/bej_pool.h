@@ -0,0 +1,23 @@
+#ifndef BEJ_POOL_H
+#define BEJ_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BEJ_POOL_MAX_WORKERS 256
+
+/*runs one task, worker is the index of the calling thread*/
+typedef void (*BejPoolTask)(void *user, uint32_t worker, size_t task);
+
+typedef struct BejPoolStats
+{
+  uint32_t workers; /*threads that ran, including the caller*/
+  uint64_t steals;  /*ranges taken from another worker*/
+} BejPoolStats;
+
+
+uint32_t bej_pool_cpu_count(void);
+
+int bej_pool_run(uint32_t workers, size_t tasks, BejPoolTask run, void *user, BejPoolStats *stats);
+
+#endif
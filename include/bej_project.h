@@ -0,0 +1,29 @@
+#ifndef BEJ_PROJECT_H
+#define BEJ_PROJECT_H
+
+#include "bej_parse.h"
+
+/*one selected dictionary entry*/
+typedef struct BejProjectionNode
+{
+  uint16_t id;
+  uint8_t all;   /*the whole value is selected*/
+  int32_t child; /*first selected member, -1 for none*/
+  int32_t next;  /*next selected sibling, -1 for none*/
+} BejProjectionNode;
+
+/*compiled set of paths, set ctx->projection to decode only those*/
+typedef struct BejProjection
+{
+  BejProjectionNode *nodes; /*nodes[0] is the root SET*/
+  uint32_t count;
+  uint32_t cap;
+} BejProjection;
+
+
+BejError bej_projection_compile(BejProjection *proj, BejDictionary *members, const char *const *paths,
+                                size_t count);
+
+void bej_projection_free(BejProjection *proj);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef BEJ_PUSH_H
+#define BEJ_PUSH_H
+
+#include "bej_sax.h"
+
+#define BEJ_PUSH_DEPTH BEJ_DECODE_DEPTH /*deepest SET and ARRAY nesting, deeper input fails with BEJ_ERR_LENGTH*/
+
+/*open SET or ARRAY*/
+typedef struct BejPushFrame
+{
+  size_t end;          /*input offset one past the members or elements*/
+  BejDictionary *dict; /*dictionary of the members, or the one holding the element entry*/
+  uint16_t left;       /*ARRAY elements not started yet*/
+  uint8_t array;
+} BejPushFrame;
+
+/*decoder fed with arbitrary chunks, reports values through SAX callbacks*/
+typedef struct BejPushDecoder
+{
+  const BejSaxCallbacks *cb;
+  void *user;
+  BejDictionary *dict;  /*holds the root entry*/
+  uint8_t state;
+  uint8_t skip;         /*current value was skipped by a callback*/
+  uint8_t type;
+  uint8_t nnint_size;   /*value bytes of the nnint being read*/
+  uint8_t nnint_done;   /*bytes of the nnint read so far, its size byte included*/
+  uint16_t id;
+  uint64_t value;       /*nnint or scalar being assembled*/
+  uint32_t length;      /*payload length of the current value*/
+  uint32_t done;        /*payload bytes read so far*/
+  char *buf;            /*string split across chunks*/
+  uint32_t buf_cap;
+  BejPushFrame stack[BEJ_PUSH_DEPTH];
+  uint32_t depth;
+  size_t offset;        /*bytes consumed since the start of the message*/
+  BejError error;       /*first error*/
+  size_t error_offset;
+  BejDecodeStats stats;
+} BejPushDecoder;
+
+
+void bej_push_init(BejPushDecoder *push, BejDictionary *dict, const BejSaxCallbacks *cb, void *user);
+
+BejError bej_push_feed(BejPushDecoder *push, const uint8_t *data, size_t size);
+
+BejError bej_push_finish(BejPushDecoder *push);
+
+void bej_push_reset(BejPushDecoder *push);
+
+void bej_push_free(BejPushDecoder *push);
+
+#endif
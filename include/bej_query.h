@@ -0,0 +1,13 @@
+#ifndef BEJ_QUERY_H
+#define BEJ_QUERY_H
+
+#include "bej_parse.h"
+
+/*paths are dictionary names separated by '/', e.g. "/MemoryLocation/Slot"*/
+
+BejError bej_query_locate(BejDecoder *ctx, BejDictionary *dict, const char *path,
+                          BejDictionary **entry_dict);
+
+BejSet *bej_query(BejDecoder *ctx, BejDictionary *dict, const char *path);
+
+#endif
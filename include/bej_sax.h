@@ -0,0 +1,38 @@
+#ifndef BEJ_SAX_H
+#define BEJ_SAX_H
+
+#include "bej_parse.h"
+
+/*returned by every callback*/
+typedef enum BejSaxAction
+{
+  BEJ_SAX_CONTINUE = 0,
+  BEJ_SAX_SKIP,  /*skip the announced member or SET*/
+  BEJ_SAX_STOP   /*stop decoding, ctx->error = BEJ_ERR_ABORTED*/
+} BejSaxAction;
+
+/*event handlers, any of them can be NULL*/
+typedef struct BejSaxCallbacks
+{
+  BejSaxAction (*start_set)(void *user);
+  BejSaxAction (*end_set)(void *user);
+  /*announces the next SET member, name is NULL when not in the dictionary*/
+  BejSaxAction (*property)(void *user, uint16_t id, const char *name, BejType type);
+  BejSaxAction (*integer)(void *user, int64_t value);
+  /*value points into the input buffer and is not null-terminated*/
+  BejSaxAction (*string)(void *user, const char *value, uint32_t length);
+  BejSaxAction (*start_array)(void *user, uint16_t count);
+  BejSaxAction (*end_array)(void *user);
+  /*announces the next ARRAY element, index is the element's tag*/
+  BejSaxAction (*element)(void *user, uint16_t index, BejType type);
+  BejSaxAction (*null_value)(void *user);
+  BejSaxAction (*boolean)(void *user, int value);
+  BejSaxAction (*real)(void *user, double value);
+  /*name is NULL when the option is not in the dictionary*/
+  BejSaxAction (*enumeration)(void *user, uint16_t option, const char *name);
+} BejSaxCallbacks;
+
+
+BejError bej_sax_parse(BejDecoder *ctx, BejDictionary *dict, const BejSaxCallbacks *cb, void *user);
+
+#endif
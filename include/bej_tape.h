@@ -0,0 +1,59 @@
+#ifndef BEJ_TAPE_H
+#define BEJ_TAPE_H
+
+#include "bej_parse.h"
+
+#define BEJ_TAPE_END 0xFF          /*type of the entry closing a SET or ARRAY*/
+#define BEJ_TAPE_NONE UINT32_MAX   /*no such entry*/
+
+/*one decoded value, 16 bytes*/
+typedef struct BejTapeEntry
+{
+  uint8_t type;  /*BejType, or BEJ_TAPE_END*/
+  uint8_t reserved;
+  uint16_t id;    /*index for ARRAY elements*/
+  uint32_t end;  /*index one past the subtree, the next sibling if there is one*/
+  union
+  {
+    int64_t integer;
+    struct
+    {
+      uint32_t offset; /*from the start of the input, at most 4 GiB*/
+      uint32_t length;
+    } string;
+    uint32_t count;    /*SET members or ARRAY elements*/
+    double real;
+    uint16_t option;   /*ENUM*/
+    uint8_t boolean;
+  } value;
+} BejTapeEntry;
+
+/*decoded document in one array, strings point into the input*/
+typedef struct BejTape
+{
+  BejTapeEntry *entries;
+  uint32_t count;
+  uint32_t capacity;
+  const uint8_t *data; /*input the string offsets refer to*/
+} BejTape;
+
+
+void bej_tape_init(BejTape *tape);
+
+void bej_tape_free(BejTape *tape);
+
+BejError bej_tape_decode(BejDecoder *ctx, BejTape *tape);
+
+
+uint32_t bej_tape_first_child(const BejTape *tape, uint32_t index);
+
+uint32_t bej_tape_next_sibling(const BejTape *tape, uint32_t index);
+
+uint32_t bej_tape_find(const BejTape *tape, uint32_t index, uint16_t id);
+
+const char *bej_tape_string(const BejTape *tape, uint32_t index, uint32_t *length);
+
+
+void bej_tape_to_json_writer(const BejTape *tape, uint32_t index, BejDictionary *dict, JsonWriter *w);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef BEJ_TRANSCODE_H
+#define BEJ_TRANSCODE_H
+
+#include "bej_parse.h"
+
+#define BEJ_JSON_PRETTY JSON_PRETTY
+#define BEJ_JSON_COMPACT JSON_COMPACT
+
+
+BejError bej_transcode_writer(BejDecoder *ctx, BejDictionary *dict, JsonWriter *w);
+
+BejError bej_transcode_json(BejDecoder *ctx, BejDictionary *dict, FILE *f, int style);
+
+BejError bej_transcode_file(const char *bej_name, const char *json_name, int style);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef BEJ_VALIDATE_H
+#define BEJ_VALIDATE_H
+
+#include "bej_parse.h"
+
+/*a value that passes can be decoded again with BEJ_DECODE_TRUSTED set*/
+
+BejError bej_validate(BejDecoder *ctx);
+
+#endif
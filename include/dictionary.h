@@ -1,16 +1,32 @@
 #ifndef DICTIONARY_H
 #define DICTIONARY_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "objects.h"
 
+/*lookup tables built by bej_dictionary_compile()*/
+typedef struct BejDictIndex
+{
+    const BejDictionary **by_id;   /*indexed by sequence number*/
+    uint32_t id_count;
+    const BejDictionary **by_name; /*open addressing on the name hash*/
+    uint32_t name_mask;
+} BejDictIndex;
+
 extern BejDictionary main_dictionary[];
 
 extern BejDictionary child_dictionary[];
 
+int bej_dictionary_init(void);
+int bej_dictionary_compile(BejDictionary *dict);
+void bej_dictionary_release(BejDictionary *dict);
+
+BejDictionary * bej_dictionary_child(BejDictionary *dict, uint16_t id);
 BejDictionary * bej_get_child_dictionary(uint8_t parent_id);
-const char * bej_find_in_dictionary(BejDictionary *dict, uint8_t id, BejType *type);
+const char * bej_find_in_dictionary(BejDictionary *dict, uint16_t id, BejType *type);
+int32_t bej_find_id_in_dictionary(BejDictionary *dict, const char *name, size_t length, BejType *type);
 
 
 #endif
@@ -0,0 +1,45 @@
+#ifndef DICTIONARY_LOADER_H
+#define DICTIONARY_LOADER_H
+
+#include "bej_parse.h"
+
+/*DSP0218 binary dictionary layout*/
+#define BEJ_DICT_HEADER_SIZE 12
+#define BEJ_DICT_ENTRY_SIZE 10
+
+/*dictionary decoded from a DSP0218 binary, names point into the binary*/
+typedef struct BejSchemaDictionary
+{
+  BejMapping mapping;     /*owned binary, empty when parsed from a caller buffer*/
+  BejDictionary *root;    /*subset holding the schema entry, pass to the decoders*/
+  BejDictionary *entries; /*all subsets, each followed by a sentinel*/
+  uint32_t slot_count;    /*entries including sentinels*/
+  const char *schema;     /*name of the schema entry*/
+  uint32_t version;       /*SchemaVersion from the header*/
+  struct BejSchemaDictionary *next; /*cache chain*/
+} BejSchemaDictionary;
+
+/*loaded dictionaries keyed by schema name and version, not thread-safe*/
+typedef struct BejDictCache
+{
+  BejSchemaDictionary *head;
+} BejDictCache;
+
+
+BejError bej_dictionary_parse(const uint8_t *data, size_t size, BejSchemaDictionary *dict);
+
+BejError bej_dictionary_load(const char *file_name, BejSchemaDictionary *dict);
+
+void bej_dictionary_unload(BejSchemaDictionary *dict);
+
+
+void bej_dict_cache_init(BejDictCache *cache);
+
+BejSchemaDictionary *bej_dict_cache_find(BejDictCache *cache, const char *schema, uint32_t version);
+
+BejError bej_dict_cache_load(BejDictCache *cache, const char *schema, uint32_t version,
+                             const char *file_name, BejSchemaDictionary **dict);
+
+void bej_dict_cache_destroy(BejDictCache *cache);
+
+#endif
@@ -8,7 +8,7 @@ char* json_load_file(const char *file_name);
 void json_skip_spaces(const char** text);
 
 char *json_read_string(const char **text);
-int32_t json_read_integer(const char** text); 
+int64_t json_read_integer(const char** text); 
 BejSet* json_read_object(const char **text); 
 
 BejSet* json_read_value(const char **text); 
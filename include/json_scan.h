@@ -0,0 +1,30 @@
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stddef.h>
+
+/*character classification kernels*/
+typedef enum JsonScanImpl
+{
+  JSON_SCAN_SCALAR,
+  JSON_SCAN_SSE2, /*16 bytes at a time*/
+  JSON_SCAN_AVX2  /*32 bytes at a time*/
+} JsonScanImpl;
+
+#define JSON_UNESCAPE_ERROR ((size_t)-1)
+
+
+const char *json_scan_spaces(const char *p);
+
+const char *json_scan_string_run(const char *p);
+
+const char *json_scan_string(const char *p, int *escaped);
+
+size_t json_unescape(char *out, const char *in, size_t length);
+
+
+JsonScanImpl json_scan_impl(void);
+
+int json_scan_use(JsonScanImpl impl);
+
+#endif
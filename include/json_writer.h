@@ -0,0 +1,74 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_PRETTY 0
+#define JSON_COMPACT 1
+
+#define JSON_WRITER_CHUNK 4096
+
+typedef enum JsonWriterTarget
+{
+  JSON_WRITER_BUFFER,   /*growable memory buffer*/
+  JSON_WRITER_FD,       /*file descriptor*/
+  JSON_WRITER_CALLBACK  /*user function*/
+} JsonWriterTarget;
+
+/*returns 0 on success*/
+typedef int (*JsonWriteFn)(void *user, const char *data, size_t length);
+
+typedef struct JsonWriter
+{
+  char *buf;
+  size_t len;
+  size_t cap;
+  JsonWriterTarget target;
+  int fd;
+  JsonWriteFn write;
+  void *user;
+  int pretty;
+  int depth;      /*number of open objects*/
+  int need_comma; /*a value was completed in the current object*/
+  int error;
+} JsonWriter;
+
+
+int json_writer_init_buffer(JsonWriter *w, int style);
+
+int json_writer_init_fd(JsonWriter *w, int fd, int style);
+
+int json_writer_init_callback(JsonWriter *w, JsonWriteFn write, void *user, int style);
+
+void json_writer_raw(JsonWriter *w, const char *data, size_t length);
+
+void json_writer_begin_object(JsonWriter *w);
+
+void json_writer_end_object(JsonWriter *w);
+
+void json_writer_begin_array(JsonWriter *w);
+
+void json_writer_end_array(JsonWriter *w);
+
+void json_writer_element(JsonWriter *w);
+
+void json_writer_key(JsonWriter *w, const char *name, size_t length);
+
+void json_writer_integer(JsonWriter *w, int64_t value);
+
+void json_writer_string(JsonWriter *w, const char *value, size_t length);
+
+void json_writer_real(JsonWriter *w, double value);
+
+void json_writer_boolean(JsonWriter *w, int value);
+
+void json_writer_null(JsonWriter *w);
+
+int json_writer_flush(JsonWriter *w);
+
+void json_writer_free(JsonWriter *w);
+
+size_t json_itoa(char *out, int64_t value);
+
+#endif
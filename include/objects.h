@@ -11,7 +11,9 @@ typedef enum BejType
   BEJ_NULL = 0x02,
   BEJ_INTEGER = 0x03,
   BEJ_ENUM = 0x04,
-  BEJ_STRING = 0x05 
+  BEJ_STRING = 0x05,
+  BEJ_REAL = 0x06,
+  BEJ_BOOLEAN = 0x07
 
 } BejType;
 
@@ -25,7 +27,7 @@ typedef struct JsonPair
 {   union
     {
       char *key; /*for json parsing*/
-      uint8_t id;  /*for bej parsing*/
+      uint16_t id; /*for bej parsing*/
     };
     struct BejSet* value;
 } JsonPair;
@@ -37,23 +39,36 @@ typedef struct BejSet
     BejType type;
     union 
     {
-        char* string_value;
-        int32_t integer_value;
         struct
         {
-            JsonPair* pairs;
+            char* data;
+            uint32_t length;
+            uint8_t borrowed; /*view into the input, not owned*/
+        } string_value;
+        int64_t integer_value;
+        double real_value;
+        uint8_t boolean_value;
+        uint16_t enum_value; /*option ID, named in the children of the entry*/
+        struct
+        {
+            JsonPair* pairs; /*array elements carry their index as ID*/
             uint16_t count;
-        } object_value;
+        } object_value; /*SET and ARRAY*/
     };
 } BejSet;
 
 
+/*Forward declaration*/
+struct BejDictIndex;
+
 /*dictionary structure*/
 typedef struct BejDictionary
 {
     uint16_t id;
     const char* name;
     BejType type;
+    struct BejDictionary* children;   /*members of a SET entry, NULL if none*/
+    const struct BejDictIndex* index; /*lookup tables, first entry only*/
 } BejDictionary;
 
 
@@ -0,0 +1,132 @@
+/**
+ * @file bej_arena.c
+ * @brief Bump allocator for decoded BEJ trees
+ *
+ * All nodes, pair arrays and strings of one message can be taken from
+ * an arena and released together by resetting it, instead of walking
+ * the tree with bej_free().
+ */
+
+#include <stdlib.h>
+#include "../include/bej_arena.h"
+
+/**
+ * @brief Size of the block header rounded up to the arena alignment
+ */
+#define BEJ_ARENA_HEADER \
+  ((sizeof(BejArenaBlock) + BEJ_ARENA_ALIGN - 1) & ~(size_t)(BEJ_ARENA_ALIGN - 1))
+
+/**
+ * @brief Initializes an empty arena
+ *
+ * No memory is allocated until the first bej_arena_alloc() call.
+ *
+ * @param arena Arena to initialize
+ * @param block_size Usable size of each block, 0 selects BEJ_ARENA_BLOCK_SIZE
+ */
+void bej_arena_init(BejArena *arena, size_t block_size)
+{
+  arena->head = NULL;
+  arena->current = NULL;
+  arena->block_size = block_size ? block_size : BEJ_ARENA_BLOCK_SIZE;
+}
+
+/**
+ * @brief Allocates a new block and links it after the current one
+ *
+ * @param arena Arena to grow
+ * @param size Minimum usable size of the block
+ * @return Pointer to the new block, or NULL on error
+ */
+static BejArenaBlock *bej_arena_grow(BejArena *arena, size_t size)
+{
+  if (size < arena->block_size) size = arena->block_size;
+
+  BejArenaBlock *block = malloc(BEJ_ARENA_HEADER + size);
+  if (!block)
+    return NULL;
+
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  if (arena->current)
+    arena->current->next = block;
+  else
+    arena->head = block;
+  arena->current = block;
+
+  return block;
+}
+
+/**
+ * @brief Allocates memory from the arena
+ *
+ * Bumps the current block. When it is full, blocks kept from before the
+ * last reset are reused before a new one is allocated.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes to allocate
+ * @return Pointer aligned to BEJ_ARENA_ALIGN, or NULL on error
+ * @note Memory is released only by bej_arena_reset() or bej_arena_destroy()
+ */
+void *bej_arena_alloc(BejArena *arena, size_t size)
+{
+  size = (size + BEJ_ARENA_ALIGN - 1) & ~(size_t)(BEJ_ARENA_ALIGN - 1);
+
+  BejArenaBlock *block = arena->current;
+  while (block && block->size - block->used < size)
+  {
+    if (!block->next)
+    {
+      block = NULL;
+      break;
+    }
+    block = block->next;
+    block->used = 0;
+    arena->current = block;
+  }
+
+  if (!block)
+  {
+    block = bej_arena_grow(arena, size);
+    if (!block)
+      return NULL;
+  }
+
+  void *ptr = (uint8_t *)block + BEJ_ARENA_HEADER + block->used;
+  block->used += size;
+  return ptr;
+}
+
+/**
+ * @brief Releases everything allocated from the arena in O(1)
+ *
+ * Blocks stay owned by the arena and are reused by later allocations.
+ *
+ * @param arena Arena to reset
+ */
+void bej_arena_reset(BejArena *arena)
+{
+  if (arena->head)
+    arena->head->used = 0;
+  arena->current = arena->head;
+}
+
+/**
+ * @brief Frees all blocks owned by the arena
+ *
+ * @param arena Arena to destroy, it can be initialized again afterwards
+ */
+void bej_arena_destroy(BejArena *arena)
+{
+  BejArenaBlock *block = arena->head;
+  while (block)
+  {
+    BejArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->head = NULL;
+  arena->current = NULL;
+}
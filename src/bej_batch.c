@@ -0,0 +1,320 @@
+/**
+ * @file bej_batch.c
+ * @brief Parallel conversion of many BEJ files
+ *
+ * Converts a list of BEJ files to JSON on a work-stealing pool. Every
+ * worker owns an arena for the decoded trees and a JSON writer, both
+ * reused from file to file, so the steady state allocates nothing. Each
+ * file becomes a JSON file of its own or one line of an NDJSON stream.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../include/bej_batch.h"
+
+#define BEJ_BATCH_PATH_SIZE 4096
+
+/*state owned by one pool worker*/
+typedef struct BejBatchWorker
+{
+  BejArena arena;
+  JsonWriter w;
+  int ready;      /*arena and writer are initialized*/
+  size_t files;
+  size_t failed;
+  size_t bytes_in;
+  size_t bytes_out;
+} BejBatchWorker;
+
+/*shared by all workers*/
+typedef struct BejBatch
+{
+  const char *const *files;
+  const BejBatchOptions *options;
+  BejDictionary *members; /*dictionary of the root members*/
+  BejBatchWorker *workers;
+  pthread_mutex_t output_lock; /*keeps NDJSON lines whole*/
+} BejBatch;
+
+/**
+ * @brief Writes a whole buffer to a file descriptor
+ *
+ * @return 0 on success, -1 on error
+ */
+static int bej_batch_write(int fd, const char *data, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t n = write(fd, data, length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    data += n;
+    length -= (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief Builds the output path of a file: the name without directory
+ *        and extension, in the output directory, with .json appended
+ *
+ * @return 0 on success, -1 if the path does not fit
+ */
+static int bej_batch_output_path(char *out, const char *dir, const char *file)
+{
+  const char *base = strrchr(file, '/');
+  base = base ? base + 1 : file;
+  const char *dot = strrchr(base, '.');
+  int length = dot && dot != base ? (int)(dot - base) : (int)strlen(base);
+
+  int n = snprintf(out, BEJ_BATCH_PATH_SIZE, "%s/%.*s.json", dir ? dir : ".", length, base);
+  return n > 0 && n < BEJ_BATCH_PATH_SIZE ? 0 : -1;
+}
+
+/*output path of one input, for finding clashes*/
+typedef struct BejBatchOutput
+{
+  char *path;
+  const char *file;
+} BejBatchOutput;
+
+/**
+ * @brief Orders outputs by path
+ */
+static int bej_batch_output_compare(const void *a, const void *b)
+{
+  return strcmp(((const BejBatchOutput *)a)->path, ((const BejBatchOutput *)b)->path);
+}
+
+/**
+ * @brief Checks that no two files write the same output file
+ *
+ * Outputs are named after the input's base name, so inputs with the same
+ * name in different directories would overwrite each other. Every clash
+ * is reported on stderr.
+ *
+ * @param files Paths of the BEJ files
+ * @param count Number of files
+ * @param dir Output directory
+ * @return BEJ_OK, BEJ_ERR_IO if outputs clash, BEJ_ERR_NOMEM
+ */
+static BejError bej_batch_check_outputs(const char *const *files, size_t count, const char *dir)
+{
+  BejBatchOutput *outputs = malloc(sizeof(BejBatchOutput) * (count ? count : 1));
+  if (!outputs)
+    return BEJ_ERR_NOMEM;
+
+  /* Paths that do not fit fail on their own when converted */
+  size_t n = 0;
+  BejError error = BEJ_OK;
+  for (size_t i = 0; i < count && error == BEJ_OK; i++)
+  {
+    char path[BEJ_BATCH_PATH_SIZE];
+    if (bej_batch_output_path(path, dir, files[i]) != 0)
+      continue;
+    outputs[n].path = strdup(path);
+    outputs[n].file = files[i];
+    if (!outputs[n].path)
+      error = BEJ_ERR_NOMEM;
+    else
+      n++;
+  }
+
+  qsort(outputs, n, sizeof(BejBatchOutput), bej_batch_output_compare);
+  for (size_t i = 1; i < n && error != BEJ_ERR_NOMEM; i++)
+  {
+    if (strcmp(outputs[i - 1].path, outputs[i].path) == 0)
+    {
+      fprintf(stderr, "%s, %s: both write %s\n", outputs[i - 1].file, outputs[i].file, outputs[i].path);
+      error = BEJ_ERR_IO;
+    }
+  }
+
+  for (size_t i = 0; i < n; i++)
+    free(outputs[i].path);
+  free(outputs);
+  return error;
+}
+
+/**
+ * @brief Writes the JSON of one decoded file
+ *
+ * @param batch Batch
+ * @param worker Worker that decoded the file
+ * @param file Input path
+ * @param root Decoded value
+ * @return BEJ_OK, BEJ_ERR_NOMEM or BEJ_ERR_IO
+ */
+static BejError bej_batch_emit(BejBatch *batch, BejBatchWorker *worker, const char *file, BejSet *root)
+{
+  const BejBatchOptions *options = batch->options;
+  JsonWriter *w = &worker->w;
+  w->len = 0;
+
+  if (options->ndjson_fd >= 0)
+  {
+    json_writer_begin_object(w);
+    json_writer_key(w, "file", 4);
+    json_writer_string(w, file, strlen(file));
+    json_writer_key(w, "value", 5);
+    bej_to_json_writer(root, batch->members, w);
+    json_writer_end_object(w);
+  }
+  else
+  {
+    bej_to_json_writer(root, batch->members, w);
+  }
+  json_writer_raw(w, "\n", 1);
+  if (w->error)
+    return BEJ_ERR_NOMEM;
+
+  int failed;
+  if (options->ndjson_fd >= 0)
+  {
+    pthread_mutex_lock(&batch->output_lock);
+    failed = bej_batch_write(options->ndjson_fd, w->buf, w->len);
+    pthread_mutex_unlock(&batch->output_lock);
+  }
+  else
+  {
+    char path[BEJ_BATCH_PATH_SIZE];
+    int fd = bej_batch_output_path(path, options->output_dir, file) == 0
+             ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    failed = fd < 0 || bej_batch_write(fd, w->buf, w->len) != 0;
+    if (fd >= 0 && close(fd) != 0)
+      failed = 1;
+  }
+  if (failed)
+    return BEJ_ERR_IO;
+
+  worker->bytes_out += w->len;
+  return BEJ_OK;
+}
+
+/**
+ * @brief Converts one file, a pool task
+ *
+ * @param user The batch
+ * @param index Worker running the task
+ * @param task Index of the file
+ */
+static void bej_batch_file(void *user, uint32_t index, size_t task)
+{
+  BejBatch *batch = user;
+  BejBatchWorker *worker = &batch->workers[index];
+  const char *file = batch->files[task];
+
+  if (!worker->ready)
+  {
+    bej_arena_init(&worker->arena, 0);
+    json_writer_init_buffer(&worker->w, batch->options->ndjson_fd >= 0
+                                        ? JSON_COMPACT : batch->options->style);
+    worker->ready = 1;
+  }
+  worker->files++;
+
+  BejMapping map;
+  BejError error = bej_map_file(file, &map);
+  if (error == BEJ_OK)
+  {
+    bej_arena_reset(&worker->arena);
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, map.data, map.size);
+    ctx.arena = &worker->arena;
+
+    BejSet *root = bej_read_value(&ctx, batch->options->dict);
+    error = root ? bej_batch_emit(batch, worker, file, root) : ctx.error;
+    worker->bytes_in += map.size;
+    bej_unmap_file(&map);
+  }
+
+  if (error != BEJ_OK)
+  {
+    worker->failed++;
+    fprintf(stderr, "%s: %s\n", file, bej_error_string(error));
+  }
+}
+
+/**
+ * @brief Converts BEJ files to JSON on several threads
+ *
+ * Files are decoded in any order. With per-file output every file gets
+ * its own JSON file; with NDJSON every file becomes one line
+ * {"file": path, "value": ...}, written whole but in completion order.
+ * Failed files are reported on stderr and counted, the others still run.
+ * Per-file output is checked first: if two inputs would write the same
+ * JSON file, nothing is converted.
+ *
+ * @param files Paths of the BEJ files
+ * @param count Number of files
+ * @param options Threads, output and dictionary
+ * @param stats Pointer to store the totals, can be NULL
+ * @return BEJ_OK if every file was converted, BEJ_ERR_IO if some failed
+ *         or outputs clash, BEJ_ERR_NOMEM if the pool cannot be set up
+ */
+BejError bej_batch_run(const char *const *files, size_t count, const BejBatchOptions *options,
+                       BejBatchStats *stats)
+{
+  if (stats)
+    memset(stats, 0, sizeof(*stats));
+  if (options->ndjson_fd < 0)
+  {
+    BejError error = bej_batch_check_outputs(files, count, options->output_dir);
+    if (error != BEJ_OK)
+      return error;
+  }
+
+  uint32_t workers = options->threads ? options->threads : bej_pool_cpu_count();
+  if (workers > BEJ_POOL_MAX_WORKERS)
+    workers = BEJ_POOL_MAX_WORKERS;
+
+  BejBatch batch;
+  batch.files = files;
+  batch.options = options;
+  batch.members = bej_dictionary_child(options->dict, 0);
+  batch.workers = calloc(workers, sizeof(BejBatchWorker));
+  if (!batch.workers)
+    return BEJ_ERR_NOMEM;
+  pthread_mutex_init(&batch.output_lock, NULL);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  BejPoolStats pool = {0, 0};
+  int failed = bej_pool_run(workers, count, bej_batch_file, &batch, &pool);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  BejBatchStats total;
+  memset(&total, 0, sizeof(total));
+  for (uint32_t i = 0; i < workers; i++)
+  {
+    BejBatchWorker *worker = &batch.workers[i];
+    total.files += worker->files;
+    total.failed += worker->failed;
+    total.bytes_in += worker->bytes_in;
+    total.bytes_out += worker->bytes_out;
+    if (worker->ready)
+    {
+      bej_arena_destroy(&worker->arena);
+      json_writer_free(&worker->w);
+    }
+  }
+  total.seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  total.pool = pool;
+
+  pthread_mutex_destroy(&batch.output_lock);
+  free(batch.workers);
+  if (stats)
+    *stats = total;
+
+  if (failed != 0)
+    return BEJ_ERR_NOMEM;
+  return total.failed ? BEJ_ERR_IO : BEJ_OK;
+}
@@ -0,0 +1,383 @@
+/**
+ * @file bej_cache.c
+ * @brief Decode results cached by payload
+ *
+ * Polling a BMC returns the same bytes most of the time. The cache keeps
+ * a copy of every recent payload together with the tree and the JSON
+ * text made from it, keyed by a 64-bit hash of the bytes seeded with the
+ * dictionary address. A repeated payload costs one hash and one compare
+ * instead of a decode. The least recently used entry is dropped once
+ * the capacity is reached.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_cache.h"
+#include "../include/bej_transcode.h"
+
+#define BEJ_HASH_P1 0x9E3779B185EBCA87ull
+#define BEJ_HASH_P2 0xC2B2AE3D27D4EB4Full
+#define BEJ_HASH_P3 0x165667B19E3779F9ull
+#define BEJ_HASH_P4 0x85EBCA77C2B2AE63ull
+#define BEJ_HASH_P5 0x27D4EB2F165667C5ull
+
+static uint64_t bej_hash_rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t bej_hash_read64(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t bej_hash_read32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t bej_hash_round(uint64_t acc, uint64_t input)
+{
+  acc += input * BEJ_HASH_P2;
+  acc = bej_hash_rotl(acc, 31);
+  return acc * BEJ_HASH_P1;
+}
+
+static uint64_t bej_hash_merge(uint64_t acc, uint64_t lane)
+{
+  acc ^= bej_hash_round(0, lane);
+  return acc * BEJ_HASH_P1 + BEJ_HASH_P4;
+}
+
+/**
+ * @brief Hashes a byte range
+ *
+ * XXH64: four independent lanes take 32 bytes per step, so the hash runs
+ * at several bytes per cycle. Words are read in host byte order, hashes
+ * are only meant for use within one process.
+ *
+ * @param data Bytes to hash
+ * @param size Number of bytes
+ * @param seed Seed mixed into the hash
+ * @return 64-bit hash
+ */
+uint64_t bej_cache_hash(const uint8_t *data, size_t size, uint64_t seed)
+{
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  uint64_t h;
+
+  if (size >= 32)
+  {
+    uint64_t v1 = seed + BEJ_HASH_P1 + BEJ_HASH_P2;
+    uint64_t v2 = seed + BEJ_HASH_P2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - BEJ_HASH_P1;
+    do
+    {
+      v1 = bej_hash_round(v1, bej_hash_read64(p));
+      v2 = bej_hash_round(v2, bej_hash_read64(p + 8));
+      v3 = bej_hash_round(v3, bej_hash_read64(p + 16));
+      v4 = bej_hash_round(v4, bej_hash_read64(p + 24));
+      p += 32;
+    } while (end - p >= 32);
+
+    h = bej_hash_rotl(v1, 1) + bej_hash_rotl(v2, 7) + bej_hash_rotl(v3, 12) + bej_hash_rotl(v4, 18);
+    h = bej_hash_merge(h, v1);
+    h = bej_hash_merge(h, v2);
+    h = bej_hash_merge(h, v3);
+    h = bej_hash_merge(h, v4);
+  }
+  else
+  {
+    h = seed + BEJ_HASH_P5;
+  }
+  h += (uint64_t)size;
+
+  for (; end - p >= 8; p += 8)
+  {
+    h ^= bej_hash_round(0, bej_hash_read64(p));
+    h = bej_hash_rotl(h, 27) * BEJ_HASH_P1 + BEJ_HASH_P4;
+  }
+  if (end - p >= 4)
+  {
+    h ^= (uint64_t)bej_hash_read32(p) * BEJ_HASH_P1;
+    h = bej_hash_rotl(h, 23) * BEJ_HASH_P2 + BEJ_HASH_P3;
+    p += 4;
+  }
+  for (; p < end; p++)
+  {
+    h ^= *p * BEJ_HASH_P5;
+    h = bej_hash_rotl(h, 11) * BEJ_HASH_P1;
+  }
+
+  h ^= h >> 33;
+  h *= BEJ_HASH_P2;
+  h ^= h >> 29;
+  h *= BEJ_HASH_P3;
+  h ^= h >> 32;
+  return h;
+}
+
+/**
+ * @brief Initializes an empty cache
+ *
+ * @param cache Cache to initialize
+ * @param capacity Most payloads kept, at least 1
+ * @param style JSON_PRETTY or JSON_COMPACT, layout of the cached text
+ * @return 0 on success, -1 if the hash table cannot be allocated
+ */
+int bej_cache_init(BejDecodeCache *cache, size_t capacity, int style)
+{
+  memset(cache, 0, sizeof(*cache));
+  cache->capacity = capacity ? capacity : 1;
+  cache->style = style;
+
+  /* One bucket per entry keeps chains short */
+  uint32_t buckets = 16;
+  while (buckets < cache->capacity && buckets < (1u << 30))
+    buckets <<= 1;
+  cache->buckets = calloc(buckets, sizeof(BejCacheEntry *));
+  if (!cache->buckets)
+    return -1;
+  cache->bucket_mask = buckets - 1;
+  return 0;
+}
+
+/**
+ * @brief Takes an entry out of its bucket and the LRU list
+ */
+static void bej_cache_unlink(BejDecodeCache *cache, BejCacheEntry *entry)
+{
+  BejCacheEntry **link = &cache->buckets[entry->hash & cache->bucket_mask];
+  while (*link != entry)
+    link = &(*link)->chain;
+  *link = entry->chain;
+
+  if (entry->newer) entry->newer->older = entry->older;
+  else cache->newest = entry->older;
+  if (entry->older) entry->older->newer = entry->newer;
+  else cache->oldest = entry->newer;
+  cache->count--;
+}
+
+/**
+ * @brief Puts an entry at the front of the LRU list
+ */
+static void bej_cache_push_front(BejDecodeCache *cache, BejCacheEntry *entry)
+{
+  entry->newer = NULL;
+  entry->older = cache->newest;
+  if (cache->newest) cache->newest->newer = entry;
+  else cache->oldest = entry;
+  cache->newest = entry;
+}
+
+/**
+ * @brief Releases an unlinked entry
+ */
+static void bej_cache_entry_free(BejCacheEntry *entry)
+{
+  bej_arena_destroy(&entry->arena);
+  free(entry->json);
+  free(entry->data);
+  free(entry);
+}
+
+/**
+ * @brief Finds the entry of a payload, adding an empty one on a miss
+ *
+ * @param cache Cache
+ * @param data Payload
+ * @param size Payload size in bytes
+ * @param dict Dictionary holding the root entry
+ * @return Entry at the front of the LRU list, or NULL if out of memory
+ */
+static BejCacheEntry *bej_cache_lookup(BejDecodeCache *cache, const uint8_t *data, size_t size,
+                                       const BejDictionary *dict)
+{
+  uint64_t hash = bej_cache_hash(data, size, (uint64_t)(uintptr_t)dict);
+  uint32_t bucket = (uint32_t)hash & cache->bucket_mask;
+
+  for (BejCacheEntry *entry = cache->buckets[bucket]; entry; entry = entry->chain)
+  {
+    if (entry->hash == hash && entry->dict == dict && entry->size == size &&
+        memcmp(entry->data, data, size) == 0)
+    {
+      cache->stats.hits++;
+      if (entry != cache->newest)
+      {
+        /* Unlinking keeps the bucket order, only the LRU position changes */
+        if (entry->newer) entry->newer->older = entry->older;
+        if (entry->older) entry->older->newer = entry->newer;
+        else cache->oldest = entry->newer;
+        bej_cache_push_front(cache, entry);
+      }
+      return entry;
+    }
+  }
+
+  cache->stats.misses++;
+  if (cache->count == cache->capacity)
+  {
+    BejCacheEntry *oldest = cache->oldest;
+    bej_cache_unlink(cache, oldest);
+    bej_cache_entry_free(oldest);
+    cache->stats.evictions++;
+  }
+
+  BejCacheEntry *entry = calloc(1, sizeof(BejCacheEntry));
+  uint8_t *copy = malloc(size ? size : 1);
+  if (!entry || !copy)
+  {
+    free(entry);
+    free(copy);
+    return NULL;
+  }
+  memcpy(copy, data, size);
+  entry->hash = hash;
+  entry->dict = dict;
+  entry->data = copy;
+  entry->size = size;
+  bej_arena_init(&entry->arena, 0);
+
+  entry->chain = cache->buckets[bucket];
+  cache->buckets[bucket] = entry;
+  bej_cache_push_front(cache, entry);
+  cache->count++;
+  return entry;
+}
+
+/**
+ * @brief Drops an entry whose payload could not be decoded
+ *
+ * @return The error, for the caller to pass on
+ */
+static BejError bej_cache_reject(BejDecodeCache *cache, BejCacheEntry *entry, BejError error)
+{
+  bej_cache_unlink(cache, entry);
+  bej_cache_entry_free(entry);
+  return error;
+}
+
+/**
+ * @brief Returns the tree of a payload, decoding it only the first time
+ *
+ * Payloads that fail to decode are not cached.
+ *
+ * @param cache Cache
+ * @param data BEJ payload, the first value is decoded
+ * @param size Payload size in bytes
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @param tree Pointer to store the tree, owned by the cache and valid
+ *             until the next call on it; must not be modified or freed
+ * @return BEJ_OK, or the decoder error
+ */
+BejError bej_cache_tree(BejDecodeCache *cache, const uint8_t *data, size_t size, BejDictionary *dict,
+                        const BejSet **tree)
+{
+  *tree = NULL;
+  BejCacheEntry *entry = bej_cache_lookup(cache, data, size, dict);
+  if (!entry)
+    return BEJ_ERR_NOMEM;
+
+  if (!entry->tree)
+  {
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, entry->data, entry->size);
+    ctx.arena = &entry->arena;
+    entry->tree = bej_read_value(&ctx, dict);
+    if (!entry->tree)
+      return bej_cache_reject(cache, entry, ctx.error);
+  }
+
+  *tree = entry->tree;
+  return BEJ_OK;
+}
+
+/**
+ * @brief Returns the JSON text of a payload, converting it only the first time
+ *
+ * The text is that of bej_transcode_writer() in the style of the cache,
+ * without a trailing newline. Payloads that fail to decode are not cached.
+ *
+ * @param cache Cache
+ * @param data BEJ payload, the first value is converted
+ * @param size Payload size in bytes
+ * @param dict Dictionary holding the root entry
+ * @param json Pointer to store the text, owned by the cache and valid
+ *             until the next call on it, not NUL-terminated
+ * @param length Pointer to store the length of the text
+ * @return BEJ_OK, or the decoder error
+ */
+BejError bej_cache_json(BejDecodeCache *cache, const uint8_t *data, size_t size, BejDictionary *dict,
+                        const char **json, size_t *length)
+{
+  *json = NULL;
+  *length = 0;
+  BejCacheEntry *entry = bej_cache_lookup(cache, data, size, dict);
+  if (!entry)
+    return BEJ_ERR_NOMEM;
+
+  if (!entry->json)
+  {
+    JsonWriter w;
+    if (json_writer_init_buffer(&w, cache->style) != 0)
+      return bej_cache_reject(cache, entry, BEJ_ERR_NOMEM);
+
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, entry->data, entry->size);
+    BejError error = bej_transcode_writer(&ctx, dict, &w);
+    if (error == BEJ_OK && w.error)
+      error = BEJ_ERR_NOMEM;
+    if (error != BEJ_OK)
+    {
+      json_writer_free(&w);
+      return bej_cache_reject(cache, entry, error);
+    }
+    entry->json = w.buf;
+    entry->json_length = w.len;
+  }
+
+  *json = entry->json;
+  *length = entry->json_length;
+  return BEJ_OK;
+}
+
+/**
+ * @brief Drops every entry, the counters are kept
+ *
+ * @param cache Cache
+ */
+void bej_cache_clear(BejDecodeCache *cache)
+{
+  BejCacheEntry *entry = cache->newest;
+  while (entry)
+  {
+    BejCacheEntry *older = entry->older;
+    bej_cache_entry_free(entry);
+    entry = older;
+  }
+  memset(cache->buckets, 0, sizeof(BejCacheEntry *) * ((size_t)cache->bucket_mask + 1));
+  cache->newest = NULL;
+  cache->oldest = NULL;
+  cache->count = 0;
+}
+
+/**
+ * @brief Releases the cache and everything it holds
+ *
+ * @param cache Cache, it has to be initialized again before reuse
+ */
+void bej_cache_destroy(BejDecodeCache *cache)
+{
+  if (cache->buckets)
+    bej_cache_clear(cache);
+  free(cache->buckets);
+  cache->buckets = NULL;
+}
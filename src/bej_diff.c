@@ -0,0 +1,350 @@
+/**
+ * @file bej_diff.c
+ * @brief Structural diff of two BEJ values as JSON Patch
+ *
+ * Walks both encodings side by side without building trees. Every SET
+ * member is a contiguous byte range, so a member whose bytes are equal
+ * in both values is skipped with one memcmp(), however large it is.
+ * Only SETs that differ are opened: their members are located by tag and
+ * length, matched by ID and compared in turn. Changed scalars become
+ * "replace" operations, members present on one side only become "add"
+ * or "remove", with JSON Pointer paths built from dictionary names.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_diff.h"
+#include "../include/bej_transcode.h"
+
+/*one located SET member, offsets from the decoder start*/
+typedef struct BejDiffMember
+{
+  uint16_t id;
+  uint8_t type;
+  size_t tag;      /*offset of the ID*/
+  size_t payload;
+  uint32_t length;
+} BejDiffMember;
+
+/*state of one diff*/
+typedef struct BejDiff
+{
+  BejDecoder *from;
+  BejDecoder *to;
+  JsonWriter *w;           /*NULL: count operations only*/
+  char *path;              /*JSON Pointer of the current SET*/
+  size_t path_len;
+  size_t path_cap;
+  BejDiffMember *members;  /*members of the SETs being compared, a stack*/
+  size_t count;
+  size_t cap;
+  size_t operations;
+  int nomem;
+} BejDiff;
+
+/**
+ * @brief Orders members by ID, then by position
+ */
+static int bej_diff_compare(const void *a, const void *b)
+{
+  const BejDiffMember *x = a;
+  const BejDiffMember *y = b;
+  if (x->id != y->id)
+    return x->id < y->id ? -1 : 1;
+  return x->tag < y->tag ? -1 : x->tag > y->tag;
+}
+
+/**
+ * @brief Locates the members of a SET and appends them, sorted by ID
+ *
+ * Encoders write members in dictionary order, so sorting is skipped
+ * when they already are.
+ *
+ * @param diff Diff
+ * @param ctx Decoder of the SET
+ * @param payload Offset of the SET members
+ * @param length Length of the SET members
+ * @return Number of members, or -1 on error
+ */
+static long bej_diff_scan(BejDiff *diff, BejDecoder *ctx, size_t payload, uint32_t length)
+{
+  const uint8_t *outer_end = ctx->end;
+  size_t base = diff->count;
+  int sorted = 1;
+
+  ctx->cursor = ctx->start + payload;
+  ctx->end = ctx->cursor + length;
+  while (ctx->cursor < ctx->end)
+  {
+    if (diff->count == diff->cap)
+    {
+      size_t cap = diff->cap ? diff->cap * 2 : 64;
+      BejDiffMember *members = realloc(diff->members, sizeof(BejDiffMember) * cap);
+      if (!members)
+      {
+        diff->nomem = 1;
+        break;
+      }
+      diff->members = members;
+      diff->cap = cap;
+    }
+
+    BejDiffMember *member = &diff->members[diff->count];
+    member->tag = (size_t)(ctx->cursor - ctx->start);
+    if (!bej_read_tag(ctx, &member->id, &member->type) || !bej_read_length(ctx, &member->length))
+      break;
+    member->payload = (size_t)(ctx->cursor - ctx->start);
+    ctx->cursor += member->length;
+    if (diff->count > base && member->id < member[-1].id)
+      sorted = 0;
+    diff->count++;
+  }
+  ctx->end = outer_end;
+
+  if (ctx->error != BEJ_OK || diff->nomem)
+    return -1;
+  if (!sorted)
+    qsort(diff->members + base, diff->count - base, sizeof(BejDiffMember), bej_diff_compare);
+  return (long)(diff->count - base);
+}
+
+/**
+ * @brief Appends a dictionary name to the path, escaped as in RFC 6901
+ *
+ * @return Path length before the name, to restore it afterwards
+ */
+static size_t bej_diff_push(BejDiff *diff, BejDictionary *dict, uint16_t id)
+{
+  size_t saved = diff->path_len;
+  const char *name = bej_find_in_dictionary(dict, id, NULL);
+  if (!name) name = "UNKNOWN";
+
+  size_t need = diff->path_len + 1 + 2 * strlen(name);
+  if (need > diff->path_cap)
+  {
+    size_t cap = diff->path_cap ? diff->path_cap : 256;
+    while (cap < need) cap *= 2;
+    char *path = realloc(diff->path, cap);
+    if (!path)
+    {
+      diff->nomem = 1;
+      return saved;
+    }
+    diff->path = path;
+    diff->path_cap = cap;
+  }
+
+  diff->path[diff->path_len++] = '/';
+  for (const char *c = name; *c; c++)
+  {
+    if (*c == '~' || *c == '/')
+    {
+      diff->path[diff->path_len++] = '~';
+      diff->path[diff->path_len++] = *c == '~' ? '0' : '1';
+    }
+    else
+    {
+      diff->path[diff->path_len++] = *c;
+    }
+  }
+  return saved;
+}
+
+/**
+ * @brief Writes one patch operation
+ *
+ * @param diff Diff
+ * @param op "add", "remove" or "replace"
+ * @param value Member of the second value to write as "value", NULL for none
+ * @param dict Dictionary holding the member's entry
+ */
+static void bej_diff_op(BejDiff *diff, const char *op, const BejDiffMember *value, BejDictionary *dict)
+{
+  diff->operations++;
+  JsonWriter *w = diff->w;
+  if (!w || diff->nomem)
+    return;
+
+  json_writer_element(w);
+  json_writer_begin_object(w);
+  json_writer_key(w, "op", 2);
+  json_writer_string(w, op, strlen(op));
+  json_writer_key(w, "path", 4);
+  json_writer_string(w, diff->path ? diff->path : "", diff->path_len);
+  if (value)
+  {
+    BejDecoder *to = diff->to;
+    const uint8_t *outer_end = to->end;
+    to->cursor = to->start + value->tag;
+    to->end = to->start + value->payload + value->length;
+    json_writer_key(w, "value", 5);
+    bej_transcode_writer(to, dict, w);
+    to->end = outer_end;
+  }
+  json_writer_end_object(w);
+}
+
+/**
+ * @brief Returns 1 if two members are encoded with the same bytes
+ */
+static int bej_diff_same(const BejDiff *diff, const BejDiffMember *a, const BejDiffMember *b)
+{
+  size_t size_a = a->payload + a->length - a->tag;
+  size_t size_b = b->payload + b->length - b->tag;
+  return size_a == size_b && memcmp(diff->from->start + a->tag, diff->to->start + b->tag, size_a) == 0;
+}
+
+/**
+ * @brief Opens a SET member for the nesting limit of its decoder
+ *
+ * @param ctx Decoder of the member
+ * @param member SET member, its tag is read again to reach the length
+ * @return 1 on success, 0 with BEJ_ERR_LENGTH past BEJ_DECODE_DEPTH
+ */
+static int bej_diff_enter(BejDecoder *ctx, const BejDiffMember *member)
+{
+  uint16_t id;
+  uint8_t type;
+  ctx->cursor = ctx->start + member->tag;
+  return bej_read_tag(ctx, &id, &type) && bej_decoder_enter(ctx);
+}
+
+/**
+ * @brief Compares the members of two SETs
+ *
+ * @param diff Diff
+ * @param from Members of the first SET
+ * @param to Members of the second SET
+ * @param dict Dictionary of the SET members
+ * @return 1 on success, 0 on error
+ */
+static int bej_diff_set(BejDiff *diff, const BejDiffMember *from, const BejDiffMember *to, BejDictionary *dict)
+{
+  if (from->length == to->length &&
+      memcmp(diff->from->start + from->payload, diff->to->start + to->payload, from->length) == 0)
+    return 1;
+  if (!bej_diff_enter(diff->from, from))
+    return 0;
+  if (!bej_diff_enter(diff->to, to))
+  {
+    bej_decoder_leave(diff->from);
+    return 0;
+  }
+
+  size_t base = diff->count;
+  long from_count = bej_diff_scan(diff, diff->from, from->payload, from->length);
+  long to_count = from_count < 0 ? -1 : bej_diff_scan(diff, diff->to, to->payload, to->length);
+  if (to_count < 0)
+  {
+    diff->count = base;
+    bej_decoder_leave(diff->from);
+    bej_decoder_leave(diff->to);
+    return 0;
+  }
+
+  /* Members live on the stack by index, nested scans may move it */
+  size_t i = base;
+  size_t j = base + (size_t)from_count;
+  size_t from_end = j;
+  size_t to_end = j + (size_t)to_count;
+  int ok = 1;
+
+  while (ok && (i < from_end || j < to_end))
+  {
+    BejDiffMember a = i < from_end ? diff->members[i] : diff->members[j];
+    BejDiffMember b = j < to_end ? diff->members[j] : a;
+    size_t saved;
+
+    if (j == to_end || (i < from_end && a.id < b.id))
+    {
+      saved = bej_diff_push(diff, dict, a.id);
+      bej_diff_op(diff, "remove", NULL, dict);
+      i++;
+    }
+    else if (i == from_end || b.id < a.id)
+    {
+      saved = bej_diff_push(diff, dict, b.id);
+      bej_diff_op(diff, "add", &b, dict);
+      j++;
+    }
+    else
+    {
+      i++;
+      j++;
+      if (bej_diff_same(diff, &a, &b))
+        continue;
+      saved = bej_diff_push(diff, dict, b.id);
+      if (a.type == BEJ_SET && b.type == BEJ_SET)
+        ok = bej_diff_set(diff, &a, &b, bej_dictionary_child(dict, b.id));
+      else
+        bej_diff_op(diff, "replace", &b, dict);
+    }
+    diff->path_len = saved;
+    ok = ok && !diff->nomem && diff->from->error == BEJ_OK && diff->to->error == BEJ_OK;
+  }
+
+  diff->count = base;
+  bej_decoder_leave(diff->from);
+  bej_decoder_leave(diff->to);
+  return ok;
+}
+
+/**
+ * @brief Computes the JSON Patch that turns one BEJ value into another
+ *
+ * Members are matched by ID, so their order does not matter. The patch
+ * is an array of "add", "remove" and "replace" operations in member ID
+ * order; a changed SET is described by its changed members, and a root
+ * that is not a SET on either side is replaced whole (path "").
+ *
+ * @param from Decoder of the old value, the cursor must be at the value ID
+ * @param to Decoder of the new value, the cursor must be at the value ID
+ * @param dict Dictionary holding the root entry, the same for both values
+ * @param w Writer receiving the patch, or NULL to only count the changes
+ * @param operations Pointer to store the number of operations, can be NULL
+ * @return BEJ_OK on success, otherwise the error stored in the decoder of
+ *         the faulty value, or BEJ_ERR_NOMEM
+ * @note Both cursors are left after their values on success
+ */
+BejError bej_diff(BejDecoder *from, BejDecoder *to, BejDictionary *dict, JsonWriter *w,
+                  size_t *operations)
+{
+  BejDiff diff;
+  memset(&diff, 0, sizeof(diff));
+  diff.from = from;
+  diff.to = to;
+  diff.w = w;
+
+  BejDiffMember a, b;
+  a.tag = (size_t)(from->cursor - from->start);
+  b.tag = (size_t)(to->cursor - to->start);
+  if (!bej_read_tag(from, &a.id, &a.type) || !bej_read_length(from, &a.length) ||
+      !bej_read_tag(to, &b.id, &b.type) || !bej_read_length(to, &b.length))
+    return from->error != BEJ_OK ? from->error : to->error;
+  a.payload = (size_t)(from->cursor - from->start);
+  b.payload = (size_t)(to->cursor - to->start);
+
+  if (w)
+    json_writer_begin_array(w);
+  if (a.type == BEJ_SET && b.type == BEJ_SET)
+    bej_diff_set(&diff, &a, &b, bej_dictionary_child(dict, b.id));
+  else if (!bej_diff_same(&diff, &a, &b))
+    bej_diff_op(&diff, "replace", &b, dict);
+  if (w)
+    json_writer_end_array(w);
+
+  free(diff.members);
+  free(diff.path);
+  if (operations)
+    *operations = diff.operations;
+
+  if (from->error != BEJ_OK)
+    return from->error;
+  if (to->error != BEJ_OK)
+    return to->error;
+  if (diff.nomem || (w && w->error))
+    return BEJ_ERR_NOMEM;
+  from->cursor = from->start + a.payload + a.length;
+  to->cursor = to->start + b.payload + b.length;
+  return BEJ_OK;
+}
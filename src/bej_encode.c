@@ -0,0 +1,867 @@
+/**
+ * @file bej_encode.c
+ * @brief JSON to BEJ encoder
+ *
+ * Encodes BejSet trees from json_read_value(), or JSON text directly, into
+ * BEJ. Field names become IDs through reverse dictionary lookups. Every
+ * SET and string is written in a single pass: a length nnint with one
+ * value byte is reserved, the payload follows, and the length is patched
+ * in afterwards. Payloads over 255 bytes need a longer length and are
+ * moved up once.
+ */
+
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_encode.h"
+#include "../include/json_scan.h"
+
+/**
+ * @brief Records an encode error, only the first one is kept
+ *
+ * @param enc Encoder
+ * @param error Error code to record
+ */
+static void bej_encoder_fail(BejEncoder *enc, BejError error)
+{
+  if (enc->error == BEJ_OK)
+    enc->error = error;
+}
+
+/**
+ * @brief Initializes an encoder with an owned, growable buffer
+ *
+ * @param enc Encoder to initialize
+ * @param capacity Initial buffer size, the expected size of the output
+ * @return 0 on success, -1 if the buffer cannot be allocated
+ * @note Release the buffer with bej_encoder_free()
+ */
+int bej_encoder_init(BejEncoder *enc, size_t capacity)
+{
+  memset(enc, 0, sizeof(*enc));
+  enc->growable = 1;
+  enc->cap = capacity ? capacity : 64;
+  enc->buf = malloc(enc->cap);
+  if (!enc->buf)
+  {
+    enc->cap = 0;
+    enc->error = BEJ_ERR_NOMEM;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Initializes an encoder writing into a caller buffer
+ *
+ * Nothing is allocated. Output that does not fit fails with BEJ_ERR_LENGTH.
+ *
+ * @param enc Encoder to initialize
+ * @param buf Output buffer
+ * @param size Size of the buffer in bytes
+ */
+void bej_encoder_init_buffer(BejEncoder *enc, uint8_t *buf, size_t size)
+{
+  memset(enc, 0, sizeof(*enc));
+  enc->buf = buf;
+  enc->cap = size;
+}
+
+/**
+ * @brief Empties the encoder for the next message, keeping its buffer
+ *
+ * @param enc Encoder
+ */
+void bej_encoder_reset(BejEncoder *enc)
+{
+  enc->len = 0;
+  if (enc->buf)
+    enc->error = BEJ_OK;
+}
+
+/**
+ * @brief Releases an owned buffer
+ *
+ * @param enc Encoder, caller buffers are left alone
+ */
+void bej_encoder_free(BejEncoder *enc)
+{
+  if (enc->growable)
+    free(enc->buf);
+  enc->buf = NULL;
+  enc->len = 0;
+  enc->cap = 0;
+}
+
+/**
+ * @brief Makes room for a number of bytes at the end of the output
+ *
+ * @param enc Encoder
+ * @param count Number of bytes that will be appended
+ * @return 1 if the bytes fit, 0 on error
+ */
+static int bej_encoder_reserve(BejEncoder *enc, size_t count)
+{
+  if (enc->error != BEJ_OK)
+    return 0;
+  if (enc->cap - enc->len >= count)
+    return 1;
+
+  if (!enc->growable)
+  {
+    bej_encoder_fail(enc, BEJ_ERR_LENGTH);
+    return 0;
+  }
+
+  size_t cap = enc->cap * 2;
+  while (cap - enc->len < count) cap *= 2;
+
+  uint8_t *buf = realloc(enc->buf, cap);
+  if (!buf)
+  {
+    bej_encoder_fail(enc, BEJ_ERR_NOMEM);
+    return 0;
+  }
+  enc->buf = buf;
+  enc->cap = cap;
+  return 1;
+}
+
+/**
+ * @brief Formats a non-negative integer (nnint)
+ *
+ * Inverse of the decoder's nnint: the number of value bytes, at least one,
+ * then the value little-endian.
+ *
+ * @param out Buffer of at least 5 bytes
+ * @param value Value to format
+ * @return Number of bytes written
+ */
+static size_t bej_put_nnint(uint8_t *out, uint32_t value)
+{
+  size_t n = 1;
+  do
+  {
+    out[n++] = (uint8_t)value;
+    value >>= 8;
+  } while (value > 0);
+  out[0] = (uint8_t)(n - 1);
+  return n;
+}
+
+/**
+ * @brief Returns the number of bytes bej_put_nnint() writes for a value
+ */
+static size_t bej_nnint_size(uint32_t value)
+{
+  size_t n = 2;
+  while (value > 0xFF)
+  {
+    value >>= 8;
+    n++;
+  }
+  return n;
+}
+
+/**
+ * @brief Writes a value tag and reserves a one-byte nnint for its length
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ * @param type BEJ type of the value
+ * @return Offset of the reserved length
+ */
+static size_t bej_encode_open(BejEncoder *enc, uint16_t id, BejType type)
+{
+  if (!bej_encoder_reserve(enc, bej_nnint_size(id) + 3))
+    return enc->len;
+
+  enc->len += bej_put_nnint(enc->buf + enc->len, id);
+  enc->buf[enc->len++] = (uint8_t)type;
+  size_t mark = enc->len;
+  enc->buf[enc->len++] = 1;
+  enc->buf[enc->len++] = 0;
+  return mark;
+}
+
+/**
+ * @brief Patches the length of a value opened with bej_encode_open()
+ *
+ * @param enc Encoder
+ * @param mark Offset returned by bej_encode_open()
+ */
+static void bej_encode_close(BejEncoder *enc, size_t mark)
+{
+  if (enc->error != BEJ_OK)
+    return;
+
+  size_t length = enc->len - mark - 2;
+  if (length <= 0xFF)
+  {
+    enc->buf[mark + 1] = (uint8_t)length;
+    return;
+  }
+  if (length > UINT32_MAX)
+  {
+    bej_encoder_fail(enc, BEJ_ERR_LENGTH);
+    return;
+  }
+
+  uint8_t prefix[5];
+  size_t n = bej_put_nnint(prefix, (uint32_t)length);
+  if (!bej_encoder_reserve(enc, n - 2))
+    return;
+
+  memmove(enc->buf + mark + n, enc->buf + mark + 2, length);
+  memcpy(enc->buf + mark, prefix, n);
+  enc->len += n - 2;
+}
+
+/**
+ * @brief Starts a SET
+ *
+ * Write the members next, then call bej_encode_end_set().
+ *
+ * @param enc Encoder
+ * @param id ID of the SET
+ * @return Mark to pass to bej_encode_end_set()
+ */
+size_t bej_encode_begin_set(BejEncoder *enc, uint16_t id)
+{
+  return bej_encode_open(enc, id, BEJ_SET);
+}
+
+/**
+ * @brief Ends a SET and patches its length
+ *
+ * @param enc Encoder
+ * @param mark Value returned by bej_encode_begin_set()
+ */
+void bej_encode_end_set(BejEncoder *enc, size_t mark)
+{
+  bej_encode_close(enc, mark);
+}
+
+/**
+ * @brief Writes an INTEGER value
+ *
+ * Stores the fewest little-endian two's complement bytes that keep the sign.
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ * @param value Integer to write
+ */
+void bej_encode_integer(BejEncoder *enc, uint16_t id, int64_t value)
+{
+  size_t n = 1;
+  while (n < 8)
+  {
+    int64_t limit = (int64_t)1 << (8 * n - 1);
+    if (value >= -limit && value < limit) break;
+    n++;
+  }
+
+  if (!bej_encoder_reserve(enc, bej_nnint_size(id) + 3 + n))
+    return;
+  enc->len += bej_put_nnint(enc->buf + enc->len, id);
+  enc->buf[enc->len++] = BEJ_INTEGER;
+  enc->buf[enc->len++] = 1;
+  enc->buf[enc->len++] = (uint8_t)n;
+  for (size_t i = 0; i < n; i++)
+    enc->buf[enc->len++] = (uint8_t)((uint64_t)value >> (8 * i));
+}
+
+/**
+ * @brief Writes a STRING value
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ * @param value String bytes, not necessarily null-terminated
+ * @param length Number of bytes
+ */
+void bej_encode_string(BejEncoder *enc, uint16_t id, const char *value, size_t length)
+{
+  if (length > UINT32_MAX)
+  {
+    bej_encoder_fail(enc, BEJ_ERR_LENGTH);
+    return;
+  }
+  if (!bej_encoder_reserve(enc, bej_nnint_size(id) + 1 + bej_nnint_size((uint32_t)length) + length))
+    return;
+
+  enc->len += bej_put_nnint(enc->buf + enc->len, id);
+  enc->buf[enc->len++] = BEJ_STRING;
+  enc->len += bej_put_nnint(enc->buf + enc->len, (uint32_t)length);
+  memcpy(enc->buf + enc->len, value, length);
+  enc->len += length;
+}
+
+/**
+ * @brief Starts an ARRAY
+ *
+ * Write the elements next, tagged with their index, then call
+ * bej_encode_end_array().
+ *
+ * @param enc Encoder
+ * @param id ID of the array
+ * @return Mark to pass to bej_encode_end_array()
+ */
+size_t bej_encode_begin_array(BejEncoder *enc, uint16_t id)
+{
+  return bej_encode_open(enc, id, BEJ_ARRAY);
+}
+
+/**
+ * @brief Ends an ARRAY, inserting its element count and patching its length
+ *
+ * The count is only known once the elements are written, so it is moved
+ * in front of them like a long length.
+ *
+ * @param enc Encoder
+ * @param mark Value returned by bej_encode_begin_array()
+ * @param count Number of elements written
+ */
+void bej_encode_end_array(BejEncoder *enc, size_t mark, uint16_t count)
+{
+  uint8_t prefix[5];
+  size_t n = bej_put_nnint(prefix, count);
+  if (!bej_encoder_reserve(enc, n))
+    return;
+
+  memmove(enc->buf + mark + 2 + n, enc->buf + mark + 2, enc->len - mark - 2);
+  memcpy(enc->buf + mark + 2, prefix, n);
+  enc->len += n;
+  bej_encode_close(enc, mark);
+}
+
+/**
+ * @brief Writes a value with a fixed-size payload
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ * @param type BEJ type of the value
+ * @param payload Payload bytes
+ * @param length Payload length, below 256
+ */
+static void bej_encode_fixed(BejEncoder *enc, uint16_t id, BejType type, const uint8_t *payload,
+                             size_t length)
+{
+  if (!bej_encoder_reserve(enc, bej_nnint_size(id) + 3 + length))
+    return;
+  enc->len += bej_put_nnint(enc->buf + enc->len, id);
+  enc->buf[enc->len++] = (uint8_t)type;
+  enc->buf[enc->len++] = 1;
+  enc->buf[enc->len++] = (uint8_t)length;
+  if (length > 0)
+    memcpy(enc->buf + enc->len, payload, length);
+  enc->len += length;
+}
+
+/**
+ * @brief Writes a NULL value
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ */
+void bej_encode_null(BejEncoder *enc, uint16_t id)
+{
+  bej_encode_fixed(enc, id, BEJ_NULL, NULL, 0);
+}
+
+/**
+ * @brief Writes a BOOLEAN value
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ * @param value Non-zero for true
+ */
+void bej_encode_boolean(BejEncoder *enc, uint16_t id, int value)
+{
+  uint8_t byte = value != 0;
+  bej_encode_fixed(enc, id, BEJ_BOOLEAN, &byte, 1);
+}
+
+/**
+ * @brief Writes a REAL value as a little-endian IEEE 754 binary64
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ * @param value Number to write
+ */
+void bej_encode_real(BejEncoder *enc, uint16_t id, double value)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint8_t payload[8];
+  for (size_t i = 0; i < sizeof(payload); i++)
+    payload[i] = (uint8_t)(bits >> (8 * i));
+  bej_encode_fixed(enc, id, BEJ_REAL, payload, sizeof(payload));
+}
+
+/**
+ * @brief Writes an ENUM value
+ *
+ * @param enc Encoder
+ * @param id ID of the value
+ * @param option ID of the option in the children of the enum's entry
+ */
+void bej_encode_enum(BejEncoder *enc, uint16_t id, uint16_t option)
+{
+  uint8_t payload[5];
+  bej_encode_fixed(enc, id, BEJ_ENUM, payload, bej_put_nnint(payload, option));
+}
+
+/**
+ * @brief Encodes the members of a SET node
+ *
+ * @param enc Encoder
+ * @param set SET node with named pairs
+ * @param dict Dictionary of the members
+ */
+static void bej_encode_members(BejEncoder *enc, BejSet *set, BejDictionary *dict)
+{
+  for (uint16_t i = 0; i < set->object_value.count && enc->error == BEJ_OK; i++)
+  {
+    const char *key = set->object_value.pairs[i].key;
+    BejSet *value = set->object_value.pairs[i].value;
+
+    BejType type;
+    int32_t id = bej_find_id_in_dictionary(dict, key, strlen(key), &type);
+    if (id < 0)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SCHEMA);
+      return;
+    }
+    if (value->type != type)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_TYPE);
+      return;
+    }
+
+    if (type == BEJ_SET)
+    {
+      size_t mark = bej_encode_begin_set(enc, (uint16_t)id);
+      bej_encode_members(enc, value, bej_dictionary_child(dict, (uint16_t)id));
+      bej_encode_end_set(enc, mark);
+    }
+    else if (type == BEJ_INTEGER)
+      bej_encode_integer(enc, (uint16_t)id, value->integer_value);
+    else if (type == BEJ_STRING)
+      bej_encode_string(enc, (uint16_t)id, value->string_value.data, value->string_value.length);
+    else
+      bej_encoder_fail(enc, BEJ_ERR_TYPE);
+  }
+}
+
+/**
+ * @brief Encodes a tree built by json_read_value()
+ *
+ * The root SET is written with ID 0, its members are named in the
+ * children of the root entry.
+ *
+ * @param enc Encoder, output is appended
+ * @param root SET node whose pairs carry names
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @return BEJ_OK, BEJ_ERR_SCHEMA for a name not in the dictionary,
+ *         BEJ_ERR_TYPE if a value does not have the dictionary type,
+ *         BEJ_ERR_LENGTH or BEJ_ERR_NOMEM if the output does not fit
+ */
+BejError bej_encode_tree(BejEncoder *enc, BejSet *root, BejDictionary *dict)
+{
+  if (!root || root->type != BEJ_SET)
+  {
+    bej_encoder_fail(enc, BEJ_ERR_TYPE);
+    return enc->error;
+  }
+
+  size_t mark = bej_encode_begin_set(enc, 0);
+  bej_encode_members(enc, root, bej_dictionary_child(dict, 0));
+  bej_encode_end_set(enc, mark);
+  return enc->error;
+}
+
+/**
+ * @brief Writes an unescaped JSON string into the output
+ *
+ * The closing quote is found with the vector scanner. Strings without
+ * escapes are copied at once, the others are decoded straight into the
+ * output, which never needs more room than the escaped text.
+ *
+ * @param enc Encoder
+ * @param text Text after the opening quote, left after the closing quote
+ */
+static void bej_json_unescape(BejEncoder *enc, const char **text)
+{
+  int escaped;
+  const char *close = json_scan_string(*text, &escaped);
+  if (!close)
+  {
+    bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+    return;
+  }
+
+  size_t length = (size_t)(close - *text);
+  if (!bej_encoder_reserve(enc, length))
+    return;
+
+  if (escaped)
+  {
+    length = json_unescape((char *)enc->buf + enc->len, *text, length);
+    if (length == JSON_UNESCAPE_ERROR)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+      return;
+    }
+  }
+  else
+  {
+    memcpy(enc->buf + enc->len, *text, length);
+  }
+  enc->len += length;
+  *text = close + 1;
+}
+
+/**
+ * @brief Reads a JSON integer
+ *
+ * @param enc Encoder, receives BEJ_ERR_TYPE for fractions and exponents
+ * @param text Text at the number, left after it
+ * @param value Pointer to store the integer
+ * @return 1 on success, 0 on error
+ */
+static int bej_json_integer(BejEncoder *enc, const char **text, int64_t *value)
+{
+  const char *p = *text;
+  int negative = *p == '-';
+  if (negative) p++;
+  if (*p < '0' || *p > '9')
+  {
+    bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+    return 0;
+  }
+
+  uint64_t v = 0;
+  uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+  while (*p >= '0' && *p <= '9')
+  {
+    unsigned digit = (unsigned)(*p++ - '0');
+    if (v > (limit - digit) / 10)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_LENGTH);
+      return 0;
+    }
+    v = v * 10 + digit;
+  }
+  if (*p == '.' || *p == 'e' || *p == 'E')
+  {
+    bej_encoder_fail(enc, BEJ_ERR_TYPE);
+    return 0;
+  }
+
+  *value = negative ? (int64_t)(0 - v) : (int64_t)v;
+  *text = p;
+  return 1;
+}
+
+/**
+ * @brief Reads a JSON number as a double
+ *
+ * strtod() expects the locale's decimal point, so under a locale where it
+ * is not '.' the number is copied with the point replaced first.
+ *
+ * @param enc Encoder, receives BEJ_ERR_SYNTAX
+ * @param text Text at the number, left after it
+ * @param value Pointer to store the number
+ * @return 1 on success, 0 on error
+ */
+static int bej_json_real(BejEncoder *enc, const char **text, double *value)
+{
+  const char *point = localeconv()->decimal_point;
+  char *end;
+  if (strcmp(point, ".") == 0)
+  {
+    *value = strtod(*text, &end);
+  }
+  else
+  {
+    size_t length = strspn(*text, "+-0123456789.eE");
+    size_t size = strlen(point);
+    char number[64];
+    if (length + size > sizeof(number))
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+      return 0;
+    }
+    const char *dot = memchr(*text, '.', length);
+    size_t before = dot ? (size_t)(dot - *text) : length;
+    memcpy(number, *text, before);
+    if (dot)
+    {
+      memcpy(number + before, point, size);
+      memcpy(number + before + size, dot + 1, length - before - 1);
+      number[length - 1 + size] = '\0';
+    }
+    else
+      number[length] = '\0';
+
+    *value = strtod(number, &end);
+    size_t used = (size_t)(end - number);
+    end = (char *)*text + (dot && used > before ? used - (size - 1) : used);
+  }
+
+  if (end == *text || !isfinite(*value))
+  {
+    bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+    return 0;
+  }
+  *text = end;
+  return 1;
+}
+
+static void bej_json_value(BejEncoder *enc, const char **text, uint16_t tag, uint16_t id,
+                           BejType type, BejDictionary *dict);
+
+/**
+ * @brief Encodes the members of a JSON object
+ *
+ * @param enc Encoder
+ * @param text Text after the opening brace, left after the closing brace
+ * @param dict Dictionary of the members
+ */
+static void bej_json_members(BejEncoder *enc, const char **text, BejDictionary *dict)
+{
+  *text = json_scan_spaces(*text);
+  if (**text == '}')
+  {
+    (*text)++;
+    return;
+  }
+
+  while (enc->error == BEJ_OK)
+  {
+    if (**text != '"')
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+      return;
+    }
+    /* Dictionary names need no escapes, the raw bytes are looked up */
+    int escaped;
+    const char *key = *text + 1;
+    const char *close = json_scan_string(key, &escaped);
+    if (!close)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+      return;
+    }
+    size_t length = (size_t)(close - key);
+    *text = close + 1;
+
+    *text = json_scan_spaces(*text);
+    if (**text != ':')
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+      return;
+    }
+    (*text)++;
+    *text = json_scan_spaces(*text);
+
+    BejType type;
+    int32_t id = bej_find_id_in_dictionary(dict, key, length, &type);
+    if (id < 0)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SCHEMA);
+      return;
+    }
+    bej_json_value(enc, text, (uint16_t)id, (uint16_t)id, type, dict);
+
+    *text = json_scan_spaces(*text);
+    if (**text == '}')
+    {
+      (*text)++;
+      return;
+    }
+    if (**text != ',')
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+      return;
+    }
+    (*text)++;
+    *text = json_scan_spaces(*text);
+  }
+}
+
+/**
+ * @brief Encodes the elements of a JSON array
+ *
+ * @param enc Encoder
+ * @param text Text after the opening bracket, left after the closing bracket
+ * @param tag Tag of the array
+ * @param elements Children of the array's entry, the first one describes
+ *                 every element
+ */
+static void bej_json_elements(BejEncoder *enc, const char **text, uint16_t tag,
+                              BejDictionary *elements)
+{
+  if (!elements->name)
+  {
+    bej_encoder_fail(enc, BEJ_ERR_SCHEMA);
+    return;
+  }
+
+  size_t mark = bej_encode_begin_array(enc, tag);
+  uint32_t count = 0;
+  *text = json_scan_spaces(*text);
+  if (**text == ']')
+    (*text)++;
+  else
+  {
+    while (enc->error == BEJ_OK)
+    {
+      if (count == UINT16_MAX)
+      {
+        bej_encoder_fail(enc, BEJ_ERR_LENGTH);
+        return;
+      }
+      bej_json_value(enc, text, (uint16_t)count++, elements->id, elements->type, elements);
+
+      *text = json_scan_spaces(*text);
+      if (**text == ']')
+      {
+        (*text)++;
+        break;
+      }
+      if (**text != ',')
+      {
+        bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+        return;
+      }
+      (*text)++;
+      *text = json_scan_spaces(*text);
+    }
+  }
+  bej_encode_end_array(enc, mark, (uint16_t)count);
+}
+
+/**
+ * @brief Returns 1 and steps over a literal if the text starts with it
+ */
+static int bej_json_literal(const char **text, const char *literal, size_t length)
+{
+  if (strncmp(*text, literal, length) != 0)
+    return 0;
+  *text += length;
+  return 1;
+}
+
+/**
+ * @brief Encodes one JSON value with the type its dictionary entry demands
+ *
+ * null is accepted for every type. Enum options are written as their ID
+ * in the children of the entry.
+ *
+ * @param enc Encoder
+ * @param text Text at the value, left after it
+ * @param tag Tag to write, the index for array elements
+ * @param id ID of the value's entry
+ * @param type Type of the value in the dictionary
+ * @param dict Dictionary holding the value's entry
+ */
+static void bej_json_value(BejEncoder *enc, const char **text, uint16_t tag, uint16_t id,
+                           BejType type, BejDictionary *dict)
+{
+  char c = **text;
+  int number = c == '-' || (c >= '0' && c <= '9');
+  if (c == 'n' && bej_json_literal(text, "null", 4))
+    bej_encode_null(enc, tag);
+  else if (type == BEJ_SET && c == '{')
+  {
+    (*text)++;
+    size_t mark = bej_encode_begin_set(enc, tag);
+    bej_json_members(enc, text, bej_dictionary_child(dict, id));
+    bej_encode_end_set(enc, mark);
+  }
+  else if (type == BEJ_ARRAY && c == '[')
+  {
+    (*text)++;
+    bej_json_elements(enc, text, tag, bej_dictionary_child(dict, id));
+  }
+  else if (type == BEJ_STRING && c == '"')
+  {
+    (*text)++;
+    size_t mark = bej_encode_open(enc, tag, BEJ_STRING);
+    bej_json_unescape(enc, text);
+    bej_encode_close(enc, mark);
+  }
+  else if (type == BEJ_ENUM && c == '"')
+  {
+    /* Option names need no escapes, the raw bytes are looked up */
+    int escaped;
+    const char *name = *text + 1;
+    const char *close = json_scan_string(name, &escaped);
+    if (!close)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+      return;
+    }
+    int32_t option = bej_find_id_in_dictionary(bej_dictionary_child(dict, id), name,
+                                               (size_t)(close - name), NULL);
+    if (option < 0)
+    {
+      bej_encoder_fail(enc, BEJ_ERR_SCHEMA);
+      return;
+    }
+    bej_encode_enum(enc, tag, (uint16_t)option);
+    *text = close + 1;
+  }
+  else if (type == BEJ_INTEGER && number)
+  {
+    int64_t value;
+    if (bej_json_integer(enc, text, &value))
+      bej_encode_integer(enc, tag, value);
+  }
+  else if (type == BEJ_REAL && number)
+  {
+    double value;
+    if (bej_json_real(enc, text, &value))
+      bej_encode_real(enc, tag, value);
+  }
+  else if (type == BEJ_BOOLEAN && (c == 't' || c == 'f'))
+  {
+    if (bej_json_literal(text, "true", 4))
+      bej_encode_boolean(enc, tag, 1);
+    else if (bej_json_literal(text, "false", 5))
+      bej_encode_boolean(enc, tag, 0);
+    else
+      bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+  }
+  else if (c == '{' || c == '[' || c == '"' || c == 't' || c == 'f' || number)
+    bej_encoder_fail(enc, BEJ_ERR_TYPE);
+  else
+    bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+}
+
+/**
+ * @brief Encodes JSON text without building a tree
+ *
+ * Keys are looked up as they are read and values are written straight
+ * into the output, including unescaped strings.
+ *
+ * @param enc Encoder, output is appended
+ * @param text Null-terminated JSON object
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @return BEJ_OK, BEJ_ERR_SYNTAX for malformed text, otherwise as
+ *         bej_encode_tree()
+ */
+BejError bej_encode_json(BejEncoder *enc, const char *text, BejDictionary *dict)
+{
+  text = json_scan_spaces(text);
+  bej_json_value(enc, &text, 0, 0, BEJ_SET, dict);
+
+  text = json_scan_spaces(text);
+  if (enc->error == BEJ_OK && *text != '\0')
+    bej_encoder_fail(enc, BEJ_ERR_SYNTAX);
+  return enc->error;
+}
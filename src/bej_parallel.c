@@ -0,0 +1,315 @@
+/**
+ * @file bej_parallel.c
+ * @brief Parallel decoding of one large BEJ value
+ *
+ * The members of the root SET are located by a skip scan that reads only
+ * their tags and length prefixes. Each member is then an independent
+ * task on the work-stealing pool: decoded into its own subtree, or
+ * transcoded into the JSON buffer of the worker that ran it. The results
+ * are stitched together in member order, so the tree and the text are
+ * the same as from the sequential decoders.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_parallel.h"
+#include "../include/bej_pool.h"
+#include "../include/bej_transcode.h"
+
+/*one member of the root SET and the result of its task*/
+typedef struct BejSplitMember
+{
+  const uint8_t *start; /*tag of the member*/
+  const uint8_t *end;   /*one past its payload*/
+  uint16_t id;
+  int32_t node;         /*projection node of the member*/
+  BejSet *value;
+  BejError error;
+  size_t error_offset;
+  BejDecodeStats stats;
+  uint32_t worker;      /*writer holding the JSON of the member*/
+  size_t out_start;
+  size_t out_length;
+} BejSplitMember;
+
+/*root SET cut into members*/
+typedef struct BejSplit
+{
+  const BejDecoder *ctx;
+  BejDictionary *members_dict;
+  BejSplitMember *members;
+  uint32_t count;
+  const uint8_t *end;   /*end of the root SET*/
+  JsonWriter *writers;  /*per worker, transcoding only*/
+  int depth;            /*writer depth of the members*/
+} BejSplit;
+
+/**
+ * @brief Finds the byte ranges of the root SET members
+ *
+ * Only tags and lengths are read, payloads are skipped, and so are
+ * members left out by the decoder's projection. Values that are not
+ * SETs, small SETs and malformed input are left to the sequential
+ * decoders, which then report the same errors they always do.
+ *
+ * @param ctx Decoder context at the root value ID, moved to the first
+ *            member on success and left in place otherwise
+ * @param dict Dictionary holding the root entry
+ * @param split Split to fill
+ * @return 1 if the members can be decoded in parallel, 0 otherwise
+ */
+static int bej_split_scan(BejDecoder *ctx, BejDictionary *dict, BejSplit *split)
+{
+  BejDecoder scan = *ctx;
+  uint16_t id;
+  uint8_t type;
+  uint32_t length;
+  memset(split, 0, sizeof(*split));
+
+  if (ctx->arena || ctx->depth == BEJ_DECODE_DEPTH || !bej_read_tag(&scan, &id, &type) ||
+      type != BEJ_SET || !bej_read_length(&scan, &length))
+    return 0;
+
+  const uint8_t *first = scan.cursor;
+  scan.end = scan.cursor + length;
+  uint32_t cap = 0;
+  while (scan.cursor < scan.end && split->count <= UINT16_MAX)
+  {
+    if (split->count == cap)
+    {
+      cap = cap ? cap * 2 : 64;
+      BejSplitMember *members = realloc(split->members, sizeof(BejSplitMember) * cap);
+      if (!members)
+        break;
+      split->members = members;
+    }
+
+    BejSplitMember *member = &split->members[split->count];
+    uint16_t member_id;
+    uint8_t member_type;
+    uint32_t skip;
+    member->start = scan.cursor;
+    if (!bej_read_tag(&scan, &member_id, &member_type) || !bej_read_length(&scan, &skip))
+      break;
+    scan.cursor += skip;
+    member->end = scan.cursor;
+    member->id = member_id;
+    member->node = bej_projection_member(&scan, member_id);
+    split->count += member->node != BEJ_PROJECTION_SKIP;
+  }
+
+  if (scan.cursor != scan.end || scan.error != BEJ_OK || split->count > UINT16_MAX ||
+      split->count < BEJ_PARALLEL_MIN_MEMBERS)
+  {
+    free(split->members);
+    split->members = NULL;
+    return 0;
+  }
+
+  split->ctx = ctx;
+  split->members_dict = bej_dictionary_child(dict, id);
+  split->end = scan.end;
+  ctx->cursor = first;
+  ctx->stats.values++;
+  return 1;
+}
+
+/**
+ * @brief Prepares a decoder for one member
+ */
+static void bej_split_decoder(const BejSplit *split, const BejSplitMember *member, BejDecoder *sub)
+{
+  bej_decoder_init(sub, split->ctx->start, (size_t)(member->end - split->ctx->start));
+  sub->cursor = member->start;
+  sub->flags = split->ctx->flags;
+  sub->projection = split->ctx->projection;
+  sub->projection_node = member->node;
+  sub->depth = split->ctx->depth + 1; /*inside the root SET*/
+}
+
+/**
+ * @brief Decodes one member, a pool task
+ */
+static void bej_split_decode(void *user, uint32_t worker, size_t task)
+{
+  BejSplit *split = user;
+  BejSplitMember *member = &split->members[task];
+  (void)worker;
+
+  BejDecoder sub;
+  bej_split_decoder(split, member, &sub);
+  member->value = bej_read_value(&sub, split->members_dict);
+  member->error = sub.error;
+  member->error_offset = sub.error_offset;
+  member->stats = sub.stats;
+}
+
+/**
+ * @brief Transcodes one member into the worker's buffer, a pool task
+ */
+static void bej_split_transcode(void *user, uint32_t worker, size_t task)
+{
+  BejSplit *split = user;
+  BejSplitMember *member = &split->members[task];
+  JsonWriter *w = &split->writers[worker];
+
+  /* Separator, indentation and key as if written after the previous member */
+  w->depth = split->depth;
+  w->need_comma = task > 0;
+  member->worker = worker;
+  member->out_start = w->len;
+
+  const char *name = bej_find_in_dictionary(split->members_dict, member->id, NULL);
+  if (!name) name = "UNKNOWN";
+  json_writer_key(w, name, strlen(name));
+
+  BejDecoder sub;
+  bej_split_decoder(split, member, &sub);
+  member->error = bej_transcode_writer(&sub, split->members_dict, w);
+  if (member->error == BEJ_OK && w->error)
+    member->error = BEJ_ERR_NOMEM;
+  member->error_offset = sub.error_offset;
+  member->stats = sub.stats;
+  member->out_length = w->len - member->out_start;
+}
+
+/**
+ * @brief Adds the statistics of the members to the root decoder
+ *
+ * @param ctx Root decoder context
+ * @param split Decoded split
+ * @return Index of the first member that failed, split->count if none did
+ */
+static uint32_t bej_split_collect(BejDecoder *ctx, const BejSplit *split)
+{
+  uint32_t failed = split->count;
+  for (uint32_t i = 0; i < split->count; i++)
+  {
+    const BejSplitMember *member = &split->members[i];
+    ctx->stats.values += member->stats.values;
+    ctx->stats.allocations += member->stats.allocations;
+    ctx->stats.bytes_allocated += member->stats.bytes_allocated;
+    if (member->error != BEJ_OK && failed == split->count)
+    {
+      failed = i;
+      ctx->error = member->error;
+      ctx->error_offset = member->error_offset;
+    }
+  }
+  return failed;
+}
+
+/**
+ * @brief Decodes one BEJ value, the root SET members on several threads
+ *
+ * Gives the same tree as bej_read_value(). Values other than SETs, SETs
+ * with fewer than BEJ_PARALLEL_MIN_MEMBERS members and decoders with an
+ * arena (which is not thread-safe) are decoded on the calling thread.
+ *
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @param threads Number of threads including the caller, 0 for one per
+ *                processor
+ * @return Pointer to BejSet structure, or NULL on error (see ctx->error)
+ * @note Free the tree with bej_free()
+ */
+BejSet *bej_read_value_parallel(BejDecoder *ctx, BejDictionary *dict, uint32_t threads)
+{
+  BejSplit split;
+  if (threads == 1 || !bej_split_scan(ctx, dict, &split))
+    return bej_read_value(ctx, dict);
+
+  BejSet *obj = malloc(sizeof(BejSet));
+  JsonPair *pairs = malloc(sizeof(JsonPair) * split.count);
+  if (!obj || !pairs || bej_pool_run(threads, split.count, bej_split_decode, &split, NULL) != 0)
+  {
+    free(obj);
+    free(pairs);
+    free(split.members);
+    bej_decoder_fail(ctx, BEJ_ERR_NOMEM);
+    return NULL;
+  }
+  ctx->stats.allocations += 2;
+  ctx->stats.bytes_allocated += sizeof(BejSet) + sizeof(JsonPair) * split.count;
+
+  obj->type = BEJ_SET;
+  obj->object_value.count = (uint16_t)split.count;
+  obj->object_value.pairs = pairs;
+  for (uint32_t i = 0; i < split.count; i++)
+  {
+    pairs[i].id = split.members[i].id;
+    pairs[i].value = split.members[i].value;
+  }
+
+  if (bej_split_collect(ctx, &split) != split.count)
+  {
+    /* Members that failed are NULL, bej_free() skips them */
+    bej_free(obj);
+    obj = NULL;
+  }
+  else
+  {
+    ctx->cursor = split.end;
+  }
+  free(split.members);
+  return obj;
+}
+
+/**
+ * @brief Converts one BEJ value to JSON, the root SET members on several threads
+ *
+ * Every worker transcodes its members into a buffer of its own, then the
+ * pieces are appended to @p w in member order. The text is the same as
+ * from bej_transcode_writer(), and falls back to it in the cases listed
+ * for bej_read_value_parallel().
+ *
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param dict Dictionary holding the root entry
+ * @param w Writer receiving the JSON text, its style selects the layout
+ * @param threads Number of threads including the caller, 0 for one per
+ *                processor
+ * @return BEJ_OK on success, otherwise the error stored in ctx->error
+ * @note On error the output ends where decoding stopped
+ */
+BejError bej_transcode_parallel(BejDecoder *ctx, BejDictionary *dict, JsonWriter *w, uint32_t threads)
+{
+  BejSplit split;
+  if (threads == 1 || !bej_split_scan(ctx, dict, &split))
+    return bej_transcode_writer(ctx, dict, w);
+
+  uint32_t workers = threads ? threads : bej_pool_cpu_count();
+  if (workers > BEJ_POOL_MAX_WORKERS)
+    workers = BEJ_POOL_MAX_WORKERS;
+
+  split.writers = calloc(workers, sizeof(JsonWriter));
+  int failed = !split.writers;
+  for (uint32_t i = 0; i < workers && !failed; i++)
+    failed = json_writer_init_buffer(&split.writers[i], w->pretty ? JSON_PRETTY : JSON_COMPACT) != 0;
+
+  split.depth = w->depth + 1;
+  if (failed || bej_pool_run(workers, split.count, bej_split_transcode, &split, NULL) != 0)
+    bej_decoder_fail(ctx, BEJ_ERR_NOMEM);
+  else
+  {
+    uint32_t stop = bej_split_collect(ctx, &split);
+    json_writer_begin_object(w);
+    for (uint32_t i = 0; i < split.count && i <= stop; i++)
+    {
+      const BejSplitMember *member = &split.members[i];
+      json_writer_raw(w, split.writers[member->worker].buf + member->out_start, member->out_length);
+    }
+    if (stop == split.count)
+    {
+      w->need_comma = 1;
+      json_writer_end_object(w);
+      ctx->cursor = split.end;
+    }
+  }
+
+  for (uint32_t i = 0; split.writers && i < workers; i++)
+    json_writer_free(&split.writers[i]);
+  free(split.writers);
+  free(split.members);
+  return ctx->error;
+}
@@ -6,26 +6,33 @@
  * it to JSON format. BEJ is a binary encoding format for JSON-like data.
  */
 
+#ifndef _WIN32
+#define _DEFAULT_SOURCE /* madvise */
+#define BEJ_HAVE_MMAP 1
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#ifdef BEJ_HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "../include/bej_parse.h"
-
-/**
- * @brief Stores the length of the last read field in SET parsing
- * @note This is used to track position while parsing nested SET structures
- */
-static uint8_t last_read_field_length = 0; 
+#include "../include/bej_project.h"
 
 /**
  * @brief Loads binary file into memory
  * 
  * @param file_name Path to the file to load
+ * @param size Optional pointer to store the number of bytes loaded (can be NULL)
  * @return Pointer to allocated buffer containing file data, or NULL on error
  * @note Caller is responsible for freeing the returned buffer
  */
-uint8_t *bej_load_file(const char *file_name)
+uint8_t *bej_load_file(const char *file_name, size_t *size)
 {
   FILE *f = fopen(file_name, "rb");
   if (!f)
@@ -34,18 +41,23 @@ uint8_t *bej_load_file(const char *file_name)
   }
   
   fseek(f, 0, SEEK_END);
-  uint32_t size = ftell(f);
-  if(!size) printf("size = NULL\n");
+  long file_size = ftell(f);
+  if (file_size < 0)
+  {
+    fclose(f);
+    return NULL;
+  }
   rewind(f);
   
-  uint8_t *data = malloc(size);
+  /* One spare byte so an empty file still gets a valid buffer */
+  uint8_t *data = malloc((size_t)file_size + 1);
   if (!data)
   {
     fclose(f);
     return NULL;
   }
   
-  if (fread(data, 1, size, f) != size)
+  if (fread(data, 1, (size_t)file_size, f) != (size_t)file_size)
   {
     free(data);
     fclose(f);
@@ -53,27 +65,594 @@ uint8_t *bej_load_file(const char *file_name)
   }
   
   fclose(f);
+  if (size) *size = (size_t)file_size;
   return data;
 }
 
+/**
+ * @brief Maps a binary file read-only into memory
+ * 
+ * The file is mapped instead of copied, so decoding large captures of
+ * concatenated BEJ messages does not double the resident memory. The kernel
+ * is told the mapping will be read sequentially. Platforms without mmap
+ * fall back to bej_load_file().
+ * 
+ * @param file_name Path to the file to map
+ * @param map Mapping to fill, map->data and map->size feed bej_decoder_init()
+ * @return BEJ_OK on success, BEJ_ERR_IO or BEJ_ERR_NOMEM on error
+ * @note Release the mapping with bej_unmap_file()
+ */
+BejError bej_map_file(const char *file_name, BejMapping *map)
+{
+  map->data = NULL;
+  map->size = 0;
+  map->mapped = 0;
+
+#ifdef BEJ_HAVE_MMAP
+  int fd = open(file_name, O_RDONLY);
+  if (fd < 0)
+    return BEJ_ERR_IO;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 0)
+  {
+    close(fd);
+    return BEJ_ERR_IO;
+  }
+
+  if (st.st_size > 0)
+  {
+    void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+      close(fd);
+      return BEJ_ERR_IO;
+    }
+    madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    map->data = addr;
+    map->size = (size_t)st.st_size;
+    map->mapped = 1;
+  }
+
+  /* The mapping stays valid after the descriptor is closed */
+  close(fd);
+  return BEJ_OK;
+#else
+  FILE *f = fopen(file_name, "rb");
+  if (!f)
+    return BEJ_ERR_IO;
+  fclose(f);
+
+  map->data = bej_load_file(file_name, &map->size);
+  return map->data ? BEJ_OK : BEJ_ERR_NOMEM;
+#endif
+}
+
+/**
+ * @brief Releases a mapping made by bej_map_file()
+ * 
+ * Safe to call on a mapping of an empty file.
+ * 
+ * @param map Mapping to release
+ */
+void bej_unmap_file(BejMapping *map)
+{
+#ifdef BEJ_HAVE_MMAP
+  if (map->mapped)
+    munmap((void *)map->data, map->size);
+#else
+  free((void *)map->data);
+#endif
+  map->data = NULL;
+  map->size = 0;
+  map->mapped = 0;
+}
+
+/**
+ * @brief Prepares a decoder context for a buffer
+ * 
+ * The context holds all state of one decode: the cursor, the end of the
+ * buffer, the first error, the allocator and statistics. Each thread
+ * decodes with its own context, so several buffers can be decoded at once.
+ * 
+ * @param ctx Context to initialize
+ * @param data Buffer holding BEJ data
+ * @param size Number of bytes in the buffer
+ * @note Set ctx->arena and ctx->flags after this call to change how
+ *       the decoded tree is allocated
+ */
+void bej_decoder_init(BejDecoder *ctx, const uint8_t *data, size_t size)
+{
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->start = data;
+  ctx->cursor = data;
+  ctx->end = data + size;
+  ctx->limit = ctx->end;
+}
+
+/**
+ * @brief Records a decode error
+ * 
+ * Only the first error is kept, together with the offset it happened at.
+ * Decoders built on top of the context use it to stop a decode as well.
+ * 
+ * @param ctx Decoder context
+ * @param error Error code to record
+ */
+void bej_decoder_fail(BejDecoder *ctx, BejError error)
+{
+  if (ctx->error != BEJ_OK)
+    return;
+
+  ctx->error = error;
+  ctx->error_offset = (size_t)(ctx->cursor - ctx->start);
+}
+
+/**
+ * @brief Opens a SET or ARRAY
+ * 
+ * Recursive walkers call this before reading the members of a SET or the
+ * elements of an ARRAY, so hostile nesting fails instead of running out
+ * of stack.
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return 1 on success, 0 with BEJ_ERR_LENGTH if BEJ_DECODE_DEPTH SETs
+ *         and ARRAYs are already open
+ */
+int bej_decoder_enter(BejDecoder *ctx)
+{
+  if (ctx->depth == BEJ_DECODE_DEPTH)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    return 0;
+  }
+  ctx->depth++;
+  return 1;
+}
+
+/**
+ * @brief Closes the SET or ARRAY opened by bej_decoder_enter()
+ * 
+ * @param ctx Decoder context
+ */
+void bej_decoder_leave(BejDecoder *ctx)
+{
+  ctx->depth--;
+}
+
+/**
+ * @brief Describes an error code
+ * 
+ * @param error Error code
+ * @return Static text for messages, "unknown error" for codes outside BejError
+ */
+const char *bej_error_string(BejError error)
+{
+  switch (error)
+  {
+    case BEJ_OK: return "ok";
+    case BEJ_ERR_TRUNCATED: return "truncated";
+    case BEJ_ERR_TYPE: return "unsupported type";
+    case BEJ_ERR_LENGTH: return "bad length";
+    case BEJ_ERR_NOMEM: return "out of memory";
+    case BEJ_ERR_IO: return "cannot read or write file";
+    case BEJ_ERR_ABORTED: return "aborted";
+    case BEJ_ERR_SCHEMA: return "not in the dictionary";
+    case BEJ_ERR_SYNTAX: return "malformed JSON";
+    case BEJ_ERR_NOT_FOUND: return "not found";
+  }
+  return "unknown error";
+}
+
+/**
+ * @brief Checks that the context has a number of unread bytes
+ * 
+ * Input that passed bej_validate() has every byte it needs, with
+ * BEJ_DECODE_TRUSTED the check is left out.
+ * 
+ * @param ctx Decoder context
+ * @param count Number of bytes that will be read
+ * @return 1 if the bytes are available, 0 after recording BEJ_ERR_TRUNCATED
+ */
+static int bej_need(BejDecoder *ctx, size_t count)
+{
+  if ((ctx->flags & BEJ_DECODE_TRUSTED) || (size_t)(ctx->end - ctx->cursor) >= count)
+    return 1;
+
+  bej_decoder_fail(ctx, BEJ_ERR_TRUNCATED);
+  return 0;
+}
+
+/**
+ * @brief Reads a non-negative integer (nnint)
+ * 
+ * IDs, lengths, ARRAY counts and ENUM options are DSP0218 nnints: one byte
+ * giving the number of bytes that follow, then the value in that many
+ * little-endian bytes.
+ * 
+ * @param ctx Decoder context
+ * @param max Largest accepted value
+ * @param value Pointer to store the value
+ * @return 1 on success, 0 on error (BEJ_ERR_TRUNCATED, or BEJ_ERR_LENGTH
+ *         for more than 4 value bytes or a value above @p max)
+ */
+static int bej_read_nnint(BejDecoder *ctx, uint32_t max, uint32_t *value)
+{
+  if (!bej_need(ctx, 1))
+    return 0;
+
+  uint8_t size = *ctx->cursor;
+  if (size > sizeof(uint32_t))
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    return 0;
+  }
+  if (!bej_need(ctx, 1 + (size_t)size))
+    return 0;
+
+  uint32_t result = 0;
+  for (uint8_t i = 0; i < size; i++)
+    result |= (uint32_t)ctx->cursor[1 + i] << (8 * i);
+  ctx->cursor += 1 + size;
+
+  if (result > max)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    return 0;
+  }
+  *value = result;
+  return 1;
+}
+
+/**
+ * @brief Reads the ID and type that start every BEJ value
+ * 
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param id Pointer to store the value ID
+ * @param type Pointer to store the BEJ type byte
+ * @return 1 on success, 0 on error (cursor at the length on success)
+ */
+int bej_read_tag(BejDecoder *ctx, uint16_t *id, uint8_t *type)
+{
+  /* One-byte IDs are the common case */
+  if (ctx->end - ctx->cursor >= 3 && ctx->cursor[0] == 1)
+  {
+    *id = ctx->cursor[1];
+    *type = ctx->cursor[2];
+    ctx->cursor += 3;
+    return 1;
+  }
+
+  uint32_t value;
+  if (!bej_read_nnint(ctx, UINT16_MAX, &value) || !bej_need(ctx, 1))
+    return 0;
+
+  *id = (uint16_t)value;
+  *type = *ctx->cursor++;
+  return 1;
+}
+
+/**
+ * @brief Reads the length that follows a value tag
+ * 
+ * Checks that the whole payload is inside the readable range, so callers
+ * can consume @p length bytes without further checks.
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param length Pointer to store the payload length in bytes
+ * @return 1 on success, 0 on error (cursor at the payload on success)
+ */
+int bej_read_length(BejDecoder *ctx, uint32_t *length)
+{
+  uint32_t len;
+  if (!bej_read_nnint(ctx, UINT32_MAX, &len))
+    return 0;
+
+  if (!bej_need(ctx, len))
+    return 0;
+
+  *length = len;
+  return 1;
+}
+
+/**
+ * @brief Skips a whole value, including nested SET members
+ * 
+ * Every value is a tag, a length and a payload, so a SET is skipped
+ * by its length without looking at its members.
+ * 
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @return 1 on success, 0 on error
+ */
+int bej_skip_value(BejDecoder *ctx)
+{
+  uint16_t id;
+  uint8_t type;
+  uint32_t length;
+  if (!bej_read_tag(ctx, &id, &type) || !bej_read_length(ctx, &length))
+    return 0;
+
+  ctx->cursor += length;
+  return 1;
+}
+
+/**
+ * @brief Looks a SET member up in the decoder's projection
+ * 
+ * @param ctx Decoder context inside the SET
+ * @param id ID of the member
+ * @return Projection node of the member, BEJ_PROJECTION_ALL if it is
+ *         selected whole (or there is no projection), BEJ_PROJECTION_SKIP
+ *         if it is not selected
+ */
+int32_t bej_projection_member(const BejDecoder *ctx, uint16_t id)
+{
+  if (!ctx->projection || ctx->projection_node < 0)
+    return BEJ_PROJECTION_ALL;
+
+  const BejProjectionNode *nodes = ctx->projection->nodes;
+  if (nodes[ctx->projection_node].all)
+    return BEJ_PROJECTION_ALL;
+
+  for (int32_t child = nodes[ctx->projection_node].child; child >= 0; child = nodes[child].next)
+  {
+    if (nodes[child].id == id)
+      return nodes[child].all ? BEJ_PROJECTION_ALL : child;
+  }
+  return BEJ_PROJECTION_SKIP;
+}
+
+/**
+ * @brief Allocates decoder memory from the context arena or the heap
+ * 
+ * @param ctx Decoder context, ctx->arena NULL selects malloc()
+ * @param size Number of bytes to allocate
+ * @return Pointer to allocated memory, or NULL after recording BEJ_ERR_NOMEM
+ */
+static void *bej_alloc(BejDecoder *ctx, size_t size)
+{
+  void *ptr = ctx->arena ? bej_arena_alloc(ctx->arena, size) : malloc(size);
+  if (!ptr)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_NOMEM);
+    return NULL;
+  }
+
+  ctx->stats.allocations++;
+  ctx->stats.bytes_allocated += size;
+  return ptr;
+}
+
+/**
+ * @brief Loads 8 bytes as a little-endian integer
+ * 
+ * @param bytes First byte, need not be aligned
+ * @return Loaded value
+ */
+static uint64_t bej_load_le64(const uint8_t *bytes)
+{
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+/**
+ * @brief Assembles an integer payload byte by byte
+ * 
+ * Used near the end of the buffer, where an 8-byte load would overrun it,
+ * and for empty or wider than 8-byte payloads. Bytes beyond the eighth
+ * may only repeat the sign.
+ * 
+ * @param ctx Decoder context, the cursor must be at the payload
+ * @param length Payload length checked by bej_read_length()
+ * @return Decoded integer value, 0 on error
+ */
+static int64_t bej_read_integer_bytes(BejDecoder *ctx, uint32_t length)
+{
+  const uint8_t *bytes = ctx->cursor;
+  uint32_t n = length < 8 ? length : 8;
+  uint64_t res = 0;
+  for (uint32_t i = 0; i < n; i++)
+    res |= (uint64_t)bytes[i] << (8 * i);
+  if (n > 0 && n < 8 && (bytes[n - 1] & 0x80))
+    res |= UINT64_MAX << (8 * n);
+
+  uint8_t sign = (res >> 63) ? 0xFF : 0x00;
+  for (uint32_t i = 8; i < length; i++)
+  {
+    if (bytes[i] != sign)
+    {
+      bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+      return 0;
+    }
+  }
+  ctx->cursor += length;
+  return (int64_t)res;
+}
+
 /**
  * @brief Reads an integer value from BEJ data stream
  * 
- * Reads a variable-length integer encoded in little-endian format.
- * Updates the data pointer and last_read_field_length.
+ * Reads a length followed by a little-endian two's complement integer of
+ * that many bytes, sign-extended to 64 bits so the encoder can store every
+ * value in its minimal size. Payloads of 1 to 8 bytes are read with one
+ * unaligned 8-byte load whenever the buffer has 8 bytes left: shifting the
+ * payload to the top and back drops the bytes that follow it and extends
+ * the sign without a branch.
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return Decoded integer value, 0 on error (BEJ_ERR_LENGTH for a value
+ *         that does not fit in 64 bits)
+ */
+int64_t bej_read_integer(BejDecoder *ctx)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+
+  const uint8_t *bytes = ctx->cursor;
+  if (length - 1 < 8 && ctx->limit - bytes >= 8)
+  {
+    unsigned shift = 64 - 8 * length;
+    ctx->cursor += length;
+    /* Right shift of a negative value is arithmetic on every supported compiler */
+    return (int64_t)(bej_load_le64(bytes) << shift) >> shift;
+  }
+  return bej_read_integer_bytes(ctx, length);
+}
+
+/**
+ * @brief Reads a REAL value from BEJ data stream
+ * 
+ * The payload is an IEEE 754 binary64 number, little-endian.
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return Decoded value, 0 on error (BEJ_ERR_LENGTH if the payload is not
+ *         8 bytes)
+ */
+double bej_read_real(BejDecoder *ctx)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+  if (length != sizeof(double))
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    return 0;
+  }
+
+  uint64_t bits = bej_load_le64(ctx->cursor);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  ctx->cursor += length;
+  return value;
+}
+
+/**
+ * @brief Reads a BOOLEAN value from BEJ data stream
  * 
- * @param data Pointer to the data pointer (will be advanced)
- * @return Decoded integer value
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return 1 for true, 0 for false or on error (BEJ_ERR_LENGTH if the
+ *         payload is not 1 byte)
  */
-uint32_t bej_read_integer(const uint8_t **data)
+int bej_read_boolean(BejDecoder *ctx)
 {
-  uint8_t length = *(++(*data));
-  last_read_field_length = length;
-  uint32_t res = 0;
-  for (size_t i = 0; i < length; i++)
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+  if (length != 1)
   {
-    res |= ((uint32_t)*(++(*data))) << (8 * i);
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    return 0;
   }
+  return *ctx->cursor++ != 0;
+}
+
+/**
+ * @brief Reads an ENUM value from BEJ data stream
+ * 
+ * The payload is the nnint ID of the option, whose name is found in the
+ * children of the enum's dictionary entry.
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return Option ID, 0 on error (BEJ_ERR_LENGTH if the nnint does not
+ *         fill the payload)
+ */
+uint16_t bej_read_enum(BejDecoder *ctx)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+  uint32_t option = 0;
+  if (bej_read_nnint(ctx, UINT16_MAX, &option) && ctx->cursor != ctx->end)
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+  ctx->end = outer_end;
+  return ctx->error == BEJ_OK ? (uint16_t)option : 0;
+}
+
+/**
+ * @brief Reads a NULL value from BEJ data stream
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return 1 on success, 0 on error (BEJ_ERR_LENGTH for a payload)
+ */
+int bej_read_null(BejDecoder *ctx)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+  if (length != 0)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Reads the length and element count of an ARRAY
+ * 
+ * The payload is the nnint element count followed by the elements, each
+ * tagged with its index and decoded with the single child entry of the
+ * array's dictionary entry.
+ * 
+ * @param ctx Decoder context, the cursor must be at the length, left at
+ *            the first element
+ * @param length Pointer to store the number of bytes taken by the elements
+ * @param count Pointer to store the number of elements
+ * @return 1 on success, 0 on error (BEJ_ERR_LENGTH for more than
+ *         UINT16_MAX elements, BEJ_ERR_TRUNCATED for more elements than
+ *         the payload can hold)
+ */
+int bej_read_array_header(BejDecoder *ctx, uint32_t *length, uint16_t *count)
+{
+  uint32_t total;
+  if (!bej_read_length(ctx, &total))
+    return 0;
+
+  const uint8_t *payload = ctx->cursor;
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + total;
+  uint32_t elements;
+  int ok = bej_read_nnint(ctx, UINT16_MAX, &elements);
+  ctx->end = outer_end;
+  if (!ok)
+    return 0;
+
+  /* Every element takes at least a tag and a length */
+  *length = total - (uint32_t)(ctx->cursor - payload);
+  if ((uint64_t)elements * 3 > *length)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_TRUNCATED);
+    return 0;
+  }
+  *count = (uint16_t)elements;
+  return 1;
+}
+
+/**
+ * @brief Copies a string payload into a null-terminated string
+ * 
+ * @param ctx Decoder context, the cursor must be at the payload
+ * @param length Payload length checked by bej_read_length()
+ * @return Pointer to null-terminated string, or NULL on error
+ */
+static char *bej_copy_string(BejDecoder *ctx, uint32_t length)
+{
+  char *res = bej_alloc(ctx, (size_t)length + 1);
+  if (!res)
+    return NULL;
+  
+  memcpy(res, ctx->cursor, length);
+  res[length] = '\0';
+  ctx->cursor += length;
   return res;
 }
 
@@ -81,126 +660,489 @@ uint32_t bej_read_integer(const uint8_t **data)
  * @brief Reads a string value from BEJ data stream
  * 
  * Reads a length-prefixed string and null-terminates it.
- * Updates the data pointer and last_read_field_length.
  * 
- * @param data Pointer to the data pointer (will be advanced)
- * @return Pointer to allocated null-terminated string, or NULL on error
- * @note Caller is responsible for freeing the returned string
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return Pointer to null-terminated string, or NULL on error
+ * @note The string comes from ctx->arena, or from malloc() when it is NULL,
+ *       in which case the caller is responsible for freeing it
  */
-char *bej_read_string(const uint8_t **data)
+char *bej_read_string(BejDecoder *ctx)
 {
-  uint8_t length = *(++(*data));
-  last_read_field_length = length;
-  char *res = malloc(length + 1);
-  if (!res)
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
     return NULL;
-  
-  for (int i = 0; i < length; i++)
+
+  return bej_copy_string(ctx, length);
+}
+
+/**
+ * @brief Fills a STRING node according to the decoder flags
+ * 
+ * With BEJ_DECODE_ZERO_COPY the node points at the string bytes inside the
+ * input buffer, otherwise the bytes are copied into a null-terminated string.
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param val Node to fill
+ * @return 1 on success, 0 on error
+ */
+static int bej_read_string_value(BejDecoder *ctx, BejSet *val)
+{
+  val->string_value.data = NULL;
+  val->string_value.borrowed = (ctx->flags & BEJ_DECODE_ZERO_COPY) != 0;
+
+  if (!bej_read_length(ctx, &val->string_value.length))
+    return 0;
+
+  if (val->string_value.borrowed)
   {
-    res[i] = *(++(*data));
+    val->string_value.data = (char *)ctx->cursor;
+    ctx->cursor += val->string_value.length;
   }
-  res[length] = '\0';
-  return res;
+  else
+  {
+    val->string_value.data = bej_copy_string(ctx, val->string_value.length);
+  }
+  return val->string_value.data != NULL;
+}
+
+/**
+ * @brief Releases a partially decoded node
+ * 
+ * @param ctx Decoder context, nothing is freed when it uses an arena
+ * @param val Node to release
+ */
+static void bej_discard(BejDecoder *ctx, BejSet *val)
+{
+  if (!ctx->arena)
+    bej_free(val);
+}
+
+static BejSet *bej_read_tagged(BejDecoder *ctx, uint16_t id, uint8_t type, BejDictionary *dict);
+
+static void bej_emit_value(BejSet *val, BejDictionary *dict, JsonWriter *w);
+
+
+/**
+ * @brief Counts the members of a SET without decoding them
+ * 
+ * Steps over the members by their lengths on a copy of the context, so
+ * malformed members are left for the real pass to report.
+ * 
+ * @param ctx Decoder context, the cursor must be at the first member
+ * @param length Number of bytes taken by the members
+ * @return Number of members up to the first malformed one
+ */
+static uint32_t bej_count_members(const BejDecoder *ctx, uint32_t length)
+{
+  BejDecoder scan = *ctx;
+  scan.end = scan.cursor + length;
+  scan.error = BEJ_OK;
+
+  uint32_t count = 0;
+  while (scan.cursor < scan.end)
+  {
+    uint16_t id;
+    uint8_t type;
+    uint32_t skip;
+    if (!bej_read_tag(&scan, &id, &type) || !bej_read_length(&scan, &skip))
+      break;
+    scan.cursor += skip;
+    count += bej_projection_member(&scan, id) != BEJ_PROJECTION_SKIP;
+  }
+  return count;
 }
 
 /**
  * @brief Reads a BEJ SET (object) from data stream
  * 
  * Parses a BEJ SET structure containing multiple key-value pairs.
- * Recursively parses nested objects using the appropriate dictionary.
+ * The length gives the number of bytes taken by the members, which are
+ * decoded until exactly that many bytes have been consumed. The members
+ * are counted first, so the pair array has exactly their size.
  * 
- * @param data Pointer to the data pointer (will be advanced)
- * @param parent_id ID of the parent element (used for dictionary lookup)
- * @param dict Dictionary for resolving field names
- * @return Pointer to allocated BejSet structure, or NULL on error
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param parent_id ID of the SET (used for dictionary lookup)
+ * @param dict Dictionary the SET itself was found in
+ * @return Pointer to BejSet structure, or NULL on error
  * @note Caller is responsible for freeing the returned structure using bej_free()
+ *       unless it came from ctx->arena
  */
-BejSet *bej_read_object(const uint8_t **data, uint8_t parent_id, BejDictionary *dict)
+BejSet *bej_read_object(BejDecoder *ctx, uint16_t parent_id, BejDictionary *dict)
 {
-  
-  BejSet *obj = malloc(sizeof(BejSet));
+  uint32_t bytes_len;
+  if (!bej_read_length(ctx, &bytes_len))
+    return NULL;
+
+  BejSet *obj = bej_alloc(ctx, sizeof(BejSet));
   if (!obj)
     return NULL;
   
   obj->type = BEJ_SET;
   obj->object_value.count = 0;
-  
-  obj->object_value.pairs = malloc(sizeof(JsonPair) * PAIR_BUFFER);
-  if (!obj->object_value.pairs)
+  obj->object_value.pairs = NULL;
+
+  uint32_t members = bej_count_members(ctx, bytes_len);
+  if (members > UINT16_MAX)
   {
-    free(obj);
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    bej_discard(ctx, obj);
     return NULL;
   }
+  if (members > 0)
+  {
+    obj->object_value.pairs = bej_alloc(ctx, sizeof(JsonPair) * members);
+    if (!obj->object_value.pairs)
+    {
+      bej_discard(ctx, obj);
+      return NULL;
+    }
+  }
   
-  uint8_t bytes_len = *(++(*data));
-  
-  BejDictionary *child_dict = bej_get_child_dictionary(parent_id);
+  BejDictionary *child_dict = bej_dictionary_child(dict, parent_id);
 
-  ++(*data); /* Skip to index */
+  /* Members must not read past the end of the SET */
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + bytes_len;
 
-  /* ID for object_value */
-  uint16_t object_val_id = 1;
-  while(bytes_len > 0)
+  while (ctx->cursor < ctx->end)
   {
-    BejSet *value = bej_read_value(data, child_dict);
-    ++(*data); /* Skip to index */
+    const uint8_t *member = ctx->cursor;
+    uint16_t id;
+    uint8_t type;
+    if (!bej_read_tag(ctx, &id, &type)) break;
+
+    /* Members left out by the projection are stepped over */
+    int32_t node = bej_projection_member(ctx, id);
+    if (node == BEJ_PROJECTION_SKIP)
+    {
+      ctx->cursor = member;
+      if (!bej_skip_value(ctx)) break;
+      continue;
+    }
+
+    /* Only reached past a member the count stopped at, which fails below */
+    if (obj->object_value.count == members)
+    {
+      ctx->cursor = member;
+      bej_skip_value(ctx);
+      break;
+    }
+
+    int32_t outer_node = ctx->projection_node;
+    ctx->projection_node = node;
+    BejSet *value = bej_read_tagged(ctx, id, type, child_dict);
+    ctx->projection_node = outer_node;
     if (value == NULL) break;
     
-    obj->object_value.pairs[obj->object_value.count].id = object_val_id++;
+    obj->object_value.pairs[obj->object_value.count].id = id;
     obj->object_value.pairs[obj->object_value.count].value = value;
     obj->object_value.count++;
-    
+  }
+
+  ctx->end = outer_end;
 
-    bytes_len -= last_read_field_length;
+  if (ctx->error != BEJ_OK)
+  {
+    bej_discard(ctx, obj);
+    return NULL;
   }
   
   return obj;
 }
 
 /**
- * @brief Reads any BEJ value from data stream
+ * @brief Allocates a node for a scalar value
+ * 
+ * @param ctx Decoder context
+ * @param type BEJ type of the node
+ * @return Node, or NULL if out of memory
+ */
+static BejSet *bej_new_node(BejDecoder *ctx, BejType type)
+{
+  BejSet *val = bej_alloc(ctx, sizeof(BejSet));
+  if (val)
+    val->type = type;
+  return val;
+}
+
+/**
+ * @brief Reads a BEJ ARRAY from data stream
  * 
- * Determines the type of the value and calls the appropriate parsing function.
- * Handles INTEGER, STRING, and SET types.
+ * The pair array has exactly the announced number of elements, which
+ * must take the whole payload.
  * 
- * @param data Pointer to the data pointer (will be advanced)
- * @param dict Dictionary for resolving field names in nested SETs
- * @return Pointer to allocated BejSet structure, or NULL on error
- * @note Caller is responsible for freeing the returned structure using bej_free()
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param id ID of the array (used for dictionary lookup)
+ * @param dict Dictionary holding the array's entry
+ * @return Pointer to BejSet structure, or NULL on error
  */
-BejSet *bej_read_value(const uint8_t **data, BejDictionary *dict)
+static BejSet *bej_read_array(BejDecoder *ctx, uint16_t id, BejDictionary *dict)
 {
-  BejSet *val = malloc(sizeof(BejSet));
-  if (!val)
+  uint32_t length;
+  uint16_t count;
+  if (!bej_read_array_header(ctx, &length, &count))
     return NULL;
-  
-  uint8_t id = **data;
-  
-  val->type = *(++(*data));
-  
-  if (val->type == BEJ_INTEGER)
+
+  BejSet *arr = bej_new_node(ctx, BEJ_ARRAY);
+  if (!arr)
+    return NULL;
+  arr->object_value.count = 0;
+  arr->object_value.pairs = NULL;
+  if (count > 0)
   {
-    val->integer_value = bej_read_integer(data);
+    arr->object_value.pairs = bej_alloc(ctx, sizeof(JsonPair) * count);
+    if (!arr->object_value.pairs)
+    {
+      bej_discard(ctx, arr);
+      return NULL;
+    }
   }
-  else if (val->type == BEJ_STRING)
+
+  /* Elements are tagged with their index, the entry describing them comes first */
+  BejDictionary *elements = bej_dictionary_child(dict, id);
+
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+  while (arr->object_value.count < count)
   {
-    val->string_value = bej_read_string(data);
+    uint16_t index;
+    uint8_t type;
+    if (!bej_read_tag(ctx, &index, &type)) break;
+
+    BejSet *value = bej_read_tagged(ctx, elements->id, type, elements);
+    if (value == NULL) break;
+
+    arr->object_value.pairs[arr->object_value.count].id = index;
+    arr->object_value.pairs[arr->object_value.count].value = value;
+    arr->object_value.count++;
   }
-  else if (val->type == BEJ_SET)
+  if (ctx->error == BEJ_OK && ctx->cursor != ctx->end)
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+  ctx->end = outer_end;
+
+  if (ctx->error != BEJ_OK)
   {
-    free(val);
+    bej_discard(ctx, arr);
+    return NULL;
+  }
+  return arr;
+}
+
+/* Scalar nodes, the type handlers below check ctx->error after them */
+
+static BejSet *bej_read_null_node(BejDecoder *ctx, uint16_t id, BejDictionary *dict)
+{
+  (void)id;
+  (void)dict;
+  BejSet *val = bej_new_node(ctx, BEJ_NULL);
+  if (val)
+    bej_read_null(ctx);
+  return val;
+}
+
+static BejSet *bej_read_integer_node(BejDecoder *ctx, uint16_t id, BejDictionary *dict)
+{
+  (void)id;
+  (void)dict;
+  BejSet *val = bej_new_node(ctx, BEJ_INTEGER);
+  if (val)
+    val->integer_value = bej_read_integer(ctx);
+  return val;
+}
+
+static BejSet *bej_read_enum_node(BejDecoder *ctx, uint16_t id, BejDictionary *dict)
+{
+  (void)id;
+  (void)dict;
+  BejSet *val = bej_new_node(ctx, BEJ_ENUM);
+  if (val)
+    val->enum_value = bej_read_enum(ctx);
+  return val;
+}
+
+static BejSet *bej_read_string_node(BejDecoder *ctx, uint16_t id, BejDictionary *dict)
+{
+  (void)id;
+  (void)dict;
+  BejSet *val = bej_new_node(ctx, BEJ_STRING);
+  if (val)
+    bej_read_string_value(ctx, val);
+  return val;
+}
+
+static BejSet *bej_read_real_node(BejDecoder *ctx, uint16_t id, BejDictionary *dict)
+{
+  (void)id;
+  (void)dict;
+  BejSet *val = bej_new_node(ctx, BEJ_REAL);
+  if (val)
+    val->real_value = bej_read_real(ctx);
+  return val;
+}
+
+static BejSet *bej_read_boolean_node(BejDecoder *ctx, uint16_t id, BejDictionary *dict)
+{
+  (void)id;
+  (void)dict;
+  BejSet *val = bej_new_node(ctx, BEJ_BOOLEAN);
+  if (val)
+    val->boolean_value = (uint8_t)bej_read_boolean(ctx);
+  return val;
+}
+
+/* JSON emitters, dict holds the children of the value's entry */
+
+static void bej_emit_set(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  json_writer_begin_object(w);
+  for (size_t i = 0; i < val->object_value.count; i++)
+  {
+    uint16_t id = val->object_value.pairs[i].id;
+    const char *name = bej_find_in_dictionary(dict, id, NULL);
+    
+    if (!name) name = "UNKNOWN";
+    json_writer_key(w, name, strlen(name));
     
-    val = bej_read_object(data, id, dict);
+    BejDictionary *child_dict = bej_dictionary_child(dict, id);
+    bej_emit_value(val->object_value.pairs[i].value, child_dict, w);
   }
-  else
+  json_writer_end_object(w);
+}
+
+static void bej_emit_array(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  BejDictionary *element_dict = bej_dictionary_child(dict, dict->id);
+  json_writer_begin_array(w);
+  for (size_t i = 0; i < val->object_value.count; i++)
   {
-    free(val);
+    json_writer_element(w);
+    bej_emit_value(val->object_value.pairs[i].value, element_dict, w);
+  }
+  json_writer_end_array(w);
+}
+
+static void bej_emit_null(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  (void)val;
+  (void)dict;
+  json_writer_null(w);
+}
+
+static void bej_emit_integer(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  (void)dict;
+  json_writer_integer(w, val->integer_value);
+}
+
+static void bej_emit_enum(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  const char *name = bej_find_in_dictionary(dict, val->enum_value, NULL);
+  if (!name) name = "UNKNOWN";
+  json_writer_string(w, name, strlen(name));
+}
+
+static void bej_emit_string(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  (void)dict;
+  json_writer_string(w, val->string_value.data ? val->string_value.data : "",
+                     val->string_value.data ? val->string_value.length : 0);
+}
+
+static void bej_emit_real(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  (void)dict;
+  json_writer_real(w, val->real_value);
+}
+
+static void bej_emit_boolean(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  (void)dict;
+  json_writer_boolean(w, val->boolean_value);
+}
+
+/*decode and JSON handlers of one BEJ type*/
+typedef struct BejTypeHandler
+{
+  /*cursor at the length, dict holds the value's entry*/
+  BejSet *(*read)(BejDecoder *ctx, uint16_t id, BejDictionary *dict);
+  /*dict holds the children of the value's entry*/
+  void (*emit)(BejSet *val, BejDictionary *dict, JsonWriter *w);
+} BejTypeHandler;
+
+/**
+ * @brief Handlers indexed by BEJ type
+ */
+static const BejTypeHandler bej_type_handlers[] = {
+  [BEJ_SET] = {bej_read_object, bej_emit_set},
+  [BEJ_ARRAY] = {bej_read_array, bej_emit_array},
+  [BEJ_NULL] = {bej_read_null_node, bej_emit_null},
+  [BEJ_INTEGER] = {bej_read_integer_node, bej_emit_integer},
+  [BEJ_ENUM] = {bej_read_enum_node, bej_emit_enum},
+  [BEJ_STRING] = {bej_read_string_node, bej_emit_string},
+  [BEJ_REAL] = {bej_read_real_node, bej_emit_real},
+  [BEJ_BOOLEAN] = {bej_read_boolean_node, bej_emit_boolean},
+};
+
+#define BEJ_TYPE_COUNT (sizeof(bej_type_handlers) / sizeof(bej_type_handlers[0]))
+
+/**
+ * @brief Reads a value whose tag has been read
+ * 
+ * Dispatches on the type through bej_type_handlers. Types without a
+ * handler fail with BEJ_ERR_TYPE, SETs and ARRAYs nested deeper than
+ * BEJ_DECODE_DEPTH with BEJ_ERR_LENGTH, as in bej_validate().
+ * 
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param id ID of the value
+ * @param type BEJ type of the value
+ * @param dict Dictionary holding the value's entry
+ * @return Pointer to BejSet structure, or NULL on error (see ctx->error)
+ */
+static BejSet *bej_read_tagged(BejDecoder *ctx, uint16_t id, uint8_t type, BejDictionary *dict)
+{
+  if (type >= BEJ_TYPE_COUNT)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_TYPE);
+    return NULL;
+  }
+
+  ctx->stats.values++;
+
+  int nested = type == BEJ_SET || type == BEJ_ARRAY;
+  if (nested && !bej_decoder_enter(ctx))
+    return NULL;
+  BejSet *val = bej_type_handlers[type].read(ctx, id, dict);
+  if (nested)
+    bej_decoder_leave(ctx);
+  if (val && ctx->error != BEJ_OK)
+  {
+    bej_discard(ctx, val);
     return NULL;
   }
   
   return val;
 }
 
+/**
+ * @brief Reads any BEJ value from data stream
+ * 
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param dict Dictionary holding the value's entry, main_dictionary or the
+ *             root of a loaded schema for the top-level value
+ * @return Pointer to BejSet structure, or NULL on error (see ctx->error)
+ * @note Caller is responsible for freeing the returned structure using bej_free()
+ *       unless it came from ctx->arena
+ */
+BejSet *bej_read_value(BejDecoder *ctx, BejDictionary *dict)
+{
+  uint16_t id;
+  uint8_t type;
+  if (!bej_read_tag(ctx, &id, &type))
+    return NULL;
+
+  return bej_read_tagged(ctx, id, type, dict);
+}
+
 /**
  * @brief Recursively frees BejSet structure and all its contents
  * 
@@ -208,6 +1150,8 @@ BejSet *bej_read_value(const uint8_t **data, BejDictionary *dict)
  * Safe to call with NULL pointer.
  * 
  * @param val Pointer to BejSet structure to free
+ * @note Trees decoded with an arena are released with bej_arena_reset()
+ *       instead
  */
 void bej_free(BejSet *val)
 {
@@ -216,10 +1160,10 @@ void bej_free(BejSet *val)
   
   if (val->type == BEJ_STRING)
   {
-    if (val->string_value)
-      free(val->string_value);
+    if (val->string_value.data && !val->string_value.borrowed)
+      free(val->string_value.data);
   }
-  else if (val->type == BEJ_SET)
+  else if (val->type == BEJ_SET || val->type == BEJ_ARRAY)
   {
     for (size_t i = 0; i < val->object_value.count; i++)
     {
@@ -231,6 +1175,73 @@ void bej_free(BejSet *val)
   free(val);
 }
 
+/**
+ * @brief Writes a BejSet value through a JSON writer
+ * 
+ * Recursively converts BEJ structure to JSON. Layout (pretty or compact),
+ * escaping and buffering are handled by the writer.
+ * 
+ * @param val BejSet structure to convert
+ * @param dict Children of the entry of @p val (SET members, the ARRAY
+ *             element entry or ENUM options), main_dictionary or
+ *             bej_dictionary_child(root, 0) of a loaded schema at the top
+ * @param w Writer receiving the JSON text
+ */
+void bej_to_json_writer(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  if (!w) return;
+  bej_emit_value(val, dict, w);
+}
+
+/**
+ * @brief Writes a value through the handler of its type
+ * 
+ * @param val Value, nothing is written for NULL or an unknown type
+ * @param dict Children of the value's entry
+ * @param w Writer receiving the JSON text
+ */
+static void bej_emit_value(BejSet *val, BejDictionary *dict, JsonWriter *w)
+{
+  if (!val || (size_t)val->type >= BEJ_TYPE_COUNT) return;
+  bej_type_handlers[val->type].emit(val, dict, w);
+}
+
+/**
+ * @brief Writer callback appending to a stdio stream
+ * 
+ * @param user FILE handle
+ * @param data Bytes to write
+ * @param length Number of bytes
+ * @return 0 on success, -1 on error
+ */
+int bej_json_fwrite(void *user, const char *data, size_t length)
+{
+  return fwrite(data, 1, length, (FILE *)user) == length ? 0 : -1;
+}
+
+/**
+ * @brief Writes a BejSet value as pretty or compact JSON to a stream
+ * 
+ * @param val BejSet structure to convert
+ * @param dict Dictionary for resolving field names
+ * @param f File handle to write JSON output
+ * @param depth Current indentation depth
+ * @param style JSON_PRETTY or JSON_COMPACT
+ */
+static void bej_emit_json(BejSet *val, BejDictionary *dict, FILE *f, int depth, int style)
+{
+  if (!val || !f) return;
+
+  JsonWriter w;
+  if (json_writer_init_callback(&w, bej_json_fwrite, f, style) != 0)
+    return;
+
+  w.depth = depth;
+  bej_to_json_writer(val, dict, &w);
+  json_writer_flush(&w);
+  json_writer_free(&w);
+}
+
 /**
  * @brief Converts BejSet value to JSON format and writes to file
  * 
@@ -243,40 +1254,19 @@ void bej_free(BejSet *val)
  */
 void bej_to_json_val(BejSet *val, BejDictionary *dict, FILE *f, int depth)
 {
-  if (!val || !f) return;
-  
-  if (val->type == BEJ_INTEGER)
-  {
-    fprintf(f, "%d", val->integer_value);
-  }
-  else if (val->type == BEJ_STRING)
-  {
-    fprintf(f, "\"%s\"", val->string_value ? val->string_value : "");
-  }
-  else if (val->type == BEJ_SET)
-  {
-    fprintf(f, "{\n");
-    for (size_t i = 0; i < val->object_value.count; i++)
-    {
-      uint8_t id = val->object_value.pairs[i].id;
-      const char *name = bej_find_in_dictionary(dict, id, NULL);
-      
-      if (!name) name = "UNKNOWN";
-    
-      
-      for (int j = 0; j < depth + 1; j++) fprintf(f, "  ");
-      fprintf(f, "\"%s\": ", name);
-      
-      BejDictionary *child_dict = bej_get_child_dictionary(id);
-      bej_to_json_val(val->object_value.pairs[i].value, child_dict, f, depth + 1);
-      
-      if (i < val->object_value.count - 1)
-        fprintf(f, ",");
-      fprintf(f, "\n");
-    }
-    for (int j = 0; j < depth; j++) fprintf(f, "  ");
-    fprintf(f, "}");
-  }
+  bej_emit_json(val, dict, f, depth, JSON_PRETTY);
+}
+
+/**
+ * @brief Converts BejSet value to JSON without any whitespace
+ * 
+ * @param val BejSet structure to convert
+ * @param dict Dictionary for resolving field names
+ * @param f File handle to write JSON output
+ */
+void bej_to_json_compact(BejSet *val, BejDictionary *dict, FILE *f)
+{
+  bej_emit_json(val, dict, f, 0, JSON_COMPACT);
 }
 
 /**
@@ -0,0 +1,212 @@
+/**
+ * @file bej_pool.c
+ * @brief Work-stealing thread pool
+ *
+ * Runs a fixed set of tasks, numbered 0 to n-1, on several threads. The
+ * numbers are dealt out as one contiguous range per worker. A worker
+ * takes tasks from the front of its own range; once it is empty, it
+ * steals the back half of the next non-empty range of another worker,
+ * so a few slow tasks do not leave the other threads idle. Ranges stay
+ * contiguous, each one is guarded by its own mutex.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../include/bej_pool.h"
+
+/*tasks still owned by one worker*/
+typedef struct BejPoolQueue
+{
+  pthread_mutex_t lock;
+  size_t head; /*next task*/
+  size_t tail; /*one past the last task*/
+} BejPoolQueue;
+
+typedef struct BejPool BejPool;
+
+/*state of one thread*/
+typedef struct BejPoolWorker
+{
+  BejPool *pool;
+  uint32_t index;
+  uint64_t steals;
+  pthread_t thread;
+} BejPoolWorker;
+
+struct BejPool
+{
+  BejPoolQueue *queues;
+  uint32_t workers;
+  BejPoolTask run;
+  void *user;
+};
+
+/**
+ * @brief Returns the number of online processors
+ *
+ * @return Processor count, at least 1
+ */
+uint32_t bej_pool_cpu_count(void)
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t)count : 1;
+}
+
+/**
+ * @brief Takes the next task of a worker's own range
+ *
+ * @param queue Range of the worker
+ * @param task Pointer to store the task number
+ * @return 1 if a task was taken, 0 if the range is empty
+ */
+static int bej_pool_pop(BejPoolQueue *queue, size_t *task)
+{
+  int found = 0;
+  pthread_mutex_lock(&queue->lock);
+  if (queue->head < queue->tail)
+  {
+    *task = queue->head++;
+    found = 1;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return found;
+}
+
+/**
+ * @brief Moves the back half of another worker's range to an idle worker
+ *
+ * Victims are tried in order starting after the thief.
+ *
+ * @param worker Idle worker, its own range is empty
+ * @return 1 if tasks were stolen, 0 if every range is empty
+ */
+static int bej_pool_steal(BejPoolWorker *worker)
+{
+  BejPool *pool = worker->pool;
+  for (uint32_t i = 1; i < pool->workers; i++)
+  {
+    BejPoolQueue *victim = &pool->queues[(worker->index + i) % pool->workers];
+    size_t start = 0;
+    size_t end = 0;
+
+    pthread_mutex_lock(&victim->lock);
+    size_t left = victim->tail - victim->head;
+    if (left > 0)
+    {
+      end = victim->tail;
+      start = end - (left + 1) / 2;
+      victim->tail = start;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    if (end > start)
+    {
+      BejPoolQueue *own = &pool->queues[worker->index];
+      pthread_mutex_lock(&own->lock);
+      own->head = start;
+      own->tail = end;
+      pthread_mutex_unlock(&own->lock);
+      worker->steals++;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Runs tasks until none are left anywhere
+ *
+ * @param arg The worker
+ * @return NULL
+ */
+static void *bej_pool_work(void *arg)
+{
+  BejPoolWorker *worker = arg;
+  BejPool *pool = worker->pool;
+  BejPoolQueue *own = &pool->queues[worker->index];
+
+  for (;;)
+  {
+    size_t task;
+    if (bej_pool_pop(own, &task))
+      pool->run(pool->user, worker->index, task);
+    else if (!bej_pool_steal(worker))
+      break;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Runs tasks 0 to tasks-1 on a number of threads and waits for them
+ *
+ * The calling thread is worker 0. If fewer threads can be started, the
+ * others take over their share, so every task still runs exactly once.
+ *
+ * @param workers Number of threads including the caller, 0 for one per
+ *                processor, at most BEJ_POOL_MAX_WORKERS
+ * @param tasks Number of tasks
+ * @param run Function called for every task, from any worker
+ * @param user Pointer passed to @p run
+ * @param stats Pointer to store the pool statistics, can be NULL
+ * @return 0 on success, -1 if the queues cannot be allocated
+ */
+int bej_pool_run(uint32_t workers, size_t tasks, BejPoolTask run, void *user, BejPoolStats *stats)
+{
+  if (workers == 0)
+    workers = bej_pool_cpu_count();
+  if (workers > BEJ_POOL_MAX_WORKERS)
+    workers = BEJ_POOL_MAX_WORKERS;
+  if (tasks > 0 && workers > tasks)
+    workers = (uint32_t)tasks;
+  if (workers == 0)
+    workers = 1;
+
+  BejPool pool = {NULL, workers, run, user};
+  pool.queues = malloc(sizeof(BejPoolQueue) * workers);
+  BejPoolWorker *threads = malloc(sizeof(BejPoolWorker) * workers);
+  if (!pool.queues || !threads)
+  {
+    free(pool.queues);
+    free(threads);
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < workers; i++)
+  {
+    pthread_mutex_init(&pool.queues[i].lock, NULL);
+    pool.queues[i].head = tasks * i / workers;
+    pool.queues[i].tail = tasks * (i + 1) / workers;
+    threads[i].pool = &pool;
+    threads[i].index = i;
+    threads[i].steals = 0;
+  }
+
+  uint32_t started = 1;
+  for (uint32_t i = 1; i < workers; i++)
+  {
+    if (pthread_create(&threads[started].thread, NULL, bej_pool_work, &threads[started]) != 0)
+      break;
+    started++;
+  }
+  bej_pool_work(&threads[0]);
+
+  uint64_t steals = threads[0].steals;
+  for (uint32_t i = 1; i < started; i++)
+  {
+    pthread_join(threads[i].thread, NULL);
+    steals += threads[i].steals;
+  }
+
+  for (uint32_t i = 0; i < workers; i++)
+    pthread_mutex_destroy(&pool.queues[i].lock);
+  free(pool.queues);
+  free(threads);
+
+  if (stats)
+  {
+    stats->workers = started;
+    stats->steals = steals;
+  }
+  return 0;
+}
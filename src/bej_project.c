@@ -0,0 +1,122 @@
+/**
+ * @file bej_project.c
+ * @brief Projections: decode only selected properties
+ *
+ * A projection is the set of dictionary paths a consumer needs, compiled
+ * into a tree of entry IDs. With ctx->projection set, the tree decoder
+ * and the SAX decoder (and so the transcoder) look every SET member up
+ * in the node of its SET: members that are not selected are stepped
+ * over by their length prefix without allocating anything, so the result
+ * is a sparse tree or sparse JSON text.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_project.h"
+
+/**
+ * @brief Adds a node
+ *
+ * @param proj Projection
+ * @param id Dictionary ID of the entry
+ * @return Index of the node, or -1 if out of memory
+ */
+static int32_t bej_projection_add(BejProjection *proj, uint16_t id)
+{
+  if (proj->count == proj->cap)
+  {
+    uint32_t cap = proj->cap ? proj->cap * 2 : 16;
+    BejProjectionNode *nodes = realloc(proj->nodes, sizeof(BejProjectionNode) * cap);
+    if (!nodes)
+      return -1;
+    proj->nodes = nodes;
+    proj->cap = cap;
+  }
+
+  BejProjectionNode *node = &proj->nodes[proj->count];
+  node->id = id;
+  node->all = 0;
+  node->child = -1;
+  node->next = -1;
+  return (int32_t)proj->count++;
+}
+
+/**
+ * @brief Compiles paths of dictionary names into a projection
+ *
+ * Paths are relative to the root SET and use the bej_query() syntax,
+ * e.g. "CapacityMiB" or "/MemoryLocation/Slot". A path selects its last
+ * entry whole, with every member below it; "/" selects everything. The
+ * SETs along a path are kept with only the selected members.
+ *
+ * @param proj Projection to fill, release it with bej_projection_free()
+ * @param members Dictionary of the root SET members, e.g.
+ *                bej_dictionary_child(main_dictionary, 0)
+ * @param paths Paths to select
+ * @param count Number of paths
+ * @return BEJ_OK, BEJ_ERR_SCHEMA if a name is not in its dictionary or a
+ *         path runs through a non-SET entry, BEJ_ERR_NOMEM
+ */
+BejError bej_projection_compile(BejProjection *proj, BejDictionary *members, const char *const *paths,
+                                size_t count)
+{
+  memset(proj, 0, sizeof(*proj));
+  if (bej_projection_add(proj, 0) < 0)
+    return BEJ_ERR_NOMEM;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const char *path = paths[i];
+    BejDictionary *dict = members;
+    int32_t node = 0;
+
+    while (*path == '/') path++;
+    while (*path != '\0' && !proj->nodes[node].all)
+    {
+      const char *name = path;
+      while (*path != '\0' && *path != '/') path++;
+      size_t length = (size_t)(path - name);
+      while (*path == '/') path++;
+
+      BejType type;
+      int32_t id = bej_find_id_in_dictionary(dict, name, length, &type);
+      if (id < 0 || (*path != '\0' && type != BEJ_SET))
+      {
+        bej_projection_free(proj);
+        return BEJ_ERR_SCHEMA;
+      }
+
+      int32_t child = proj->nodes[node].child;
+      while (child >= 0 && proj->nodes[child].id != (uint16_t)id)
+        child = proj->nodes[child].next;
+      if (child < 0)
+      {
+        child = bej_projection_add(proj, (uint16_t)id);
+        if (child < 0)
+        {
+          bej_projection_free(proj);
+          return BEJ_ERR_NOMEM;
+        }
+        proj->nodes[child].next = proj->nodes[node].child;
+        proj->nodes[node].child = child;
+      }
+      node = child;
+      dict = bej_dictionary_child(dict, (uint16_t)id);
+    }
+    proj->nodes[node].all = 1;
+  }
+  return BEJ_OK;
+}
+
+/**
+ * @brief Releases a projection
+ *
+ * @param proj Projection
+ */
+void bej_projection_free(BejProjection *proj)
+{
+  free(proj->nodes);
+  proj->nodes = NULL;
+  proj->count = 0;
+  proj->cap = 0;
+}
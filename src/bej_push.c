@@ -0,0 +1,617 @@
+/**
+ * @file bej_push.c
+ * @brief Resumable BEJ decoder for chunked input
+ *
+ * A state machine that is fed BEJ bytes as they arrive, split anywhere,
+ * including inside an nnint, a number or a string. Every BEJ type is
+ * reported through the SAX callbacks as soon as its last byte is in. Open
+ * SETs and ARRAYs live on a fixed stack with the input offset where their
+ * members end, so nothing but strings split across chunks is ever buffered.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_push.h"
+
+/*states of the decoder*/
+enum
+{
+  BEJ_PUSH_ID,      /*reading the ID nnint*/
+  BEJ_PUSH_TYPE,    /*reading the type byte*/
+  BEJ_PUSH_LENGTH,  /*reading the length nnint*/
+  BEJ_PUSH_COUNT,   /*reading the element count nnint of an ARRAY*/
+  BEJ_PUSH_ENUM,    /*reading the option nnint of an ENUM*/
+  BEJ_PUSH_SCALAR,  /*reading integer, real or boolean bytes*/
+  BEJ_PUSH_STRING,  /*reading string bytes*/
+  BEJ_PUSH_SKIP,    /*stepping over a skipped payload*/
+  BEJ_PUSH_DONE     /*root value complete*/
+};
+
+/**
+ * @brief Records an error, only the first one is kept
+ *
+ * @param push Decoder
+ * @param error Error code to record
+ */
+static void bej_push_fail(BejPushDecoder *push, BejError error)
+{
+  if (push->error != BEJ_OK)
+    return;
+
+  push->error = error;
+  push->error_offset = push->offset;
+}
+
+/**
+ * @brief Applies a callback result
+ *
+ * @param push Decoder
+ * @param action Value returned by a callback
+ * @return 0 if decoding has to stop, 1 otherwise
+ */
+static int bej_push_check(BejPushDecoder *push, BejSaxAction action)
+{
+  if (action != BEJ_SAX_STOP)
+    return 1;
+
+  bej_push_fail(push, BEJ_ERR_ABORTED);
+  return 0;
+}
+
+/**
+ * @brief Initializes a decoder for one message
+ *
+ * @param push Decoder to initialize
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @param cb Event handlers, as for bej_sax_parse()
+ * @param user Pointer passed to every handler
+ */
+void bej_push_init(BejPushDecoder *push, BejDictionary *dict, const BejSaxCallbacks *cb, void *user)
+{
+  memset(push, 0, sizeof(*push));
+  push->dict = dict;
+  push->cb = cb;
+  push->user = user;
+}
+
+/**
+ * @brief Prepares the decoder for the next message
+ *
+ * Keeps the dictionary, the handlers and the string buffer.
+ *
+ * @param push Decoder
+ */
+void bej_push_reset(BejPushDecoder *push)
+{
+  char *buf = push->buf;
+  uint32_t buf_cap = push->buf_cap;
+  bej_push_init(push, push->dict, push->cb, push->user);
+  push->buf = buf;
+  push->buf_cap = buf_cap;
+}
+
+/**
+ * @brief Releases the string buffer
+ *
+ * @param push Decoder, it can be reset and used again afterwards
+ */
+void bej_push_free(BejPushDecoder *push)
+{
+  free(push->buf);
+  push->buf = NULL;
+  push->buf_cap = 0;
+}
+
+/**
+ * @brief Adds one byte to the nnint being read
+ *
+ * @param push Decoder
+ * @param byte Next input byte
+ * @param max Largest accepted value
+ * @return 1 when the nnint is complete, 0 if more bytes are needed or
+ *         after recording BEJ_ERR_LENGTH
+ */
+static int bej_push_nnint(BejPushDecoder *push, uint8_t byte, uint32_t max)
+{
+  if (push->nnint_done++ == 0)
+  {
+    if (byte > sizeof(uint32_t))
+    {
+      bej_push_fail(push, BEJ_ERR_LENGTH);
+      return 0;
+    }
+    push->nnint_size = byte;
+  }
+  else
+  {
+    push->value |= (uint64_t)byte << (8 * (push->nnint_done - 2));
+  }
+  if (push->nnint_done <= push->nnint_size)
+    return 0;
+
+  push->nnint_done = 0;
+  if (push->value > max)
+  {
+    bej_push_fail(push, BEJ_ERR_LENGTH);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Returns the dictionary entry of the current value
+ *
+ * ARRAY elements are tagged with their index but all described by the
+ * single child entry of the array, as in bej_sax_parse().
+ *
+ * @param push Decoder, id is set
+ * @param id Pointer to store the ID of the entry
+ * @return Dictionary holding the entry
+ */
+static BejDictionary *bej_push_entry(BejPushDecoder *push, uint16_t *id)
+{
+  if (push->depth == 0)
+  {
+    *id = push->id;
+    return push->dict;
+  }
+
+  BejPushFrame *frame = &push->stack[push->depth - 1];
+  *id = frame->array ? frame->dict->id : push->id;
+  return frame->dict;
+}
+
+/**
+ * @brief Closes the SETs and ARRAYs that end at the current offset
+ *
+ * Called whenever a value is complete. Moves on to the next tag, or to
+ * BEJ_PUSH_DONE once the root is complete. An ARRAY whose elements do not
+ * take exactly its payload fails as in bej_read_value().
+ *
+ * @param push Decoder
+ */
+static void bej_push_complete(BejPushDecoder *push)
+{
+  while (push->depth > 0)
+  {
+    BejPushFrame *frame = &push->stack[push->depth - 1];
+    BejSaxAction action;
+    if (frame->array)
+    {
+      if (frame->left > 0 && push->offset < frame->end)
+        break;
+      if (frame->left > 0 || push->offset != frame->end)
+      {
+        bej_push_fail(push, frame->left > 0 ? BEJ_ERR_TRUNCATED : BEJ_ERR_LENGTH);
+        return;
+      }
+      push->depth--;
+      action = push->cb->end_array ? push->cb->end_array(push->user) : BEJ_SAX_CONTINUE;
+    }
+    else
+    {
+      if (push->offset != frame->end)
+        break;
+      push->depth--;
+      action = push->cb->end_set ? push->cb->end_set(push->user) : BEJ_SAX_CONTINUE;
+    }
+    if (!bej_push_check(push, action))
+      return;
+  }
+
+  push->state = push->depth > 0 ? BEJ_PUSH_ID : BEJ_PUSH_DONE;
+  push->value = 0;
+}
+
+/**
+ * @brief Handles a complete tag
+ *
+ * Announces SET members through the property callback and ARRAY elements
+ * through the element callback.
+ *
+ * @param push Decoder, id and type are set
+ */
+static void bej_push_tag(BejPushDecoder *push)
+{
+  push->skip = 0;
+  if (push->depth > 0)
+  {
+    BejPushFrame *frame = &push->stack[push->depth - 1];
+    BejSaxAction action = BEJ_SAX_CONTINUE;
+    if (frame->array)
+    {
+      frame->left--;
+      if (push->cb->element)
+        action = push->cb->element(push->user, push->id, (BejType)push->type);
+    }
+    else if (push->cb->property)
+    {
+      const char *name = bej_find_in_dictionary(frame->dict, push->id, NULL);
+      action = push->cb->property(push->user, push->id, name, (BejType)push->type);
+    }
+    if (!bej_push_check(push, action))
+      return;
+    push->skip = action == BEJ_SAX_SKIP;
+  }
+  if (!push->skip && push->type > BEJ_BOOLEAN)
+  {
+    bej_push_fail(push, BEJ_ERR_TYPE);
+    return;
+  }
+
+  push->state = BEJ_PUSH_LENGTH;
+  push->value = 0;
+}
+
+/**
+ * @brief Reports a complete null, integer, real or boolean
+ *
+ * Integers shorter than 8 bytes are sign-extended, as in bej_read_integer().
+ *
+ * @param push Decoder
+ */
+static void bej_push_scalar(BejPushDecoder *push)
+{
+  const BejSaxCallbacks *cb = push->cb;
+  uint64_t value = push->value;
+  BejSaxAction action = BEJ_SAX_CONTINUE;
+
+  switch (push->type)
+  {
+    case BEJ_NULL:
+      if (cb->null_value)
+        action = cb->null_value(push->user);
+      break;
+    case BEJ_INTEGER:
+      if (push->length > 0 && push->length < sizeof(value) && (value >> (8 * push->length - 1)) & 1)
+        value |= UINT64_MAX << (8 * push->length);
+      if (cb->integer)
+        action = cb->integer(push->user, (int64_t)value);
+      break;
+    case BEJ_REAL:
+      if (cb->real)
+      {
+        double real;
+        memcpy(&real, &value, sizeof(real));
+        action = cb->real(push->user, real);
+      }
+      break;
+    case BEJ_BOOLEAN:
+      if (cb->boolean)
+        action = cb->boolean(push->user, value != 0);
+      break;
+  }
+
+  if (bej_push_check(push, action))
+    bej_push_complete(push);
+}
+
+/**
+ * @brief Reports a complete enum
+ *
+ * @param push Decoder, the option is in value
+ */
+static void bej_push_enum(BejPushDecoder *push)
+{
+  if (push->done != push->length)
+  {
+    bej_push_fail(push, BEJ_ERR_LENGTH); /*option does not fill the payload*/
+    return;
+  }
+
+  uint16_t option = (uint16_t)push->value;
+  if (push->cb->enumeration)
+  {
+    uint16_t id;
+    BejDictionary *dict = bej_push_entry(push, &id);
+    const char *name = bej_find_in_dictionary(bej_dictionary_child(dict, id), option, NULL);
+    if (!bej_push_check(push, push->cb->enumeration(push->user, option, name)))
+      return;
+  }
+  bej_push_complete(push);
+}
+
+/**
+ * @brief Opens a SET or ARRAY
+ *
+ * @param push Decoder, the offset is at the first member or element
+ * @param length Bytes of the members or elements
+ * @param count Number of elements of an ARRAY
+ */
+static void bej_push_open(BejPushDecoder *push, uint32_t length, uint16_t count)
+{
+  if (push->depth == BEJ_PUSH_DEPTH)
+  {
+    bej_push_fail(push, BEJ_ERR_LENGTH);
+    return;
+  }
+
+  uint16_t id;
+  BejDictionary *dict = bej_push_entry(push, &id);
+  BejPushFrame *frame = &push->stack[push->depth];
+  frame->end = push->offset + length;
+  frame->dict = bej_dictionary_child(dict, id);
+  frame->left = count;
+  frame->array = push->type == BEJ_ARRAY;
+  push->depth++;
+  push->state = BEJ_PUSH_ID;
+  bej_push_complete(push);
+}
+
+/**
+ * @brief Handles a complete element count
+ *
+ * @param push Decoder, the count is in value
+ */
+static void bej_push_array(BejPushDecoder *push)
+{
+  uint32_t length = push->length - push->done;
+  uint16_t count = (uint16_t)push->value;
+
+  /* Every element takes at least a tag and a length */
+  if ((uint64_t)count * 3 > length)
+  {
+    bej_push_fail(push, BEJ_ERR_TRUNCATED);
+    return;
+  }
+
+  BejSaxAction action = push->cb->start_array ? push->cb->start_array(push->user, count) : BEJ_SAX_CONTINUE;
+  if (!bej_push_check(push, action))
+    return;
+  if (action == BEJ_SAX_SKIP)
+  {
+    push->length = length;
+    push->done = 0;
+    push->state = BEJ_PUSH_SKIP;
+    if (length == 0)
+      bej_push_complete(push);
+    return;
+  }
+
+  push->value = 0;
+  bej_push_open(push, length, count);
+}
+
+/**
+ * @brief Handles a complete length
+ *
+ * Opens SETs and prepares the other types, values without payload are
+ * complete right away. Payload sizes are checked per type as in the tree
+ * decoder.
+ *
+ * @param push Decoder, the offset is at the payload
+ */
+static void bej_push_length(BejPushDecoder *push)
+{
+  uint32_t length = (uint32_t)push->value;
+  size_t set_end = push->depth > 0 ? push->stack[push->depth - 1].end : SIZE_MAX;
+  if (push->offset > set_end || length > set_end - push->offset)
+  {
+    bej_push_fail(push, BEJ_ERR_TRUNCATED);
+    return;
+  }
+
+  push->length = length;
+  push->done = 0;
+  push->value = 0;
+
+  if (!push->skip)
+  {
+    push->stats.values++;
+    if (push->type == BEJ_SET)
+    {
+      BejSaxAction action = push->cb->start_set ? push->cb->start_set(push->user) : BEJ_SAX_CONTINUE;
+      if (!bej_push_check(push, action))
+        return;
+      push->skip = action == BEJ_SAX_SKIP;
+    }
+  }
+
+  if (push->skip)
+  {
+    push->state = BEJ_PUSH_SKIP;
+    if (length == 0)
+      bej_push_complete(push);
+    return;
+  }
+
+  switch (push->type)
+  {
+    case BEJ_SET:
+      bej_push_open(push, length, 0);
+      return;
+
+    case BEJ_ARRAY:
+    case BEJ_ENUM:
+      /* The payload starts with an nnint */
+      if (length == 0)
+      {
+        bej_push_fail(push, BEJ_ERR_TRUNCATED);
+        return;
+      }
+      push->state = push->type == BEJ_ARRAY ? BEJ_PUSH_COUNT : BEJ_PUSH_ENUM;
+      return;
+
+    case BEJ_NULL:
+    case BEJ_REAL:
+    case BEJ_BOOLEAN:
+    {
+      uint32_t size = push->type == BEJ_NULL ? 0 : push->type == BEJ_REAL ? sizeof(double) : 1;
+      if (length != size)
+      {
+        bej_push_fail(push, BEJ_ERR_LENGTH);
+        return;
+      }
+      break;
+    }
+
+    case BEJ_STRING:
+      push->state = BEJ_PUSH_STRING;
+      if (length > 0)
+        return;
+      if (push->cb->string && !bej_push_check(push, push->cb->string(push->user, "", 0)))
+        return;
+      bej_push_complete(push);
+      return;
+  }
+
+  push->state = BEJ_PUSH_SCALAR;
+  if (length == 0)
+    bej_push_scalar(push);
+}
+
+/**
+ * @brief Consumes string bytes
+ *
+ * A string that is whole inside the chunk is reported in place, one split
+ * across chunks is collected in the decoder's buffer first.
+ *
+ * @param push Decoder
+ * @param data Chunk at the next string byte
+ * @param size Bytes left in the chunk
+ * @return Number of bytes consumed
+ */
+static size_t bej_push_string(BejPushDecoder *push, const uint8_t *data, size_t size)
+{
+  uint32_t missing = push->length - push->done;
+  size_t n = size < missing ? size : missing;
+  const char *value = (const char *)data;
+
+  if (push->done > 0 || n < missing)
+  {
+    if (push->buf_cap < push->length)
+    {
+      char *buf = realloc(push->buf, push->length);
+      if (!buf)
+      {
+        bej_push_fail(push, BEJ_ERR_NOMEM);
+        return 0;
+      }
+      push->buf = buf;
+      push->buf_cap = push->length;
+    }
+    memcpy(push->buf + push->done, data, n);
+    value = push->buf;
+  }
+
+  push->done += (uint32_t)n;
+  push->offset += n;
+  if (push->done < push->length)
+    return n;
+
+  if (push->cb->string && !bej_push_check(push, push->cb->string(push->user, value, push->length)))
+    return n;
+  bej_push_complete(push);
+  return n;
+}
+
+/**
+ * @brief Decodes the next chunk of a message
+ *
+ * Chunks can be split at any byte. Every value is reported as soon as it
+ * is complete; callbacks may skip members or stop, as for bej_sax_parse().
+ * Bytes after the root value are not consumed, push->offset tells where
+ * the message ended.
+ *
+ * @param push Decoder
+ * @param data Next bytes of the message, only needed during the call
+ * @param size Number of bytes
+ * @return BEJ_OK, or the first error (also kept in push->error)
+ */
+BejError bej_push_feed(BejPushDecoder *push, const uint8_t *data, size_t size)
+{
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+
+  while (p < end && push->error == BEJ_OK && push->state != BEJ_PUSH_DONE)
+  {
+    switch (push->state)
+    {
+      case BEJ_PUSH_ID:
+        push->offset++;
+        if (bej_push_nnint(push, *p++, UINT16_MAX))
+        {
+          push->id = (uint16_t)push->value;
+          push->state = BEJ_PUSH_TYPE;
+        }
+        break;
+
+      case BEJ_PUSH_TYPE:
+        push->offset++;
+        push->type = *p++;
+        bej_push_tag(push);
+        break;
+
+      case BEJ_PUSH_LENGTH:
+        push->offset++;
+        if (bej_push_nnint(push, *p++, UINT32_MAX))
+          bej_push_length(push);
+        break;
+
+      case BEJ_PUSH_COUNT:
+      case BEJ_PUSH_ENUM:
+      {
+        push->offset++;
+        push->done++;
+        if (bej_push_nnint(push, *p++, UINT16_MAX))
+        {
+          if (push->state == BEJ_PUSH_COUNT)
+            bej_push_array(push);
+          else
+            bej_push_enum(push);
+        }
+        else if (push->error == BEJ_OK && push->done == push->length)
+          bej_push_fail(push, BEJ_ERR_TRUNCATED); /*nnint runs past the payload*/
+        break;
+      }
+
+      case BEJ_PUSH_SCALAR:
+        if (push->done < sizeof(push->value))
+          push->value |= (uint64_t)*p << (8 * push->done);
+        else if (*p != ((push->value >> 63) ? 0xFF : 0x00))
+        {
+          bej_push_fail(push, BEJ_ERR_LENGTH); /*wider than 64 bits*/
+          break;
+        }
+        p++;
+        push->offset++;
+        if (++push->done == push->length)
+          bej_push_scalar(push);
+        break;
+
+      case BEJ_PUSH_STRING:
+        p += bej_push_string(push, p, (size_t)(end - p));
+        break;
+
+      case BEJ_PUSH_SKIP:
+      {
+        size_t n = (size_t)(end - p);
+        if (n > push->length - push->done)
+          n = push->length - push->done;
+        p += n;
+        push->offset += n;
+        push->done += (uint32_t)n;
+        if (push->done == push->length)
+          bej_push_complete(push);
+        break;
+      }
+    }
+  }
+  return push->error;
+}
+
+/**
+ * @brief Ends a message
+ *
+ * @param push Decoder
+ * @return BEJ_OK if the root value was complete, BEJ_ERR_TRUNCATED if the
+ *         input stopped inside it, otherwise the first error
+ */
+BejError bej_push_finish(BejPushDecoder *push)
+{
+  if (push->state != BEJ_PUSH_DONE)
+    bej_push_fail(push, BEJ_ERR_TRUNCATED);
+  return push->error;
+}
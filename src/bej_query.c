@@ -0,0 +1,115 @@
+/**
+ * @file bej_query.c
+ * @brief Path queries against encoded BEJ
+ *
+ * Resolves a path of dictionary names straight on the BEJ bytes. Each
+ * name becomes an ID in the dictionary of the enclosing SET, then the
+ * members of that SET are stepped over by their length prefixes until
+ * the ID turns up, so sibling subtrees are never decoded. Only the value
+ * at the end of the path is decoded.
+ */
+
+#include "../include/bej_query.h"
+
+/**
+ * @brief Positions the decoder at the value a path names
+ *
+ * On success the cursor is at the tag of the value and ctx->end is the
+ * end of the SET that holds it, ready for bej_read_value(),
+ * bej_skip_value() or the SAX and tape decoders. ctx->depth counts the
+ * SETs on the path, so the value nests as deep as in a full decode. An
+ * empty path or "/" names the root itself.
+ *
+ * @param ctx Decoder context, the cursor must be at the root value ID
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @param path Names separated by '/', the leading '/' is optional
+ * @param entry_dict Pointer to store the dictionary holding the value's
+ *                   entry, can be NULL
+ * @return BEJ_OK, BEJ_ERR_SCHEMA if a name is not in its dictionary,
+ *         BEJ_ERR_NOT_FOUND if the payload lacks the value or the path
+ *         runs through a non-SET, otherwise the decoding error
+ */
+BejError bej_query_locate(BejDecoder *ctx, BejDictionary *dict, const char *path,
+                          BejDictionary **entry_dict)
+{
+  const uint8_t *value = ctx->cursor;
+  uint16_t id;
+  uint8_t type;
+  if (!bej_read_tag(ctx, &id, &type))
+    return ctx->error;
+
+  while (*path == '/') path++;
+  while (*path != '\0')
+  {
+    const char *name = path;
+    while (*path != '\0' && *path != '/') path++;
+    size_t length = (size_t)(path - name);
+    while (*path == '/') path++;
+
+    if (type != BEJ_SET)
+    {
+      bej_decoder_fail(ctx, BEJ_ERR_NOT_FOUND);
+      return ctx->error;
+    }
+
+    BejDictionary *members = bej_dictionary_child(dict, id);
+    int32_t wanted = bej_find_id_in_dictionary(members, name, length, NULL);
+    if (wanted < 0)
+    {
+      bej_decoder_fail(ctx, BEJ_ERR_SCHEMA);
+      return ctx->error;
+    }
+
+    uint32_t set_length;
+    if (!bej_decoder_enter(ctx) || !bej_read_length(ctx, &set_length))
+      return ctx->error;
+    ctx->end = ctx->cursor + set_length;
+
+    /* Siblings are skipped by their length, whatever they contain */
+    for (;;)
+    {
+      if (ctx->cursor >= ctx->end)
+      {
+        bej_decoder_fail(ctx, BEJ_ERR_NOT_FOUND);
+        return ctx->error;
+      }
+
+      value = ctx->cursor;
+      if (!bej_read_tag(ctx, &id, &type))
+        return ctx->error;
+      if (id == (uint16_t)wanted)
+        break;
+
+      uint32_t skip;
+      if (!bej_read_length(ctx, &skip))
+        return ctx->error;
+      ctx->cursor += skip;
+    }
+    dict = members;
+  }
+
+  ctx->cursor = value;
+  if (entry_dict)
+    *entry_dict = dict;
+  return BEJ_OK;
+}
+
+/**
+ * @brief Decodes only the value a path names
+ *
+ * @param ctx Decoder context, the cursor must be at the root value ID
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @param path Names separated by '/', e.g. "/MemoryLocation/Slot"
+ * @return Decoded value, or NULL with the error in ctx->error, see
+ *         bej_query_locate()
+ * @note Free the value with bej_free() unless it came from ctx->arena
+ */
+BejSet *bej_query(BejDecoder *ctx, BejDictionary *dict, const char *path)
+{
+  BejDictionary *entry_dict;
+  if (bej_query_locate(ctx, dict, path, &entry_dict) != BEJ_OK)
+    return NULL;
+  return bej_read_value(ctx, entry_dict);
+}
@@ -0,0 +1,322 @@
+/**
+ * @file bej_sax.c
+ * @brief Event-driven BEJ decoder
+ *
+ * Walks BEJ data and reports every SET, ARRAY, member and scalar through
+ * callbacks instead of building a BejSet tree. Names are resolved with the
+ * same dictionary lookups as the tree decoder. No memory is allocated,
+ * strings are passed as views into the input buffer.
+ */
+
+#include "../include/bej_sax.h"
+
+static int bej_sax_value(BejDecoder *ctx, uint16_t id, uint8_t type, BejDictionary *dict,
+                         const BejSaxCallbacks *cb, void *user);
+
+/**
+ * @brief Applies a callback result
+ *
+ * @param ctx Decoder context
+ * @param action Value returned by a callback
+ * @return 0 if decoding has to stop, 1 otherwise
+ */
+static int bej_sax_check(BejDecoder *ctx, BejSaxAction action)
+{
+  if (action != BEJ_SAX_STOP)
+    return 1;
+
+  bej_decoder_fail(ctx, BEJ_ERR_ABORTED);
+  return 0;
+}
+
+/**
+ * @brief Reports a SET and its members
+ *
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param parent_id ID of the SET (used for dictionary lookup)
+ * @param dict Dictionary the SET itself was found in
+ * @param cb Event handlers
+ * @param user Pointer passed to every handler
+ * @return 1 on success, 0 on error
+ */
+static int bej_sax_set(BejDecoder *ctx, uint16_t parent_id, BejDictionary *dict,
+                       const BejSaxCallbacks *cb, void *user)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+
+  BejSaxAction action = cb->start_set ? cb->start_set(user) : BEJ_SAX_CONTINUE;
+  if (!bej_sax_check(ctx, action))
+    return 0;
+  if (action == BEJ_SAX_SKIP)
+  {
+    ctx->cursor += length;
+    return 1;
+  }
+
+  BejDictionary *child_dict = bej_dictionary_child(dict, parent_id);
+
+  /* Members must not read past the end of the SET */
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+
+  int ok = 1;
+  while (ok && ctx->cursor < ctx->end)
+  {
+    const uint8_t *member = ctx->cursor;
+    uint16_t id;
+    uint8_t type;
+    if (!bej_read_tag(ctx, &id, &type))
+    {
+      ok = 0;
+      break;
+    }
+
+    /* Members left out by the projection are not reported */
+    int32_t node = bej_projection_member(ctx, id);
+    if (node == BEJ_PROJECTION_SKIP)
+    {
+      ctx->cursor = member;
+      ok = bej_skip_value(ctx);
+      continue;
+    }
+
+    action = BEJ_SAX_CONTINUE;
+    if (cb->property)
+      action = cb->property(user, id, bej_find_in_dictionary(child_dict, id, NULL), type);
+
+    if (!bej_sax_check(ctx, action))
+      ok = 0;
+    else if (action == BEJ_SAX_SKIP)
+    {
+      ctx->cursor = member;
+      ok = bej_skip_value(ctx);
+    }
+    else
+    {
+      int32_t outer_node = ctx->projection_node;
+      ctx->projection_node = node;
+      ok = bej_sax_value(ctx, id, type, child_dict, cb, user);
+      ctx->projection_node = outer_node;
+    }
+  }
+
+  ctx->end = outer_end;
+  if (!ok)
+    return 0;
+
+  return bej_sax_check(ctx, cb->end_set ? cb->end_set(user) : BEJ_SAX_CONTINUE);
+}
+
+/**
+ * @brief Reports an ARRAY and its elements
+ *
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param id ID of the array (used for dictionary lookup)
+ * @param dict Dictionary holding the array's entry
+ * @param cb Event handlers
+ * @param user Pointer passed to every handler
+ * @return 1 on success, 0 on error
+ */
+static int bej_sax_array(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                         const BejSaxCallbacks *cb, void *user)
+{
+  uint32_t length;
+  uint16_t count;
+  if (!bej_read_array_header(ctx, &length, &count))
+    return 0;
+
+  BejSaxAction action = cb->start_array ? cb->start_array(user, count) : BEJ_SAX_CONTINUE;
+  if (!bej_sax_check(ctx, action))
+    return 0;
+  if (action == BEJ_SAX_SKIP)
+  {
+    ctx->cursor += length;
+    return 1;
+  }
+
+  /* Elements are tagged with their index, the entry describing them comes first */
+  BejDictionary *elements = bej_dictionary_child(dict, id);
+
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+
+  int ok = 1;
+  for (uint16_t i = 0; ok && i < count; i++)
+  {
+    const uint8_t *element = ctx->cursor;
+    uint16_t index;
+    uint8_t type;
+    if (!bej_read_tag(ctx, &index, &type))
+    {
+      ok = 0;
+      break;
+    }
+
+    action = cb->element ? cb->element(user, index, type) : BEJ_SAX_CONTINUE;
+    if (!bej_sax_check(ctx, action))
+      ok = 0;
+    else if (action == BEJ_SAX_SKIP)
+    {
+      ctx->cursor = element;
+      ok = bej_skip_value(ctx);
+    }
+    else
+      ok = bej_sax_value(ctx, elements->id, type, elements, cb, user);
+  }
+  if (ok && ctx->cursor != ctx->end)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    ok = 0;
+  }
+
+  ctx->end = outer_end;
+  if (!ok)
+    return 0;
+
+  return bej_sax_check(ctx, cb->end_array ? cb->end_array(user) : BEJ_SAX_CONTINUE);
+}
+
+/* Scalars, reported once read and checked */
+
+static int bej_sax_null(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                        const BejSaxCallbacks *cb, void *user)
+{
+  (void)id;
+  (void)dict;
+  if (!bej_read_null(ctx))
+    return 0;
+  return bej_sax_check(ctx, cb->null_value ? cb->null_value(user) : BEJ_SAX_CONTINUE);
+}
+
+static int bej_sax_integer(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                           const BejSaxCallbacks *cb, void *user)
+{
+  (void)id;
+  (void)dict;
+  int64_t value = bej_read_integer(ctx);
+  if (ctx->error != BEJ_OK)
+    return 0;
+  return bej_sax_check(ctx, cb->integer ? cb->integer(user, value) : BEJ_SAX_CONTINUE);
+}
+
+static int bej_sax_enum(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                        const BejSaxCallbacks *cb, void *user)
+{
+  uint16_t option = bej_read_enum(ctx);
+  if (ctx->error != BEJ_OK)
+    return 0;
+  if (!cb->enumeration)
+    return 1;
+  const char *name = bej_find_in_dictionary(bej_dictionary_child(dict, id), option, NULL);
+  return bej_sax_check(ctx, cb->enumeration(user, option, name));
+}
+
+static int bej_sax_string(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                          const BejSaxCallbacks *cb, void *user)
+{
+  (void)id;
+  (void)dict;
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+  const char *value = (const char *)ctx->cursor;
+  ctx->cursor += length;
+  return bej_sax_check(ctx, cb->string ? cb->string(user, value, length) : BEJ_SAX_CONTINUE);
+}
+
+static int bej_sax_real(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                        const BejSaxCallbacks *cb, void *user)
+{
+  (void)id;
+  (void)dict;
+  double value = bej_read_real(ctx);
+  if (ctx->error != BEJ_OK)
+    return 0;
+  return bej_sax_check(ctx, cb->real ? cb->real(user, value) : BEJ_SAX_CONTINUE);
+}
+
+static int bej_sax_boolean(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                           const BejSaxCallbacks *cb, void *user)
+{
+  (void)id;
+  (void)dict;
+  int value = bej_read_boolean(ctx);
+  if (ctx->error != BEJ_OK)
+    return 0;
+  return bej_sax_check(ctx, cb->boolean ? cb->boolean(user, value) : BEJ_SAX_CONTINUE);
+}
+
+typedef int (*BejSaxReader)(BejDecoder *ctx, uint16_t id, BejDictionary *dict,
+                            const BejSaxCallbacks *cb, void *user);
+
+/**
+ * @brief Readers indexed by BEJ type, as in the tree decoder
+ */
+static const BejSaxReader bej_sax_readers[] = {
+  [BEJ_SET] = bej_sax_set,
+  [BEJ_ARRAY] = bej_sax_array,
+  [BEJ_NULL] = bej_sax_null,
+  [BEJ_INTEGER] = bej_sax_integer,
+  [BEJ_ENUM] = bej_sax_enum,
+  [BEJ_STRING] = bej_sax_string,
+  [BEJ_REAL] = bej_sax_real,
+  [BEJ_BOOLEAN] = bej_sax_boolean,
+};
+
+/**
+ * @brief Reports one value whose tag has been read
+ *
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param id ID of the value
+ * @param type BEJ type of the value
+ * @param dict Dictionary holding the value's entry
+ * @param cb Event handlers
+ * @param user Pointer passed to every handler
+ * @return 1 on success, 0 on error
+ */
+static int bej_sax_value(BejDecoder *ctx, uint16_t id, uint8_t type, BejDictionary *dict,
+                         const BejSaxCallbacks *cb, void *user)
+{
+  if (type >= sizeof(bej_sax_readers) / sizeof(bej_sax_readers[0]))
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_TYPE);
+    return 0;
+  }
+
+  ctx->stats.values++;
+
+  /* Nesting is capped as in the tree decoder */
+  int nested = type == BEJ_SET || type == BEJ_ARRAY;
+  if (nested && !bej_decoder_enter(ctx))
+    return 0;
+  int ok = bej_sax_readers[type](ctx, id, dict, cb, user);
+  if (nested)
+    bej_decoder_leave(ctx);
+  return ok;
+}
+
+/**
+ * @brief Decodes one BEJ value and reports it through callbacks
+ *
+ * The root value is reported without a property event. Every SET member is
+ * announced by the property callback, which can skip it by returning
+ * BEJ_SAX_SKIP; skipped members are stepped over by their length.
+ *
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param dict Dictionary holding the root entry, main_dictionary or the
+ *             root of a loaded schema
+ * @param cb Event handlers
+ * @param user Pointer passed to every handler
+ * @return BEJ_OK on success, otherwise the error stored in ctx->error
+ */
+BejError bej_sax_parse(BejDecoder *ctx, BejDictionary *dict, const BejSaxCallbacks *cb, void *user)
+{
+  uint16_t id;
+  uint8_t type;
+  if (bej_read_tag(ctx, &id, &type))
+    bej_sax_value(ctx, id, type, dict, cb, user);
+
+  return ctx->error;
+}
@@ -0,0 +1,429 @@
+/**
+ * @file bej_tape.c
+ * @brief Flat tape representation of decoded BEJ
+ *
+ * Decodes a BEJ value into one contiguous array of fixed-size entries in
+ * document order instead of a tree of BejSet nodes. A SET or ARRAY entry
+ * is followed by its members or elements and closed by a BEJ_TAPE_END
+ * entry, and every entry records the index one past its subtree, so whole
+ * subtrees are skipped without touching them. The array is reused across
+ * documents.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bej_tape.h"
+
+/**
+ * @brief Initializes an empty tape
+ *
+ * @param tape Tape to initialize
+ */
+void bej_tape_init(BejTape *tape)
+{
+  memset(tape, 0, sizeof(*tape));
+}
+
+/**
+ * @brief Releases the entries of a tape
+ *
+ * @param tape Tape to release, it can be used again afterwards
+ */
+void bej_tape_free(BejTape *tape)
+{
+  free(tape->entries);
+  bej_tape_init(tape);
+}
+
+/**
+ * @brief Appends an entry
+ *
+ * @param ctx Decoder context, receives BEJ_ERR_NOMEM
+ * @param tape Tape to grow
+ * @return Index of the new entry, or BEJ_TAPE_NONE on error
+ */
+static uint32_t bej_tape_push(BejDecoder *ctx, BejTape *tape)
+{
+  if (tape->count == tape->capacity)
+  {
+    uint32_t capacity = tape->capacity ? tape->capacity * 2 : 64;
+    BejTapeEntry *entries = capacity > tape->capacity
+                            ? realloc(tape->entries, sizeof(BejTapeEntry) * capacity)
+                            : NULL;
+    if (!entries)
+    {
+      bej_decoder_fail(ctx, BEJ_ERR_NOMEM);
+      return BEJ_TAPE_NONE;
+    }
+    tape->entries = entries;
+    tape->capacity = capacity;
+  }
+
+  BejTapeEntry *entry = &tape->entries[tape->count];
+  memset(entry, 0, sizeof(*entry));
+  return tape->count++;
+}
+
+static int bej_tape_value(BejDecoder *ctx, BejTape *tape, uint16_t id, uint8_t type);
+
+/**
+ * @brief Appends the entry closing a SET or ARRAY
+ *
+ * @param ctx Decoder context
+ * @param tape Tape to append to
+ * @param index Index of the SET or ARRAY entry
+ * @param count Number of members or elements
+ * @return 1 on success, 0 on error
+ */
+static int bej_tape_close(BejDecoder *ctx, BejTape *tape, uint32_t index, uint32_t count)
+{
+  uint32_t close = bej_tape_push(ctx, tape);
+  if (close == BEJ_TAPE_NONE)
+    return 0;
+  tape->entries[close].type = BEJ_TAPE_END;
+  tape->entries[close].end = close + 1;
+
+  /* The entries may have moved while the members were appended */
+  tape->entries[index].value.count = count;
+  return 1;
+}
+
+/* Readers of one type, the cursor is at the length */
+
+static int bej_tape_set(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+
+  /* Members must not read past the end of the SET */
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+
+  uint32_t count = 0;
+  while (ctx->cursor < ctx->end)
+  {
+    uint16_t member_id;
+    uint8_t member_type;
+    if (!bej_read_tag(ctx, &member_id, &member_type) ||
+        !bej_tape_value(ctx, tape, member_id, member_type))
+      break;
+    count++;
+  }
+  ctx->end = outer_end;
+  if (ctx->error != BEJ_OK)
+    return 0;
+
+  return bej_tape_close(ctx, tape, index, count);
+}
+
+static int bej_tape_array(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  uint32_t length;
+  uint16_t count;
+  if (!bej_read_array_header(ctx, &length, &count))
+    return 0;
+
+  /* Elements keep their index tag as ID */
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    uint16_t element;
+    uint8_t type;
+    if (!bej_read_tag(ctx, &element, &type) ||
+        !bej_tape_value(ctx, tape, element, type))
+      break;
+  }
+  if (ctx->error == BEJ_OK && ctx->cursor != ctx->end)
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+  ctx->end = outer_end;
+  if (ctx->error != BEJ_OK)
+    return 0;
+
+  return bej_tape_close(ctx, tape, index, count);
+}
+
+static int bej_tape_null(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  (void)tape;
+  (void)index;
+  return bej_read_null(ctx);
+}
+
+static int bej_tape_integer(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  tape->entries[index].value.integer = bej_read_integer(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+static int bej_tape_enum(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  tape->entries[index].value.option = bej_read_enum(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+static int bej_tape_string_value(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+  tape->entries[index].value.string.offset = (uint32_t)(ctx->cursor - tape->data);
+  tape->entries[index].value.string.length = length;
+  ctx->cursor += length;
+  return 1;
+}
+
+static int bej_tape_real(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  tape->entries[index].value.real = bej_read_real(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+static int bej_tape_boolean(BejDecoder *ctx, BejTape *tape, uint32_t index)
+{
+  tape->entries[index].value.boolean = (uint8_t)bej_read_boolean(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+typedef int (*BejTapeReader)(BejDecoder *ctx, BejTape *tape, uint32_t index);
+
+/**
+ * @brief Readers indexed by BEJ type, as in the tree decoder
+ */
+static const BejTapeReader bej_tape_readers[] = {
+  [BEJ_SET] = bej_tape_set,
+  [BEJ_ARRAY] = bej_tape_array,
+  [BEJ_NULL] = bej_tape_null,
+  [BEJ_INTEGER] = bej_tape_integer,
+  [BEJ_ENUM] = bej_tape_enum,
+  [BEJ_STRING] = bej_tape_string_value,
+  [BEJ_REAL] = bej_tape_real,
+  [BEJ_BOOLEAN] = bej_tape_boolean,
+};
+
+/**
+ * @brief Appends one value whose tag has been read
+ *
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param tape Tape to append to
+ * @param id ID of the value, or its index in an ARRAY
+ * @param type BEJ type of the value
+ * @return 1 on success, 0 on error
+ */
+static int bej_tape_value(BejDecoder *ctx, BejTape *tape, uint16_t id, uint8_t type)
+{
+  if (type >= sizeof(bej_tape_readers) / sizeof(bej_tape_readers[0]))
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_TYPE);
+    return 0;
+  }
+
+  uint32_t index = bej_tape_push(ctx, tape);
+  if (index == BEJ_TAPE_NONE)
+    return 0;
+
+  tape->entries[index].type = type;
+  tape->entries[index].id = id;
+  ctx->stats.values++;
+
+  /* Nesting is capped as in the tree decoder */
+  int nested = type == BEJ_SET || type == BEJ_ARRAY;
+  if (nested && !bej_decoder_enter(ctx))
+    return 0;
+  int ok = bej_tape_readers[type](ctx, tape, index);
+  if (nested)
+    bej_decoder_leave(ctx);
+  if (!ok)
+    return 0;
+
+  tape->entries[index].end = tape->count;
+  return 1;
+}
+
+/**
+ * @brief Decodes one BEJ value into a tape
+ *
+ * Previous contents of the tape are replaced, its memory is reused.
+ * Strings are not copied, the input must outlive the tape contents.
+ *
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param tape Tape to fill, the root is entry 0
+ * @return BEJ_OK on success, BEJ_ERR_LENGTH if the input is larger than
+ *         UINT32_MAX bytes (string offsets are 32-bit), otherwise the
+ *         error stored in ctx->error
+ */
+BejError bej_tape_decode(BejDecoder *ctx, BejTape *tape)
+{
+  tape->count = 0;
+  tape->data = ctx->start;
+  if ((uint64_t)(ctx->end - ctx->start) > UINT32_MAX)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+    return ctx->error;
+  }
+
+  uint16_t id;
+  uint8_t type;
+  if (bej_read_tag(ctx, &id, &type))
+    bej_tape_value(ctx, tape, id, type);
+
+  return ctx->error;
+}
+
+/**
+ * @brief Returns the first member of a SET or element of an ARRAY
+ *
+ * @param tape Decoded tape
+ * @param index Index of a SET or ARRAY entry
+ * @return Index of the first child, BEJ_TAPE_NONE if there is none
+ */
+uint32_t bej_tape_first_child(const BejTape *tape, uint32_t index)
+{
+  uint8_t type = tape->entries[index].type;
+  if ((type != BEJ_SET && type != BEJ_ARRAY) || tape->entries[index].value.count == 0)
+    return BEJ_TAPE_NONE;
+  return index + 1;
+}
+
+/**
+ * @brief Returns the member or element following another one
+ *
+ * @param tape Decoded tape
+ * @param index Index of a SET member, an ARRAY element or the root
+ * @return Index of the next sibling, BEJ_TAPE_NONE after the last one
+ */
+uint32_t bej_tape_next_sibling(const BejTape *tape, uint32_t index)
+{
+  uint32_t next = tape->entries[index].end;
+  if (next >= tape->count || tape->entries[next].type == BEJ_TAPE_END)
+    return BEJ_TAPE_NONE;
+  return next;
+}
+
+/**
+ * @brief Finds a SET member by ID
+ *
+ * Nested SETs among the members are stepped over by their end index.
+ *
+ * @param tape Decoded tape
+ * @param index Index of a SET entry
+ * @param id ID of the member
+ * @return Index of the first member with that ID, BEJ_TAPE_NONE if there is none
+ */
+uint32_t bej_tape_find(const BejTape *tape, uint32_t index, uint16_t id)
+{
+  for (uint32_t i = bej_tape_first_child(tape, index); i != BEJ_TAPE_NONE;
+       i = bej_tape_next_sibling(tape, i))
+  {
+    if (tape->entries[i].id == id)
+      return i;
+  }
+  return BEJ_TAPE_NONE;
+}
+
+/**
+ * @brief Returns the bytes of a STRING entry
+ *
+ * @param tape Decoded tape
+ * @param index Index of a STRING entry
+ * @param length Pointer to store the length in bytes
+ * @return Pointer into the input, not null-terminated
+ */
+const char *bej_tape_string(const BejTape *tape, uint32_t index, uint32_t *length)
+{
+  const BejTapeEntry *entry = &tape->entries[index];
+  *length = entry->value.string.length;
+  return (const char *)tape->data + entry->value.string.offset;
+}
+
+/**
+ * @brief Writes one tape value
+ *
+ * @param tape Decoded tape
+ * @param index Index of the value
+ * @param dict Children of the value's entry, as for the tree emitter
+ * @param w Writer receiving the JSON text
+ */
+static void bej_tape_emit(const BejTape *tape, uint32_t index, BejDictionary *dict, JsonWriter *w)
+{
+  const BejTapeEntry *entry = &tape->entries[index];
+
+  switch (entry->type)
+  {
+    case BEJ_SET:
+    {
+      json_writer_begin_object(w);
+      for (uint32_t i = bej_tape_first_child(tape, index); i != BEJ_TAPE_NONE;
+           i = bej_tape_next_sibling(tape, i))
+      {
+        uint16_t id = tape->entries[i].id;
+        const char *name = bej_find_in_dictionary(dict, id, NULL);
+        if (!name) name = "UNKNOWN";
+        json_writer_key(w, name, strlen(name));
+        bej_tape_emit(tape, i, bej_dictionary_child(dict, id), w);
+      }
+      json_writer_end_object(w);
+      break;
+    }
+    case BEJ_ARRAY:
+    {
+      /* Elements are described by the single child entry of the array */
+      BejDictionary *element_dict = dict ? bej_dictionary_child(dict, dict->id) : NULL;
+
+      json_writer_begin_array(w);
+      for (uint32_t i = bej_tape_first_child(tape, index); i != BEJ_TAPE_NONE;
+           i = bej_tape_next_sibling(tape, i))
+      {
+        json_writer_element(w);
+        bej_tape_emit(tape, i, element_dict, w);
+      }
+      json_writer_end_array(w);
+      break;
+    }
+    case BEJ_NULL:
+      json_writer_null(w);
+      break;
+    case BEJ_INTEGER:
+      json_writer_integer(w, entry->value.integer);
+      break;
+    case BEJ_ENUM:
+    {
+      const char *name = bej_find_in_dictionary(dict, entry->value.option, NULL);
+      if (!name) name = "UNKNOWN";
+      json_writer_string(w, name, strlen(name));
+      break;
+    }
+    case BEJ_STRING:
+    {
+      uint32_t length;
+      const char *value = bej_tape_string(tape, index, &length);
+      json_writer_string(w, value, length);
+      break;
+    }
+    case BEJ_REAL:
+      json_writer_real(w, entry->value.real);
+      break;
+    case BEJ_BOOLEAN:
+      json_writer_boolean(w, entry->value.boolean);
+      break;
+  }
+}
+
+/**
+ * @brief Writes a tape value through a JSON writer
+ *
+ * Takes the same dictionary as bej_to_json_writer() and produces the
+ * same text as it does for the tree.
+ *
+ * @param tape Decoded tape
+ * @param index Index of the value to write, 0 for the whole document
+ * @param dict Children of the entry of the value (SET members, the ARRAY
+ *             element entry or ENUM options), main_dictionary or
+ *             bej_dictionary_child(root, 0) of a loaded schema at the top
+ * @param w Writer receiving the JSON text
+ */
+void bej_tape_to_json_writer(const BejTape *tape, uint32_t index, BejDictionary *dict, JsonWriter *w)
+{
+  bej_tape_emit(tape, index, dict, w);
+}
@@ -0,0 +1,191 @@
+/**
+ * @file bej_transcode.c
+ * @brief Single-pass BEJ to JSON transcoder
+ *
+ * Writes JSON text while the BEJ data is being walked, without building
+ * BejSet nodes. The output is identical to bej_to_json_val() (pretty)
+ * and bej_to_json_compact() (compact) for the same data.
+ */
+
+#include <string.h>
+#include "../include/bej_transcode.h"
+#include "../include/bej_sax.h"
+
+static BejSaxAction bej_json_start_set(void *user)
+{
+  json_writer_begin_object(user);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_end_set(void *user)
+{
+  json_writer_end_object(user);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_property(void *user, uint16_t id, const char *name, BejType type)
+{
+  (void)id;
+  (void)type;
+
+  if (!name) name = "UNKNOWN";
+  json_writer_key(user, name, strlen(name));
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_integer(void *user, int64_t value)
+{
+  json_writer_integer(user, value);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_string(void *user, const char *value, uint32_t length)
+{
+  json_writer_string(user, value, length);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_start_array(void *user, uint16_t count)
+{
+  (void)count;
+  json_writer_begin_array(user);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_end_array(void *user)
+{
+  json_writer_end_array(user);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_element(void *user, uint16_t index, BejType type)
+{
+  (void)index;
+  (void)type;
+  json_writer_element(user);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_null(void *user)
+{
+  json_writer_null(user);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_boolean(void *user, int value)
+{
+  json_writer_boolean(user, value);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_real(void *user, double value)
+{
+  json_writer_real(user, value);
+  return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction bej_json_enum(void *user, uint16_t option, const char *name)
+{
+  (void)option;
+  if (!name) name = "UNKNOWN";
+  json_writer_string(user, name, strlen(name));
+  return BEJ_SAX_CONTINUE;
+}
+
+static const BejSaxCallbacks bej_json_callbacks = {
+  bej_json_start_set,
+  bej_json_end_set,
+  bej_json_property,
+  bej_json_integer,
+  bej_json_string,
+  bej_json_start_array,
+  bej_json_end_array,
+  bej_json_element,
+  bej_json_null,
+  bej_json_boolean,
+  bej_json_real,
+  bej_json_enum
+};
+
+/**
+ * @brief Converts one BEJ value straight to JSON text
+ *
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param dict Dictionary for resolving field names
+ * @param w Writer receiving the JSON text, its style selects the layout
+ * @return BEJ_OK on success, otherwise the error stored in ctx->error
+ * @note On error the output ends where decoding stopped
+ */
+BejError bej_transcode_writer(BejDecoder *ctx, BejDictionary *dict, JsonWriter *w)
+{
+  return bej_sax_parse(ctx, dict, &bej_json_callbacks, w);
+}
+
+/**
+ * @brief Converts one BEJ value straight to JSON text on a stream
+ *
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @param dict Dictionary for resolving field names
+ * @param f File handle to write JSON output
+ * @param style BEJ_JSON_PRETTY or BEJ_JSON_COMPACT
+ * @return BEJ_OK on success, otherwise the error that stopped the conversion
+ */
+BejError bej_transcode_json(BejDecoder *ctx, BejDictionary *dict, FILE *f, int style)
+{
+  JsonWriter w;
+  if (json_writer_init_callback(&w, bej_json_fwrite, f, style) != 0)
+    return BEJ_ERR_NOMEM;
+
+  BejError error = bej_transcode_writer(ctx, dict, &w);
+  if (json_writer_flush(&w) != 0 && error == BEJ_OK)
+    error = BEJ_ERR_IO;
+  json_writer_free(&w);
+  return error;
+}
+
+/**
+ * @brief Converts a BEJ file to a JSON file in one pass
+ *
+ * The input is memory-mapped and its first value is written, followed by a
+ * newline, using main_dictionary for field names.
+ *
+ * @param bej_name Path of the BEJ input file
+ * @param json_name Path of the JSON output file
+ * @param style BEJ_JSON_PRETTY or BEJ_JSON_COMPACT
+ * @return BEJ_OK on success, otherwise the error that stopped the conversion
+ */
+BejError bej_transcode_file(const char *bej_name, const char *json_name, int style)
+{
+  BejMapping map;
+  BejError error = bej_map_file(bej_name, &map);
+  if (error != BEJ_OK)
+    return error;
+
+  FILE *f = fopen(json_name, "w");
+  if (!f)
+  {
+    bej_unmap_file(&map);
+    return BEJ_ERR_IO;
+  }
+
+  JsonWriter w;
+  if (json_writer_init_callback(&w, bej_json_fwrite, f, style) != 0)
+  {
+    fclose(f);
+    bej_unmap_file(&map);
+    return BEJ_ERR_NOMEM;
+  }
+
+  BejDecoder ctx;
+  bej_decoder_init(&ctx, map.data, map.size);
+  error = bej_transcode_writer(&ctx, main_dictionary, &w);
+  json_writer_raw(&w, "\n", 1);
+
+  if (json_writer_flush(&w) != 0 && error == BEJ_OK)
+    error = BEJ_ERR_IO;
+  json_writer_free(&w);
+  if (fclose(f) != 0 && error == BEJ_OK)
+    error = BEJ_ERR_IO;
+  bej_unmap_file(&map);
+  return error;
+}
@@ -0,0 +1,215 @@
+/**
+ * @file bej_validate.c
+ * @brief Up-front structural validation of encoded BEJ
+ *
+ * Walks a value once, front to back, without allocating or looking at
+ * the dictionary: every length prefix must fit inside the SET or ARRAY
+ * that holds it, SETs and ARRAYs must be filled exactly by their members
+ * and fixed-size payloads must have their size. The same primitive
+ * readers as the decoders are used, so a buffer is rejected with the
+ * error code and offset bej_read_value() would have stopped at.
+ *
+ * A decode of a validated value cannot run past the buffer, which lets
+ * it skip the bounds checks with BEJ_DECODE_TRUSTED. SETs and ARRAYs
+ * nested deeper than BEJ_DECODE_DEPTH are rejected, so neither pass can
+ * run out of stack.
+ */
+
+#include "../include/bej_validate.h"
+
+static int bej_validate_tagged(BejDecoder *ctx, uint8_t type);
+
+/*BEJ types up to BEJ_BOOLEAN*/
+#define BEJ_VALIDATOR_COUNT (BEJ_BOOLEAN + 1)
+
+/**
+ * @brief Validates the members of a SET
+ *
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return 1 on success, 0 on error (BEJ_ERR_LENGTH for more than
+ *         UINT16_MAX members, reported at the first member, or nesting
+ *         over BEJ_DECODE_DEPTH, reported at the length)
+ */
+static int bej_validate_set(BejDecoder *ctx)
+{
+  uint32_t length;
+  if (!bej_decoder_enter(ctx))
+    return 0;
+  if (!bej_read_length(ctx, &length))
+  {
+    bej_decoder_leave(ctx);
+    return 0;
+  }
+
+  const uint8_t *members = ctx->cursor;
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+
+  uint32_t count = 0;
+  while (ctx->cursor < ctx->end)
+  {
+    uint16_t id;
+    uint8_t type;
+    if (!bej_read_tag(ctx, &id, &type))
+      break;
+
+    /* The decoder counts the members by length first, a bad length wins
+       over a bad type or a SET or ARRAY nested too deep */
+    if (type >= BEJ_VALIDATOR_COUNT ||
+        ((type == BEJ_SET || type == BEJ_ARRAY) && ctx->depth == BEJ_DECODE_DEPTH))
+    {
+      const uint8_t *payload_length = ctx->cursor;
+      uint32_t skip;
+      if (!bej_read_length(ctx, &skip))
+        break;
+      ctx->cursor = payload_length;
+    }
+    if (!bej_validate_tagged(ctx, type))
+      break;
+    if (++count > UINT16_MAX)
+    {
+      ctx->cursor = members;
+      bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+      break;
+    }
+  }
+
+  ctx->end = outer_end;
+  bej_decoder_leave(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+/**
+ * @brief Validates the elements of an ARRAY
+ *
+ * @param ctx Decoder context, the cursor must be at the length
+ * @return 1 on success, 0 on error (BEJ_ERR_LENGTH if the elements do
+ *         not fill the payload or for nesting over BEJ_DECODE_DEPTH)
+ */
+static int bej_validate_array(BejDecoder *ctx)
+{
+  uint32_t length;
+  uint16_t count;
+  if (!bej_decoder_enter(ctx))
+    return 0;
+  if (!bej_read_array_header(ctx, &length, &count))
+  {
+    bej_decoder_leave(ctx);
+    return 0;
+  }
+
+  const uint8_t *outer_end = ctx->end;
+  ctx->end = ctx->cursor + length;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    uint16_t index;
+    uint8_t type;
+    if (!bej_read_tag(ctx, &index, &type) || !bej_validate_tagged(ctx, type))
+      break;
+  }
+  if (ctx->error == BEJ_OK && ctx->cursor != ctx->end)
+    bej_decoder_fail(ctx, BEJ_ERR_LENGTH);
+
+  ctx->end = outer_end;
+  bej_decoder_leave(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+/* Scalars are read and dropped, the readers check their payload sizes */
+
+static int bej_validate_null(BejDecoder *ctx)
+{
+  return bej_read_null(ctx);
+}
+
+static int bej_validate_integer(BejDecoder *ctx)
+{
+  bej_read_integer(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+static int bej_validate_enum(BejDecoder *ctx)
+{
+  bej_read_enum(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+static int bej_validate_string(BejDecoder *ctx)
+{
+  uint32_t length;
+  if (!bej_read_length(ctx, &length))
+    return 0;
+
+  ctx->cursor += length;
+  return 1;
+}
+
+static int bej_validate_real(BejDecoder *ctx)
+{
+  bej_read_real(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+static int bej_validate_boolean(BejDecoder *ctx)
+{
+  bej_read_boolean(ctx);
+  return ctx->error == BEJ_OK;
+}
+
+/*cursor at the length, 1 if the payload is well formed*/
+typedef int (*BejValidator)(BejDecoder *ctx);
+
+/**
+ * @brief Validators indexed by BEJ type
+ */
+static const BejValidator bej_validators[BEJ_VALIDATOR_COUNT] = {
+  [BEJ_SET] = bej_validate_set,
+  [BEJ_ARRAY] = bej_validate_array,
+  [BEJ_NULL] = bej_validate_null,
+  [BEJ_INTEGER] = bej_validate_integer,
+  [BEJ_ENUM] = bej_validate_enum,
+  [BEJ_STRING] = bej_validate_string,
+  [BEJ_REAL] = bej_validate_real,
+  [BEJ_BOOLEAN] = bej_validate_boolean,
+};
+
+/**
+ * @brief Validates a value whose tag has been read
+ *
+ * @param ctx Decoder context, the cursor must be at the length
+ * @param type BEJ type of the value
+ * @return 1 on success, 0 on error (BEJ_ERR_TYPE for an unknown type)
+ */
+static int bej_validate_tagged(BejDecoder *ctx, uint8_t type)
+{
+  if (type >= BEJ_VALIDATOR_COUNT)
+  {
+    bej_decoder_fail(ctx, BEJ_ERR_TYPE);
+    return 0;
+  }
+  return bej_validators[type](ctx);
+}
+
+/**
+ * @brief Checks that a value is well formed before it is decoded
+ *
+ * On success the cursor is past the value, as after bej_read_value().
+ * To decode it without bounds checks, rewind the cursor (or initialize a
+ * new context over the same bytes) and set BEJ_DECODE_TRUSTED in
+ * ctx->flags.
+ *
+ * @param ctx Decoder context, the cursor must be at the value ID
+ * @return BEJ_OK, or the error bej_read_value() reports for the value,
+ *         with its offset in ctx->error_offset
+ * @note A SET with more than UINT16_MAX members fails once they have
+ *       been walked, while the decoder counts them before decoding any:
+ *       an error inside one of the first members is reported first here
+ */
+BejError bej_validate(BejDecoder *ctx)
+{
+  uint16_t id;
+  uint8_t type;
+  if (bej_read_tag(ctx, &id, &type))
+    bej_validate_tagged(ctx, type);
+  return ctx->error;
+}
@@ -8,38 +8,228 @@
 
 #include "../include/dictionary.h"
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 /**
  * @brief Main dictionary for root-level BEJ fields
  * 
  * Maps field IDs to their names and types for the root structure.
- * Terminated with {255, NULL, 0} sentinel.
+ * The root entry lists this dictionary as its own children, so decoding
+ * starts here and descends through the children pointers.
+ * Terminated with {255, NULL, 0, NULL, NULL} sentinel.
  */
 BejDictionary main_dictionary[] = {
-  {0, "root", BEJ_SET},
-  {1, "CapacityMiB", BEJ_INTEGER},
-  {2, "DataWidthBits", BEJ_INTEGER},
-  {3, "ErrorCorrection", BEJ_STRING},
-  {4, "MemoryLocation", BEJ_SET},
-  {255, NULL, 0}
+  {0, "root", BEJ_SET, main_dictionary, NULL},
+  {1, "CapacityMiB", BEJ_INTEGER, NULL, NULL},
+  {2, "DataWidthBits", BEJ_INTEGER, NULL, NULL},
+  {3, "ErrorCorrection", BEJ_STRING, NULL, NULL},
+  {4, "MemoryLocation", BEJ_SET, child_dictionary, NULL},
+  {255, NULL, 0, NULL, NULL}
 };
 
 /**
  * @brief Child dictionary for nested MemoryLocation fields
  * 
  * Maps field IDs to their names and types for the MemoryLocation structure.
- * Terminated with {255, NULL, 0} sentinel.
+ * Terminated with {255, NULL, 0, NULL, NULL} sentinel.
  */
 BejDictionary child_dictionary[] = {
-  {1, "Channel", BEJ_INTEGER},
-  {2, "Slot", BEJ_INTEGER},
-  {255, NULL, 0}
+  {1, "Channel", BEJ_INTEGER, NULL, NULL},
+  {2, "Slot", BEJ_INTEGER, NULL, NULL},
+  {255, NULL, 0, NULL, NULL}
 };
 
+/**
+ * @brief Dictionary without entries, children of SETs that have none
+ */
+static BejDictionary empty_dictionary[] = {
+  {255, NULL, 0, NULL, NULL}
+};
+
+/**
+ * @brief Hashes a field name (FNV-1a)
+ * 
+ * @param name Field name, not necessarily null-terminated
+ * @param length Length of the name in bytes
+ * @return 32-bit hash of the name
+ */
+static uint32_t bej_name_hash(const char *name, size_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++)
+  {
+    hash ^= (uint8_t)name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Compares a dictionary name with a name of known length
+ * 
+ * @param entry_name Null-terminated dictionary name
+ * @param name Name to compare, not necessarily null-terminated
+ * @param length Length of @p name in bytes
+ * @return 1 if the names are equal, 0 otherwise
+ */
+static int bej_name_equal(const char *entry_name, const char *name, size_t length)
+{
+  return strncmp(entry_name, name, length) == 0 && entry_name[length] == '\0';
+}
+
+/**
+ * @brief Builds constant-time lookup tables for a dictionary
+ * 
+ * Creates a table indexed by sequence number for ID lookups and a hash
+ * table for name lookups, and attaches them to the first entry. From then
+ * on bej_find_in_dictionary() and bej_find_id_in_dictionary() no longer
+ * scan the dictionary. As with the scan, the first entry wins when an ID
+ * or a name appears more than once.
+ * 
+ * @param dict Dictionary terminated by an entry with a NULL name
+ * @return 0 on success, -1 if memory could not be allocated
+ * @note Compile before the dictionary is shared between threads, the
+ *       tables are only read afterwards
+ */
+int bej_dictionary_compile(BejDictionary *dict)
+{
+  if (dict[0].index)
+    return 0;
+
+  uint32_t count = 0;
+  uint32_t max_id = 0;
+  for (; dict[count].name != NULL; count++)
+  {
+    if (dict[count].id > max_id) max_id = dict[count].id;
+  }
+
+  uint32_t slots = 1;
+  while (slots < count * 2) slots <<= 1;
+
+  size_t size = sizeof(BejDictIndex) +
+                sizeof(BejDictionary *) * ((size_t)max_id + 1 + slots);
+  BejDictIndex *index = calloc(1, size);
+  if (!index)
+    return -1;
+
+  index->by_id = (const BejDictionary **)(index + 1);
+  index->id_count = max_id + 1;
+  index->by_name = index->by_id + index->id_count;
+  index->name_mask = slots - 1;
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const BejDictionary *entry = &dict[i];
+    if (!index->by_id[entry->id])
+      index->by_id[entry->id] = entry;
+
+    size_t length = strlen(entry->name);
+    uint32_t slot = bej_name_hash(entry->name, length) & index->name_mask;
+    while (index->by_name[slot] && !bej_name_equal(index->by_name[slot]->name, entry->name, length))
+      slot = (slot + 1) & index->name_mask;
+    if (!index->by_name[slot])
+      index->by_name[slot] = entry;
+  }
+
+  dict[0].index = index;
+  return 0;
+}
+
+/**
+ * @brief Frees the lookup tables built by bej_dictionary_compile()
+ * 
+ * The dictionary falls back to scanning afterwards.
+ * 
+ * @param dict Dictionary to release
+ */
+void bej_dictionary_release(BejDictionary *dict)
+{
+  free((void *)dict[0].index);
+  dict[0].index = NULL;
+}
+
+/**
+ * @brief Compiles the built-in dictionaries
+ * 
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int bej_dictionary_init(void)
+{
+  if (bej_dictionary_compile(main_dictionary) != 0)
+    return -1;
+  return bej_dictionary_compile(child_dictionary);
+}
+
+/**
+ * @brief Finds a dictionary entry by ID
+ * 
+ * Compiled dictionaries are looked up in constant time, others are scanned.
+ * 
+ * @param dict Dictionary to search in
+ * @param id Field ID to look up
+ * @return Entry with that ID, or NULL if there is none
+ */
+static const BejDictionary *bej_dictionary_entry(const BejDictionary *dict, uint16_t id)
+{
+  const BejDictIndex *index = dict[0].index;
+  if (index)
+    return id < index->id_count ? index->by_id[id] : NULL;
+
+  for (int i = 0; dict[i].name != NULL; i++)
+  {
+    if (dict[i].id == id)
+      return &dict[i];
+  }
+  return NULL;
+}
+
+/**
+ * @brief Finds a field name in the dictionary by ID
+ * 
+ * Searches the dictionary for a field with the given ID and optionally
+ * returns its type. Compiled dictionaries are looked up in constant time,
+ * others are scanned.
+ * 
+ * @param dict Dictionary to search in
+ * @param id Field ID to look up
+ * @param type Optional pointer to store the field type (can be NULL)
+ * @return Field name if found, NULL otherwise
+ */
+const char *bej_find_in_dictionary(BejDictionary *dict, uint16_t id, BejType *type)
+{
+  const BejDictionary *entry = bej_dictionary_entry(dict, id);
+  if (!entry)
+    return NULL;
+  if (type) {*type = entry->type;}
+  return entry->name;
+}
+
+/**
+ * @brief Gets the dictionary of a SET's members
+ * 
+ * Follows the children pointer of the SET's entry, so descending into a
+ * nested SET costs one lookup whatever the schema. The children of an
+ * ARRAY entry start with the entry of its elements, those of an ENUM
+ * entry are its options.
+ * 
+ * @param dict Dictionary the SET itself was found in
+ * @param id ID of the SET
+ * @return Dictionary of the members, an empty dictionary if the entry is
+ *         unknown or has no children
+ */
+BejDictionary *bej_dictionary_child(BejDictionary *dict, uint16_t id)
+{
+  const BejDictionary *entry = bej_dictionary_entry(dict, id);
+  if (!entry || !entry->children)
+    return empty_dictionary;
+  return entry->children;
+}
+
 /**
  * @brief Gets the appropriate child dictionary for a given parent ID
  * 
- * Returns the child dictionary for nested structures based on parent field ID.
+ * Returns the children of the parent field in main_dictionary.
  * Falls back to main_dictionary if no specific child dictionary exists.
  * 
  * @param parent_id ID of the parent field
@@ -47,32 +237,56 @@ BejDictionary child_dictionary[] = {
  */
 BejDictionary *bej_get_child_dictionary(uint8_t parent_id)
 {
-  if (parent_id == 4)
-    return child_dictionary;
+  BejDictionary *child = bej_dictionary_child(main_dictionary, parent_id);
+  if (child == empty_dictionary)
+    return main_dictionary;
   
-  return main_dictionary;
+  return child;
 }
 
 /**
- * @brief Finds a field name in the dictionary by ID
+ * @brief Finds a field ID in the dictionary by name
  * 
- * Searches the dictionary for a field with the given ID and optionally
- * returns its type.
+ * Reverse of bej_find_in_dictionary(), used when encoding. Compiled
+ * dictionaries are looked up through the name hash, others are scanned.
  * 
  * @param dict Dictionary to search in
- * @param id Field ID to look up
+ * @param name Field name, not necessarily null-terminated
+ * @param length Length of the name in bytes
  * @param type Optional pointer to store the field type (can be NULL)
- * @return Field name if found, NULL otherwise
+ * @return Field ID if found, -1 otherwise
  */
-const char *bej_find_in_dictionary(BejDictionary *dict, uint8_t id, BejType *type)
+int32_t bej_find_id_in_dictionary(BejDictionary *dict, const char *name, size_t length, BejType *type)
 {
-  for (int i = 0; dict[i].name != NULL; i++)
+  const BejDictionary *entry = NULL;
+  const BejDictIndex *index = dict[0].index;
+  if (index)
   {
-    if (dict[i].id == id)
+    uint32_t slot = bej_name_hash(name, length) & index->name_mask;
+    while (index->by_name[slot])
     {
-      if (type) {*type = dict[i].type;}
-      return dict[i].name;
+      if (bej_name_equal(index->by_name[slot]->name, name, length))
+      {
+        entry = index->by_name[slot];
+        break;
+      }
+      slot = (slot + 1) & index->name_mask;
     }
   }
-  return NULL; 
+  else
+  {
+    for (int i = 0; dict[i].name != NULL; i++)
+    {
+      if (bej_name_equal(dict[i].name, name, length))
+      {
+        entry = &dict[i];
+        break;
+      }
+    }
+  }
+
+  if (!entry)
+    return -1;
+  if (type) {*type = entry->type;}
+  return entry->id;
 }
@@ -0,0 +1,330 @@
+/**
+ * @file dictionary_loader.c
+ * @brief DSP0218 binary dictionary loader
+ *
+ * Turns the binary dictionaries shipped by devices into BejDictionary
+ * tables. The binary is mapped, not copied: entry names point into it.
+ * Every child subset becomes its own sentinel-terminated, compiled table
+ * and each SET entry points to it, so decoders descend into nested SETs
+ * with one lookup and no per-schema code. A cache keyed by schema name
+ * and version lets many payloads share one loaded dictionary.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/dictionary_loader.h"
+
+/**
+ * @brief Reads a little-endian 16-bit field
+ */
+static uint16_t bej_dict_u16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief Reads a little-endian 32-bit field
+ */
+static uint32_t bej_dict_u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Fills one BejDictionary entry from a binary entry
+ *
+ * Entry layout: Format (type in bits 7:4), SequenceNumber,
+ * ChildPointerOffset, ChildCount, NameLength (with the terminator),
+ * NameOffset.
+ *
+ * @param data Dictionary binary
+ * @param size Size of the binary in bytes
+ * @param index Index of the binary entry
+ * @param slots Subset placement per entry index, see bej_dictionary_parse()
+ * @param entries Table of all subsets
+ * @param out Entry to fill
+ * @return BEJ_OK, or BEJ_ERR_TRUNCATED if the name lies outside the binary
+ */
+static BejError bej_dict_entry(const uint8_t *data, size_t size, uint32_t index,
+                               const uint32_t *slots, BejDictionary *entries, BejDictionary *out)
+{
+  const uint8_t *e = data + BEJ_DICT_HEADER_SIZE + (size_t)index * BEJ_DICT_ENTRY_SIZE;
+  uint16_t child_offset = bej_dict_u16(e + 3);
+  uint16_t child_count = bej_dict_u16(e + 5);
+  uint8_t name_length = e[7];
+  uint16_t name_offset = bej_dict_u16(e + 8);
+
+  out->id = bej_dict_u16(e + 1);
+  out->type = (BejType)(e[0] >> 4);
+  out->children = NULL;
+  out->index = NULL;
+
+  /* Array elements are anonymous, an empty name keeps the sentinel unique */
+  out->name = "";
+  if (name_length > 0)
+  {
+    if ((size_t)name_offset + name_length > size || data[name_offset + name_length - 1] != '\0')
+      return BEJ_ERR_TRUNCATED;
+    out->name = (const char *)data + name_offset;
+  }
+
+  if (child_count > 0)
+  {
+    uint32_t start = (uint32_t)(child_offset - BEJ_DICT_HEADER_SIZE) / BEJ_DICT_ENTRY_SIZE;
+    out->children = &entries[slots[start * 2] - 1];
+  }
+  return BEJ_OK;
+}
+
+/**
+ * @brief Builds the tables of a dictionary held in memory
+ *
+ * Entry 0 is the schema entry. Each distinct child subset is copied into
+ * a table followed by a sentinel, entries that share a subset share the
+ * table. All tables are compiled.
+ *
+ * @param data DSP0218 dictionary binary, must outlive @p dict
+ * @param size Size of the binary in bytes
+ * @param dict Dictionary to fill, dict->root feeds the decoders
+ * @return BEJ_OK, BEJ_ERR_TRUNCATED if an entry, name or child subset lies
+ *         outside the binary, BEJ_ERR_SCHEMA if the layout is invalid,
+ *         BEJ_ERR_NOMEM
+ * @note Release with bej_dictionary_unload()
+ */
+BejError bej_dictionary_parse(const uint8_t *data, size_t size, BejSchemaDictionary *dict)
+{
+  memset(dict, 0, sizeof(*dict));
+
+  if (size < BEJ_DICT_HEADER_SIZE)
+    return BEJ_ERR_TRUNCATED;
+
+  uint32_t count = bej_dict_u16(data + 2);
+  if (count == 0)
+    return BEJ_ERR_SCHEMA;
+  if (BEJ_DICT_HEADER_SIZE + (size_t)count * BEJ_DICT_ENTRY_SIZE > size)
+    return BEJ_ERR_TRUNCATED;
+
+  /* Per first entry of a subset: 1 + its table position, and its length */
+  uint32_t *slots = calloc((size_t)count * 2, sizeof(uint32_t));
+  if (!slots)
+    return BEJ_ERR_NOMEM;
+
+  /* The schema entry gets a table of its own at position 0 */
+  uint32_t slot_count = 2;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const uint8_t *e = data + BEJ_DICT_HEADER_SIZE + (size_t)i * BEJ_DICT_ENTRY_SIZE;
+    uint16_t child_offset = bej_dict_u16(e + 3);
+    uint16_t child_count = bej_dict_u16(e + 5);
+    if (child_count == 0)
+      continue;
+
+    if (child_offset < BEJ_DICT_HEADER_SIZE ||
+        (child_offset - BEJ_DICT_HEADER_SIZE) % BEJ_DICT_ENTRY_SIZE != 0)
+    {
+      free(slots);
+      return BEJ_ERR_SCHEMA;
+    }
+    uint32_t start = (uint32_t)(child_offset - BEJ_DICT_HEADER_SIZE) / BEJ_DICT_ENTRY_SIZE;
+    if (start + child_count > count)
+    {
+      free(slots);
+      return BEJ_ERR_TRUNCATED;
+    }
+
+    if (slots[start * 2] == 0)
+    {
+      slots[start * 2] = slot_count + 1;
+      slots[start * 2 + 1] = child_count;
+      slot_count += child_count + 1u;
+    }
+    else if (slots[start * 2 + 1] != child_count)
+    {
+      free(slots);
+      return BEJ_ERR_SCHEMA;
+    }
+  }
+
+  BejDictionary *entries = calloc(slot_count, sizeof(BejDictionary));
+  if (!entries)
+  {
+    free(slots);
+    return BEJ_ERR_NOMEM;
+  }
+  dict->entries = entries;
+  dict->slot_count = slot_count;
+  dict->root = entries;
+
+  /* calloc left every sentinel with a NULL name */
+  BejError error = bej_dict_entry(data, size, 0, slots, entries, &entries[0]);
+  for (uint32_t i = 0; i < count && error == BEJ_OK; i++)
+  {
+    if (slots[i * 2] == 0)
+      continue;
+    BejDictionary *table = &entries[slots[i * 2] - 1];
+    for (uint32_t k = 0; k < slots[i * 2 + 1] && error == BEJ_OK; k++)
+      error = bej_dict_entry(data, size, i + k, slots, entries, &table[k]);
+  }
+  free(slots);
+
+  for (uint32_t p = 0; p < slot_count && error == BEJ_OK; p++)
+  {
+    if (p == 0 || entries[p - 1].name == NULL)
+    {
+      if (bej_dictionary_compile(&entries[p]) != 0)
+        error = BEJ_ERR_NOMEM;
+    }
+  }
+
+  if (error != BEJ_OK)
+  {
+    bej_dictionary_unload(dict);
+    return error;
+  }
+
+  dict->schema = entries[0].name;
+  dict->version = bej_dict_u32(data + 4);
+  return BEJ_OK;
+}
+
+/**
+ * @brief Maps a DSP0218 dictionary file and builds its tables
+ *
+ * @param file_name Path to the dictionary binary
+ * @param dict Dictionary to fill, it owns the mapping
+ * @return BEJ_OK, BEJ_ERR_IO if the file cannot be mapped, otherwise as
+ *         bej_dictionary_parse()
+ * @note Release with bej_dictionary_unload()
+ */
+BejError bej_dictionary_load(const char *file_name, BejSchemaDictionary *dict)
+{
+  BejMapping map;
+  BejError error = bej_map_file(file_name, &map);
+  if (error != BEJ_OK)
+  {
+    memset(dict, 0, sizeof(*dict));
+    return error;
+  }
+
+  error = bej_dictionary_parse(map.data, map.size, dict);
+  if (error != BEJ_OK)
+  {
+    bej_unmap_file(&map);
+    return error;
+  }
+
+  dict->mapping = map;
+  return BEJ_OK;
+}
+
+/**
+ * @brief Releases the tables and the mapping of a dictionary
+ *
+ * Safe to call on a dictionary that failed to load.
+ *
+ * @param dict Dictionary to release
+ */
+void bej_dictionary_unload(BejSchemaDictionary *dict)
+{
+  for (uint32_t p = 0; p < dict->slot_count; p++)
+  {
+    if (p == 0 || dict->entries[p - 1].name == NULL)
+      bej_dictionary_release(&dict->entries[p]);
+  }
+  free(dict->entries);
+  bej_unmap_file(&dict->mapping);
+
+  dict->entries = NULL;
+  dict->root = NULL;
+  dict->slot_count = 0;
+  dict->schema = NULL;
+}
+
+/**
+ * @brief Initializes an empty dictionary cache
+ *
+ * @param cache Cache to initialize
+ */
+void bej_dict_cache_init(BejDictCache *cache)
+{
+  cache->head = NULL;
+}
+
+/**
+ * @brief Finds a loaded dictionary
+ *
+ * @param cache Cache to search
+ * @param schema Schema name, the name of the schema entry
+ * @param version SchemaVersion of the dictionary
+ * @return Dictionary, or NULL if it has not been loaded
+ */
+BejSchemaDictionary *bej_dict_cache_find(BejDictCache *cache, const char *schema, uint32_t version)
+{
+  for (BejSchemaDictionary *dict = cache->head; dict; dict = dict->next)
+  {
+    if (dict->version == version && strcmp(dict->schema, schema) == 0)
+      return dict;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Returns a cached dictionary, loading it on first use
+ *
+ * The file is only read when the schema and version are not cached yet,
+ * and it has to contain that schema and version.
+ *
+ * @param cache Cache to search and fill
+ * @param schema Schema name, the name of the schema entry
+ * @param version SchemaVersion of the dictionary
+ * @param file_name Dictionary binary to load on a miss
+ * @param dict Pointer to store the dictionary, owned by the cache
+ * @return BEJ_OK, BEJ_ERR_SCHEMA if the file holds another schema or
+ *         version, otherwise as bej_dictionary_load()
+ */
+BejError bej_dict_cache_load(BejDictCache *cache, const char *schema, uint32_t version,
+                             const char *file_name, BejSchemaDictionary **dict)
+{
+  *dict = bej_dict_cache_find(cache, schema, version);
+  if (*dict)
+    return BEJ_OK;
+
+  BejSchemaDictionary *loaded = malloc(sizeof(BejSchemaDictionary));
+  if (!loaded)
+    return BEJ_ERR_NOMEM;
+
+  BejError error = bej_dictionary_load(file_name, loaded);
+  if (error == BEJ_OK && (loaded->version != version || strcmp(loaded->schema, schema) != 0))
+  {
+    bej_dictionary_unload(loaded);
+    error = BEJ_ERR_SCHEMA;
+  }
+  if (error != BEJ_OK)
+  {
+    free(loaded);
+    return error;
+  }
+
+  loaded->next = cache->head;
+  cache->head = loaded;
+  *dict = loaded;
+  return BEJ_OK;
+}
+
+/**
+ * @brief Unloads every cached dictionary
+ *
+ * @param cache Cache to destroy, it can be used again afterwards
+ */
+void bej_dict_cache_destroy(BejDictCache *cache)
+{
+  BejSchemaDictionary *dict = cache->head;
+  while (dict)
+  {
+    BejSchemaDictionary *next = dict->next;
+    bej_dictionary_unload(dict);
+    free(dict);
+    dict = next;
+  }
+  cache->head = NULL;
+}
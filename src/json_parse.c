@@ -1,9 +1,10 @@
 /* * * * * * * * * * * * * * * * * * * * * * * *
  * This file contains functions that 
  * can be used to parse a JSON file into 
- * a C structure. In the future, functionality 
- * will be added to parse data directly from 
- * JSON to BEJ.
+ * a C structure. The trees are encoded 
+ * to BEJ by bej_encode_tree(), and 
+ * bej_encode_json() encodes JSON text 
+ * directly.
  * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdio.h>
@@ -12,7 +13,8 @@
 #include <ctype.h>
 
 #include "../include/json_parse.h"
-#define PAIR_BUFFER 20
+#include "../include/json_scan.h"
+#define PAIR_BUFFER 4 /*initial pairs per object, doubled as needed*/
 
 
 char* json_load_file(const char *file_name)
@@ -41,34 +43,48 @@ char* json_load_file(const char *file_name)
 
 void json_skip_spaces(const char** text) 
 {
-    while (**text == ' ' || **text == '\n' || **text == '\t')(*text)++;
+    *text = json_scan_spaces(*text);
 }
 
 
 char *json_read_string(const char **text)
 {
   if(**text != '"')return NULL;
-  (*text)++;
 
-  const char *start = *text;
-  while (**text != '"' && **text != '\0') (*text)++;
-  
-  if (**text != '"') return NULL; 
-  
-  int32_t length = *text - start;
+  int escaped;
+  const char *start = *text + 1;
+  const char *end = json_scan_string(start, &escaped);
+  if (!end) return NULL;
+
+  size_t length = end - start;
   char* result = (char*)malloc(length + 1);
-  strncpy(result, start, length);
+  if (!result) return NULL;
+
+  if (escaped)
+  {
+    /* Decoded text is never longer than the escaped one */
+    length = json_unescape(result, start, length);
+    if (length == JSON_UNESCAPE_ERROR)
+    {
+      free(result);
+      return NULL;
+    }
+  }
+  else
+  {
+    memcpy(result, start, length);
+  }
   result[length] = '\0';
 
-  (*text)++; /*skip '"'*/
+  *text = end + 1; /*skip '"'*/
   
   return result;
 }
 
-int32_t json_read_integer(const char** text) 
+int64_t json_read_integer(const char** text) 
 {
     char* end;
-    int32_t num =(int32_t) strtol(*text, &end, 10);
+    int64_t num = (int64_t)strtoll(*text, &end, 10);
     if(end == *text) return 0; /*parsing error*/
     *text = end;
     return num;
@@ -85,16 +101,18 @@ BejSet* json_read_value(const char **text)
     if (**text == '"')
     {
         val->type = BEJ_STRING;
-        val->string_value = json_read_string(text);
+        val->string_value.data = json_read_string(text);
         
-        if(!val->string_value)
+        if(!val->string_value.data)
         {
           free(val);
           return NULL;
         }
+        val->string_value.length = strlen(val->string_value.data);
+        val->string_value.borrowed = 0;
 
     } 
-    else if (isdigit(**text)) 
+    else if (isdigit(**text) || **text == '-') 
     {
         val->type = BEJ_INTEGER;
         val->integer_value = json_read_integer(text);
@@ -122,8 +140,8 @@ BejSet* json_read_object(const char **text)
     obj->type = BEJ_SET;
     obj->object_value.count = 0;
     
-
-    obj->object_value.pairs = malloc(sizeof(JsonPair) * PAIR_BUFFER);
+    uint32_t capacity = PAIR_BUFFER;
+    obj->object_value.pairs = malloc(sizeof(JsonPair) * capacity);
     if (!obj->object_value.pairs) 
     {
         free(obj);
@@ -161,6 +179,24 @@ BejSet* json_read_object(const char **text)
             return NULL;
         }
 
+        if (obj->object_value.count == capacity)
+        {
+            JsonPair *pairs = NULL;
+            if (capacity < UINT16_MAX)
+            {
+                capacity = capacity * 2 > UINT16_MAX ? UINT16_MAX : capacity * 2;
+                pairs = realloc(obj->object_value.pairs, sizeof(JsonPair) * capacity);
+            }
+            if (!pairs)
+            {
+                free(key);
+                json_free(value);
+                json_free(obj);
+                return NULL;
+            }
+            obj->object_value.pairs = pairs;
+        }
+
         obj->object_value.pairs[obj->object_value.count].key = key;
         obj->object_value.pairs[obj->object_value.count].value = value;
         obj->object_value.count++;
@@ -174,6 +210,13 @@ BejSet* json_read_object(const char **text)
     }
 
     if (**text == '}') (*text)++;
+
+    /* Keep exactly as many pairs as were read */
+    if (obj->object_value.count < capacity && obj->object_value.count > 0)
+    {
+        JsonPair *pairs = realloc(obj->object_value.pairs, sizeof(JsonPair) * obj->object_value.count);
+        if (pairs) obj->object_value.pairs = pairs;
+    }
     return obj;
 }
 
@@ -194,7 +237,7 @@ void json_free(BejSet *obj)
     } 
     else if (obj->type == BEJ_STRING) 
     {
-        free(obj->string_value);
+        free(obj->string_value.data);
     }
 
     free(obj);
@@ -0,0 +1,419 @@
+/**
+ * @file json_scan.c
+ * @brief Vectorized JSON character scanning
+ *
+ * Finds the end of whitespace and of plain string runs 16 (SSE2) or 32
+ * (AVX2) bytes at a time, with a scalar fallback. The kernel is picked
+ * at runtime from the CPU features on first use, once for all threads;
+ * the kernel pointers are only read and written atomically.
+ *
+ * The vector kernels only load aligned blocks. A block never crosses a
+ * page boundary, so reading past the null terminator inside the last
+ * block cannot fault; bytes outside the string are masked off.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include "../include/json_scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/* The vector loads read whole aligned blocks, past the end of the string */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define JSON_SCAN_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+#if !defined(JSON_SCAN_NO_ASAN) && defined(__SANITIZE_ADDRESS__)
+#define JSON_SCAN_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#ifndef JSON_SCAN_NO_ASAN
+#define JSON_SCAN_NO_ASAN
+#endif
+
+/* Kernel pointers are shared by every thread */
+#if defined(__GNUC__)
+#define JSON_SCAN_LOAD(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#define JSON_SCAN_STORE(var, value) __atomic_store_n(&(var), (value), __ATOMIC_RELAXED)
+#else
+#define JSON_SCAN_LOAD(var) (var)
+#define JSON_SCAN_STORE(var, value) ((var) = (value))
+#endif
+
+typedef const char *(*JsonScanFn)(const char *p);
+
+/**
+ * @brief Skips whitespace one byte at a time
+ */
+static const char *json_spaces_scalar(const char *p)
+{
+  while (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r') p++;
+  return p;
+}
+
+/**
+ * @brief Finds the first quote, backslash or terminator one byte at a time
+ */
+static const char *json_run_scalar(const char *p)
+{
+  while (*p != '"' && *p != '\\' && *p != '\0') p++;
+  return p;
+}
+
+#ifdef JSON_SCAN_X86
+
+/**
+ * @brief Skips whitespace 16 bytes at a time
+ */
+__attribute__((target("sse2"))) JSON_SCAN_NO_ASAN
+static const char *json_spaces_sse2(const char *p)
+{
+  unsigned offset = (unsigned)((uintptr_t)p & 15);
+  const char *block = p - offset;
+  /* Bytes before p count as whitespace */
+  unsigned skip = (1u << offset) - 1;
+
+  for (;;)
+  {
+    __m128i v = _mm_load_si128((const __m128i *)block);
+    __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                           _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                              _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+                                           _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    unsigned other = ~((unsigned)_mm_movemask_epi8(ws) | skip) & 0xFFFF;
+    if (other)
+      return block + __builtin_ctz(other);
+    block += 16;
+    skip = 0;
+  }
+}
+
+/**
+ * @brief Finds the first quote, backslash or terminator 16 bytes at a time
+ */
+__attribute__((target("sse2"))) JSON_SCAN_NO_ASAN
+static const char *json_run_sse2(const char *p)
+{
+  unsigned offset = (unsigned)((uintptr_t)p & 15);
+  const char *block = p - offset;
+  unsigned keep = ~((1u << offset) - 1);
+
+  for (;;)
+  {
+    __m128i v = _mm_load_si128((const __m128i *)block);
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                            _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                               _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    unsigned mask = (unsigned)_mm_movemask_epi8(hit) & keep;
+    if (mask)
+      return block + __builtin_ctz(mask);
+    block += 16;
+    keep = ~0u;
+  }
+}
+
+/**
+ * @brief Skips whitespace 32 bytes at a time
+ */
+__attribute__((target("avx2"))) JSON_SCAN_NO_ASAN
+static const char *json_spaces_avx2(const char *p)
+{
+  unsigned offset = (unsigned)((uintptr_t)p & 31);
+  const char *block = p - offset;
+  uint32_t skip = offset ? (1u << offset) - 1 : 0;
+
+  for (;;)
+  {
+    __m256i v = _mm256_load_si256((const __m256i *)block);
+    __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+                                 _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')),
+                                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+    uint32_t other = ~((uint32_t)_mm256_movemask_epi8(ws) | skip);
+    if (other)
+      return block + __builtin_ctz(other);
+    block += 32;
+    skip = 0;
+  }
+}
+
+/**
+ * @brief Finds the first quote, backslash or terminator 32 bytes at a time
+ */
+__attribute__((target("avx2"))) JSON_SCAN_NO_ASAN
+static const char *json_run_avx2(const char *p)
+{
+  unsigned offset = (unsigned)((uintptr_t)p & 31);
+  const char *block = p - offset;
+  uint32_t keep = ~(offset ? (1u << offset) - 1 : 0u);
+
+  for (;;)
+  {
+    __m256i v = _mm256_load_si256((const __m256i *)block);
+    __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                                  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+                                  _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit) & keep;
+    if (mask)
+      return block + __builtin_ctz(mask);
+    block += 32;
+    keep = ~0u;
+  }
+}
+
+#endif
+
+static const char *json_spaces_resolve(const char *p);
+static const char *json_run_resolve(const char *p);
+
+static JsonScanFn json_spaces_fn = json_spaces_resolve;
+static JsonScanFn json_run_fn = json_run_resolve;
+static JsonScanImpl json_impl = JSON_SCAN_SCALAR;
+static pthread_once_t json_scan_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Installs a kernel
+ *
+ * @param impl Kernel to use
+ * @return 0 on success, -1 if the CPU or the build does not support it
+ */
+static int json_scan_set(JsonScanImpl impl)
+{
+  JsonScanFn spaces;
+  JsonScanFn run;
+  if (impl == JSON_SCAN_SCALAR)
+  {
+    spaces = json_spaces_scalar;
+    run = json_run_scalar;
+  }
+#ifdef JSON_SCAN_X86
+  else if (impl == JSON_SCAN_SSE2 && __builtin_cpu_supports("sse2"))
+  {
+    spaces = json_spaces_sse2;
+    run = json_run_sse2;
+  }
+  else if (impl == JSON_SCAN_AVX2 && __builtin_cpu_supports("avx2"))
+  {
+    spaces = json_spaces_avx2;
+    run = json_run_avx2;
+  }
+#endif
+  else
+  {
+    return -1;
+  }
+
+  JSON_SCAN_STORE(json_spaces_fn, spaces);
+  JSON_SCAN_STORE(json_run_fn, run);
+  JSON_SCAN_STORE(json_impl, impl);
+  return 0;
+}
+
+/**
+ * @brief Selects the widest kernel the CPU supports, run once
+ */
+static void json_scan_detect(void)
+{
+  if (json_scan_set(JSON_SCAN_AVX2) != 0 && json_scan_set(JSON_SCAN_SSE2) != 0)
+    json_scan_set(JSON_SCAN_SCALAR);
+}
+
+/**
+ * @brief Selects a kernel
+ *
+ * Detection runs first, so it never replaces the selected kernel later.
+ *
+ * @param impl Kernel to use
+ * @return 0 on success, -1 if the CPU or the build does not support it
+ */
+int json_scan_use(JsonScanImpl impl)
+{
+  pthread_once(&json_scan_once, json_scan_detect);
+  return json_scan_set(impl);
+}
+
+/**
+ * @brief First call of json_scan_spaces(), picks the kernel
+ */
+static const char *json_spaces_resolve(const char *p)
+{
+  pthread_once(&json_scan_once, json_scan_detect);
+  return JSON_SCAN_LOAD(json_spaces_fn)(p);
+}
+
+/**
+ * @brief First call of json_scan_string_run(), picks the kernel
+ */
+static const char *json_run_resolve(const char *p)
+{
+  pthread_once(&json_scan_once, json_scan_detect);
+  return JSON_SCAN_LOAD(json_run_fn)(p);
+}
+
+/**
+ * @brief Returns the kernel in use
+ *
+ * @return Selected kernel, detected on first use
+ */
+JsonScanImpl json_scan_impl(void)
+{
+  pthread_once(&json_scan_once, json_scan_detect);
+  return JSON_SCAN_LOAD(json_impl);
+}
+
+/**
+ * @brief Skips JSON whitespace
+ *
+ * @param p Null-terminated text
+ * @return First byte that is not a space, tab, newline or carriage return
+ */
+const char *json_scan_spaces(const char *p)
+{
+  /* Most tokens follow at most one space, leave before the vector setup */
+  if (*p != ' ' && *p != '\n' && *p != '\t' && *p != '\r')
+    return p;
+  return JSON_SCAN_LOAD(json_spaces_fn)(p + 1);
+}
+
+/**
+ * @brief Finds the end of a run of plain string bytes
+ *
+ * @param p Null-terminated text inside a string
+ * @return First quote, backslash or null terminator
+ */
+const char *json_scan_string_run(const char *p)
+{
+  return JSON_SCAN_LOAD(json_run_fn)(p);
+}
+
+/**
+ * @brief Finds the closing quote of a string
+ *
+ * Escaped characters are stepped over, they are not decoded.
+ *
+ * @param p Null-terminated text after the opening quote
+ * @param escaped Pointer to store 1 if the string contains escapes
+ * @return Closing quote, or NULL if the text ends first
+ */
+const char *json_scan_string(const char *p, int *escaped)
+{
+  *escaped = 0;
+  for (;;)
+  {
+    p = JSON_SCAN_LOAD(json_run_fn)(p);
+    if (*p == '"')
+      return p;
+    if (*p == '\0' || p[1] == '\0')
+      return NULL;
+    *escaped = 1;
+    p += 2;
+  }
+}
+
+/**
+ * @brief Reads four hex digits of a \\u escape
+ *
+ * @param p Text at the first digit
+ * @return Code unit, or -1 if a digit is invalid
+ */
+static int32_t json_hex4(const char *p)
+{
+  int32_t unit = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    char c = p[i];
+    unit <<= 4;
+    if (c >= '0' && c <= '9') unit |= c - '0';
+    else if (c >= 'a' && c <= 'f') unit |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') unit |= c - 'A' + 10;
+    else return -1;
+  }
+  return unit;
+}
+
+/**
+ * @brief Decodes the escapes of a string body
+ *
+ * \\u escapes become UTF-8, surrogate pairs are combined. The output is
+ * never longer than the input, so @p out can hold @p length bytes.
+ * \\u0000 and unpaired surrogates are rejected: the first would cut the
+ * null-terminated result short, the second has no UTF-8 encoding.
+ *
+ * @param out Buffer of at least @p length bytes, not null-terminated
+ * @param in String body between the quotes
+ * @param length Length of the body in bytes
+ * @return Number of bytes written, JSON_UNESCAPE_ERROR for an invalid escape
+ */
+size_t json_unescape(char *out, const char *in, size_t length)
+{
+  const char *end = in + length;
+  char *o = out;
+
+  while (in < end)
+  {
+    if (*in != '\\')
+    {
+      *o++ = *in++;
+      continue;
+    }
+    if (end - in < 2)
+      return JSON_UNESCAPE_ERROR;
+
+    char c = in[1];
+    in += 2;
+    switch (c)
+    {
+      case '"': *o++ = '"'; break;
+      case '\\': *o++ = '\\'; break;
+      case '/': *o++ = '/'; break;
+      case 'b': *o++ = '\b'; break;
+      case 'f': *o++ = '\f'; break;
+      case 'n': *o++ = '\n'; break;
+      case 'r': *o++ = '\r'; break;
+      case 't': *o++ = '\t'; break;
+      case 'u':
+      {
+        int32_t code = end - in >= 4 ? json_hex4(in) : -1;
+        if (code <= 0 || (code >= 0xDC00 && code <= 0xDFFF))
+          return JSON_UNESCAPE_ERROR;
+        in += 4;
+        if (code >= 0xD800 && code <= 0xDBFF)
+        {
+          int32_t low = end - in >= 6 && in[0] == '\\' && in[1] == 'u' ? json_hex4(in + 2) : -1;
+          if (low < 0xDC00 || low > 0xDFFF)
+            return JSON_UNESCAPE_ERROR;
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          in += 6;
+        }
+
+        if (code < 0x80)
+          *o++ = (char)code;
+        else if (code < 0x800)
+        {
+          *o++ = (char)(0xC0 | (code >> 6));
+          *o++ = (char)(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+          *o++ = (char)(0xE0 | (code >> 12));
+          *o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+          *o++ = (char)(0x80 | (code & 0x3F));
+        }
+        else
+        {
+          *o++ = (char)(0xF0 | (code >> 18));
+          *o++ = (char)(0x80 | ((code >> 12) & 0x3F));
+          *o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+          *o++ = (char)(0x80 | (code & 0x3F));
+        }
+        break;
+      }
+      default:
+        return JSON_UNESCAPE_ERROR;
+    }
+  }
+  return (size_t)(o - out);
+}
@@ -0,0 +1,562 @@
+/**
+ * @file json_writer.c
+ * @brief Buffered JSON text writer
+ *
+ * Collects JSON output in a buffer that either grows in memory or is
+ * flushed to a file descriptor or a user callback. Keeps track of commas
+ * and indentation, escapes strings and formats integers without stdio.
+ */
+
+#include <locale.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "../include/json_writer.h"
+
+/**
+ * @brief Spaces used for indentation, written in chunks instead of per level
+ */
+static const char json_spaces[] =
+  "                                                                "
+  "                                                                ";
+
+/**
+ * @brief Two-digit pairs "00".."99" used by json_itoa()
+ */
+static const char json_digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/**
+ * @brief Escape needed for each byte: 0 none, 'u' for \\u00XX, else the letter
+ */
+static const char json_escape[256] = {
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+  0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0
+};
+
+/**
+ * @brief Sets up the fields shared by every target
+ *
+ * @param w Writer to initialize
+ * @param target Output target
+ * @param style JSON_PRETTY or JSON_COMPACT
+ * @return 0 on success, -1 if the buffer cannot be allocated
+ */
+static int json_writer_init(JsonWriter *w, JsonWriterTarget target, int style)
+{
+  memset(w, 0, sizeof(*w));
+  w->target = target;
+  w->pretty = style == JSON_PRETTY;
+  w->fd = -1;
+  w->buf = malloc(JSON_WRITER_CHUNK);
+  if (!w->buf)
+  {
+    w->error = 1;
+    return -1;
+  }
+  w->cap = JSON_WRITER_CHUNK;
+  return 0;
+}
+
+/**
+ * @brief Initializes a writer that collects output in memory
+ *
+ * @param w Writer to initialize, the text is w->buf[0..w->len)
+ * @param style JSON_PRETTY or JSON_COMPACT
+ * @return 0 on success, -1 on error
+ * @note The text is not null-terminated, release it with json_writer_free()
+ */
+int json_writer_init_buffer(JsonWriter *w, int style)
+{
+  return json_writer_init(w, JSON_WRITER_BUFFER, style);
+}
+
+/**
+ * @brief Initializes a writer that flushes to a file descriptor
+ *
+ * @param w Writer to initialize
+ * @param fd Open file descriptor, not closed by the writer
+ * @param style JSON_PRETTY or JSON_COMPACT
+ * @return 0 on success, -1 on error
+ */
+int json_writer_init_fd(JsonWriter *w, int fd, int style)
+{
+  if (json_writer_init(w, JSON_WRITER_FD, style) != 0)
+    return -1;
+  w->fd = fd;
+  return 0;
+}
+
+/**
+ * @brief Initializes a writer that flushes to a user function
+ *
+ * @param w Writer to initialize
+ * @param write Function receiving each flushed chunk, returns 0 on success
+ * @param user Pointer passed to @p write
+ * @param style JSON_PRETTY or JSON_COMPACT
+ * @return 0 on success, -1 on error
+ */
+int json_writer_init_callback(JsonWriter *w, JsonWriteFn write, void *user, int style)
+{
+  if (json_writer_init(w, JSON_WRITER_CALLBACK, style) != 0)
+    return -1;
+  w->write = write;
+  w->user = user;
+  return 0;
+}
+
+/**
+ * @brief Hands bytes to the fd or callback target
+ *
+ * @param w Writer
+ * @param data Bytes to write
+ * @param length Number of bytes
+ */
+static void json_writer_emit(JsonWriter *w, const char *data, size_t length)
+{
+  if (w->error || length == 0)
+    return;
+
+  if (w->target == JSON_WRITER_CALLBACK)
+  {
+    if (w->write(w->user, data, length) != 0)
+      w->error = 1;
+    return;
+  }
+
+  while (length > 0)
+  {
+#ifdef _WIN32
+    long n = (long)_write(w->fd, data, (unsigned)length);
+#else
+    long n = (long)write(w->fd, data, length);
+#endif
+    if (n <= 0)
+    {
+      w->error = 1;
+      return;
+    }
+    data += n;
+    length -= (size_t)n;
+  }
+}
+
+/**
+ * @brief Writes buffered output to the fd or callback target
+ *
+ * Does nothing for in-memory writers.
+ *
+ * @param w Writer
+ * @return 0 on success, -1 if any write failed
+ */
+int json_writer_flush(JsonWriter *w)
+{
+  if (w->target != JSON_WRITER_BUFFER)
+  {
+    json_writer_emit(w, w->buf, w->len);
+    w->len = 0;
+  }
+  return w->error ? -1 : 0;
+}
+
+/**
+ * @brief Makes room for a number of bytes at the end of the buffer
+ *
+ * @param w Writer
+ * @param length Number of bytes that will be appended
+ * @return 1 if the bytes fit, 0 if they have to bypass the buffer or on error
+ */
+static int json_writer_reserve(JsonWriter *w, size_t length)
+{
+  if (w->error)
+    return 0;
+  if (w->cap - w->len >= length)
+    return 1;
+
+  if (w->target != JSON_WRITER_BUFFER)
+  {
+    json_writer_flush(w);
+    return length <= w->cap;
+  }
+
+  size_t cap = w->cap * 2;
+  while (cap - w->len < length) cap *= 2;
+
+  char *buf = realloc(w->buf, cap);
+  if (!buf)
+  {
+    w->error = 1;
+    return 0;
+  }
+  w->buf = buf;
+  w->cap = cap;
+  return 1;
+}
+
+/**
+ * @brief Appends bytes without any formatting
+ *
+ * @param w Writer
+ * @param data Bytes to append
+ * @param length Number of bytes
+ */
+void json_writer_raw(JsonWriter *w, const char *data, size_t length)
+{
+  if (json_writer_reserve(w, length))
+  {
+    memcpy(w->buf + w->len, data, length);
+    w->len += length;
+  }
+  else
+  {
+    /* Larger than the whole chunk: the buffer was flushed, write through */
+    json_writer_emit(w, data, length);
+  }
+}
+
+/**
+ * @brief Appends the indentation for a nesting depth
+ *
+ * @param w Writer
+ * @param depth Indentation depth, two spaces per level
+ */
+static void json_writer_indent(JsonWriter *w, int depth)
+{
+  size_t count = (size_t)depth * 2;
+  while (count > 0)
+  {
+    size_t n = count < sizeof(json_spaces) - 1 ? count : sizeof(json_spaces) - 1;
+    json_writer_raw(w, json_spaces, n);
+    count -= n;
+  }
+}
+
+/**
+ * @brief Formats an integer in decimal
+ *
+ * Converts two digits per step using a lookup table.
+ *
+ * @param out Buffer of at least 20 bytes, not null-terminated
+ * @param value Integer to format
+ * @return Number of characters written
+ */
+size_t json_itoa(char *out, int64_t value)
+{
+  char tmp[20];
+  char *p = tmp + sizeof(tmp);
+  uint64_t v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+  while (v >= 100)
+  {
+    unsigned pair = (unsigned)(v % 100) * 2;
+    v /= 100;
+    *--p = json_digit_pairs[pair + 1];
+    *--p = json_digit_pairs[pair];
+  }
+  if (v >= 10)
+  {
+    unsigned pair = (unsigned)v * 2;
+    *--p = json_digit_pairs[pair + 1];
+    *--p = json_digit_pairs[pair];
+  }
+  else
+  {
+    *--p = (char)('0' + v);
+  }
+  if (value < 0)
+    *--p = '-';
+
+  size_t length = (size_t)(tmp + sizeof(tmp) - p);
+  memcpy(out, p, length);
+  return length;
+}
+
+/**
+ * @brief Appends a quoted, escaped JSON string
+ *
+ * Runs of bytes that need no escaping are copied at once.
+ *
+ * @param w Writer
+ * @param value String bytes, not necessarily null-terminated
+ * @param length Number of bytes
+ */
+static void json_writer_quoted(JsonWriter *w, const char *value, size_t length)
+{
+  static const char hex[] = "0123456789abcdef";
+  const unsigned char *s = (const unsigned char *)value;
+  size_t start = 0;
+
+  json_writer_raw(w, "\"", 1);
+  for (size_t i = 0; i < length; i++)
+  {
+    char esc = json_escape[s[i]];
+    if (!esc)
+      continue;
+
+    json_writer_raw(w, value + start, i - start);
+    if (esc == 'u')
+    {
+      char seq[6] = {'\\', 'u', '0', '0', hex[s[i] >> 4], hex[s[i] & 0xF]};
+      json_writer_raw(w, seq, sizeof(seq));
+    }
+    else
+    {
+      char seq[2] = {'\\', esc};
+      json_writer_raw(w, seq, sizeof(seq));
+    }
+    start = i + 1;
+  }
+  json_writer_raw(w, value + start, length - start);
+  json_writer_raw(w, "\"", 1);
+}
+
+/**
+ * @brief Opens an object or an array
+ *
+ * @param w Writer
+ * @param bracket Opening bracket
+ */
+static void json_writer_open(JsonWriter *w, char bracket)
+{
+  char open[2] = {bracket, '\n'};
+  json_writer_raw(w, open, w->pretty ? 2 : 1);
+  w->depth++;
+  w->need_comma = 0;
+}
+
+/**
+ * @brief Closes the innermost object or array
+ *
+ * @param w Writer
+ * @param bracket Closing bracket
+ */
+static void json_writer_close(JsonWriter *w, char bracket)
+{
+  w->depth--;
+  if (w->pretty)
+  {
+    /* A non-empty container still has its last line open */
+    if (w->need_comma)
+      json_writer_raw(w, "\n", 1);
+    json_writer_indent(w, w->depth);
+  }
+  json_writer_raw(w, &bracket, 1);
+  w->need_comma = 1;
+}
+
+/**
+ * @brief Writes the separator from the previous member or element and
+ *        the indentation
+ *
+ * @param w Writer
+ */
+static void json_writer_separator(JsonWriter *w)
+{
+  if (w->need_comma)
+  {
+    if (w->pretty)
+      json_writer_raw(w, ",\n", 2);
+    else
+      json_writer_raw(w, ",", 1);
+  }
+  if (w->pretty)
+    json_writer_indent(w, w->depth);
+}
+
+/**
+ * @brief Opens a JSON object
+ *
+ * @param w Writer
+ */
+void json_writer_begin_object(JsonWriter *w)
+{
+  json_writer_open(w, '{');
+}
+
+/**
+ * @brief Closes the innermost JSON object
+ *
+ * @param w Writer
+ */
+void json_writer_end_object(JsonWriter *w)
+{
+  json_writer_close(w, '}');
+}
+
+/**
+ * @brief Opens a JSON array
+ *
+ * Every element is started with json_writer_element().
+ *
+ * @param w Writer
+ */
+void json_writer_begin_array(JsonWriter *w)
+{
+  json_writer_open(w, '[');
+}
+
+/**
+ * @brief Closes the innermost JSON array
+ *
+ * @param w Writer
+ */
+void json_writer_end_array(JsonWriter *w)
+{
+  json_writer_close(w, ']');
+}
+
+/**
+ * @brief Starts an array element
+ *
+ * Writes the separator from the previous element and the indentation.
+ *
+ * @param w Writer
+ */
+void json_writer_element(JsonWriter *w)
+{
+  json_writer_separator(w);
+}
+
+/**
+ * @brief Starts an object member
+ *
+ * Writes the separator from the previous member, the indentation and the
+ * quoted name followed by a colon.
+ *
+ * @param w Writer
+ * @param name Member name
+ * @param length Length of the name in bytes
+ */
+void json_writer_key(JsonWriter *w, const char *name, size_t length)
+{
+  json_writer_separator(w);
+  json_writer_quoted(w, name, length);
+  if (w->pretty)
+    json_writer_raw(w, ": ", 2);
+  else
+    json_writer_raw(w, ":", 1);
+}
+
+/**
+ * @brief Writes an integer value
+ *
+ * @param w Writer
+ * @param value Integer to write
+ */
+void json_writer_integer(JsonWriter *w, int64_t value)
+{
+  char digits[20];
+  json_writer_raw(w, digits, json_itoa(digits, value));
+  w->need_comma = 1;
+}
+
+/**
+ * @brief Writes a string value with JSON escaping
+ *
+ * @param w Writer
+ * @param value String bytes, not necessarily null-terminated
+ * @param length Number of bytes
+ */
+void json_writer_string(JsonWriter *w, const char *value, size_t length)
+{
+  json_writer_quoted(w, value, length);
+  w->need_comma = 1;
+}
+
+/**
+ * @brief Writes a floating-point value
+ *
+ * Uses the shortest of 15 or 17 significant digits that reads back as the
+ * same double. snprintf() and strtod() agree on the locale's decimal
+ * point, which is replaced by '.' afterwards. JSON has no NaN or infinity,
+ * those are written as null.
+ *
+ * @param w Writer
+ * @param value Number to write
+ */
+void json_writer_real(JsonWriter *w, double value)
+{
+  if (!isfinite(value))
+  {
+    json_writer_null(w);
+    return;
+  }
+
+  char digits[32];
+  int length = snprintf(digits, sizeof(digits), "%.15g", value);
+  if (strtod(digits, NULL) != value)
+    length = snprintf(digits, sizeof(digits), "%.17g", value);
+
+  const char *point = localeconv()->decimal_point;
+  char *found = strcmp(point, ".") != 0 ? strstr(digits, point) : NULL;
+  if (found)
+  {
+    size_t size = strlen(point);
+    *found = '.';
+    memmove(found + 1, found + size, strlen(found + size) + 1);
+    length -= (int)(size - 1);
+  }
+  json_writer_raw(w, digits, (size_t)length);
+  w->need_comma = 1;
+}
+
+/**
+ * @brief Writes true or false
+ *
+ * @param w Writer
+ * @param value Non-zero for true
+ */
+void json_writer_boolean(JsonWriter *w, int value)
+{
+  if (value)
+    json_writer_raw(w, "true", 4);
+  else
+    json_writer_raw(w, "false", 5);
+  w->need_comma = 1;
+}
+
+/**
+ * @brief Writes null
+ *
+ * @param w Writer
+ */
+void json_writer_null(JsonWriter *w)
+{
+  json_writer_raw(w, "null", 4);
+  w->need_comma = 1;
+}
+
+/**
+ * @brief Releases the writer buffer
+ *
+ * Buffered output of fd and callback writers is not flushed, call
+ * json_writer_flush() first.
+ *
+ * @param w Writer
+ */
+void json_writer_free(JsonWriter *w)
+{
+  free(w->buf);
+  w->buf = NULL;
+  w->len = 0;
+  w->cap = 0;
+}
@@ -2,17 +2,38 @@
  * @file main.c
  * @brief BEJ parser demonstration program
  * 
- * This program demonstrates the BEJ parser by:
+ * Without arguments the program demonstrates the BEJ parser by:
  * 1. Creating a sample BEJ binary file
- * 2. Loading and parsing the BEJ data
- * 3. Converting the parsed data to JSON format
+ * 2. Converting the BEJ data to JSON format in a single pass
+ *
+ * With arguments it converts many BEJ files in parallel:
+ *   bej_parser [-j THREADS] [-o DIR | --ndjson FILE] [--compact]
+ *              [--dict FILE] [-l LIST]... [FILE | DIR]...
+ * Directories are searched recursively, a LIST holds one path per line
+ * ("-" reads standard input), --ndjson - writes the stream to standard
+ * output. Throughput is reported on standard error.
  */
 
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "../include/bej_parse.h"
+#include "../include/bej_transcode.h"
+#include "../include/bej_batch.h"
+#include "../include/dictionary_loader.h"
+
+/*input paths collected from the command line*/
+typedef struct FileList
+{
+  char **paths;
+  size_t count;
+  size_t cap;
+} FileList;
 
 /**
  * @brief Sample BEJ data representing a memory module structure
@@ -30,86 +51,288 @@
  */
 uint8_t bej_data[] = {
   
-  /* Root SET */
-  0x00,                 // ID=0 (root)
+  /* Root SET, IDs and lengths are nnints: a byte count, then the value */
+  0x01, 0x00,           // ID=0 (root)
   0x00,                 // TYPE=BEJ_SET
-  0x0B,                 // Length of SET in bytes
+  0x01, 0x2A,           // Length of SET in bytes
   
   /* CapacityMiB (id=1, integer) */
-  0x01,                 // ID=1
+  0x01, 0x01,           // ID=1
   0x03,                 // TYPE=BEJ_INTEGER
-  0x04,                 // Length = 4 bytes
+  0x01, 0x04,           // Length = 4 bytes
   0x00, 0x00, 0x01, 0x00, // 65536 in little-endian
   
   /* DataWidthBits (id=2, integer) */
-  0x02,                 // ID=2
+  0x01, 0x02,           // ID=2
   0x03,                 // TYPE=BEJ_INTEGER
-  0x01,                 // Length = 1 byte
+  0x01, 0x01,           // Length = 1 byte
   0x40,                 // 64
   
   /* ErrorCorrection (id=3, string) */
-  0x03,                 // ID=3
+  0x01, 0x03,           // ID=3
   0x05,                 // TYPE=BEJ_STRING
-  0x05,                 // Length = 5 bytes
+  0x01, 0x05,           // Length = 5 bytes
   0x4E, 0x6F, 0x45, 0x43, 0x43, // "NoECC"
   
   /* MemoryLocation (id=4, set) */
-  0x04,                 // ID=4
+  0x01, 0x04,           // ID=4
   0x00,                 // TYPE=BEJ_SET
-  0x02,                 // SET length in bytes
+  0x01, 0x0C,           // SET length in bytes
   
   /* Channel (id=1, integer) */
-  0x01,               // ID=1
+  0x01, 0x01,         // ID=1
   0x03,               // TYPE=BEJ_INTEGER
-  0x01,               // Length = 1 byte
+  0x01, 0x01,         // Length = 1 byte
   0x00,               // Value = 0
     
   /* Slot (id=2, integer) */
-  0x02,               // ID=2
+  0x01, 0x02,         // ID=2
   0x03,               // TYPE=BEJ_INTEGER
-  0x01,               // Length = 1 byte
+  0x01, 0x01,         // Length = 1 byte
   0x00                // Value = 0
 };
 
+/**
+ * @brief Appends a copy of a path to the list
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+static int file_list_add(FileList *list, const char *path)
+{
+  if (list->count == list->cap)
+  {
+    size_t cap = list->cap ? list->cap * 2 : 256;
+    char **paths = realloc(list->paths, sizeof(char *) * cap);
+    if (!paths)
+      return -1;
+    list->paths = paths;
+    list->cap = cap;
+  }
+
+  list->paths[list->count] = strdup(path);
+  if (!list->paths[list->count])
+    return -1;
+  list->count++;
+  return 0;
+}
+
+/**
+ * @brief Adds a file, or every regular file below a directory
+ *
+ * A path given by the user is followed if it is a symbolic link. Links met
+ * while searching a directory are added if they point to a file and
+ * skipped if they point to a directory, so link cycles end the search.
+ *
+ * @param list List to extend
+ * @param path File or directory
+ * @param top Nonzero for a path given by the user
+ * @return 0 on success, -1 on error
+ */
+static int file_list_add_path(FileList *list, const char *path, int top)
+{
+  struct stat st;
+  if ((top ? stat(path, &st) : lstat(path, &st)) != 0)
+  {
+    fprintf(stderr, "%s: not found\n", path);
+    return -1;
+  }
+  if (S_ISLNK(st.st_mode))
+  {
+    if (stat(path, &st) != 0 || S_ISDIR(st.st_mode))
+      return 0;
+  }
+  if (!S_ISDIR(st.st_mode))
+    return file_list_add(list, path);
+
+  DIR *dir = opendir(path);
+  if (!dir)
+  {
+    fprintf(stderr, "%s: cannot open directory\n", path);
+    return -1;
+  }
+
+  int result = 0;
+  struct dirent *entry;
+  while (result == 0 && (entry = readdir(dir)) != NULL)
+  {
+    if (entry->d_name[0] == '.')
+      continue;
+    char *child = malloc(strlen(path) + strlen(entry->d_name) + 2);
+    if (!child)
+    {
+      result = -1;
+      break;
+    }
+    sprintf(child, "%s/%s", path, entry->d_name);
+    result = file_list_add_path(list, child, 0);
+    free(child);
+  }
+  closedir(dir);
+  return result;
+}
+
+/**
+ * @brief Adds the paths listed in a file, one per line
+ *
+ * @param list List to extend
+ * @param name List file, "-" for standard input
+ * @return 0 on success, -1 on error
+ */
+static int file_list_read(FileList *list, const char *name)
+{
+  FILE *f = strcmp(name, "-") == 0 ? stdin : fopen(name, "r");
+  if (!f)
+  {
+    fprintf(stderr, "%s: not found\n", name);
+    return -1;
+  }
+
+  int result = 0;
+  char line[4096];
+  while (result == 0 && fgets(line, sizeof(line), f))
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] != '\0')
+      result = file_list_add_path(list, line, 1);
+  }
+  if (f != stdin)
+    fclose(f);
+  return result;
+}
+
+/**
+ * @brief Converts the files named on the command line in parallel
+ *
+ * @param argc Argument count
+ * @param argv Arguments, see the file description
+ * @return 0 if every file was converted, 1 otherwise
+ */
+static int run_batch(int argc, char **argv)
+{
+  BejBatchOptions options = {0, JSON_PRETTY, ".", -1, main_dictionary};
+  const char *ndjson = NULL;
+  const char *dict_file = NULL;
+  FileList list = {NULL, 0, 0};
+  int result = 0;
+
+  for (int i = 1; i < argc && result == 0; i++)
+  {
+    int has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-j") == 0 && has_value)
+      options.threads = (uint32_t)atoi(argv[++i]);
+    else if (strcmp(argv[i], "-o") == 0 && has_value)
+      options.output_dir = argv[++i];
+    else if (strcmp(argv[i], "--ndjson") == 0 && has_value)
+      ndjson = argv[++i];
+    else if (strcmp(argv[i], "--dict") == 0 && has_value)
+      dict_file = argv[++i];
+    else if (strcmp(argv[i], "-l") == 0 && has_value)
+      result = file_list_read(&list, argv[++i]);
+    else if (strcmp(argv[i], "--compact") == 0)
+      options.style = JSON_COMPACT;
+    else if (argv[i][0] == '-')
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      result = -1;
+    }
+    else
+      result = file_list_add_path(&list, argv[i], 1);
+  }
+
+  BejSchemaDictionary schema;
+  memset(&schema, 0, sizeof(schema));
+  if (result == 0 && dict_file)
+  {
+    if (bej_dictionary_load(dict_file, &schema) != BEJ_OK)
+    {
+      fprintf(stderr, "%s: invalid dictionary\n", dict_file);
+      result = -1;
+    }
+    options.dict = schema.root;
+  }
+
+  if (result == 0 && ndjson)
+  {
+    options.ndjson_fd = strcmp(ndjson, "-") == 0 ? STDOUT_FILENO
+                        : open(ndjson, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (options.ndjson_fd < 0)
+    {
+      fprintf(stderr, "%s: cannot create\n", ndjson);
+      result = -1;
+    }
+  }
+
+  if (result == 0)
+  {
+    BejBatchStats stats;
+    BejError error = bej_batch_run((const char *const *)list.paths, list.count, &options, &stats);
+    if (error == BEJ_ERR_NOMEM)
+      fprintf(stderr, "Out of memory\n");
+    else if (stats.files == 0 || stats.seconds <= 0)
+      fprintf(stderr, "%zu files, %zu failed\n", stats.files, stats.failed);
+    else
+      fprintf(stderr, "%zu files, %zu failed, %.1f MB in, %.1f MB out, %.3f s, "
+              "%.0f files/s, %.1f MB/s, %u threads, %llu steals\n",
+              stats.files, stats.failed, stats.bytes_in / 1e6, stats.bytes_out / 1e6,
+              stats.seconds, stats.files / stats.seconds, stats.bytes_in / 1e6 / stats.seconds,
+              stats.pool.workers, (unsigned long long)stats.pool.steals);
+    result = error == BEJ_OK ? 0 : -1;
+  }
+
+  if (options.ndjson_fd >= 0 && options.ndjson_fd != STDOUT_FILENO)
+    close(options.ndjson_fd);
+  if (dict_file)
+    bej_dictionary_unload(&schema);
+  for (size_t i = 0; i < list.count; i++)
+    free(list.paths[i]);
+  free(list.paths);
+  return result == 0 ? 0 : 1;
+}
+
 /**
  * @brief Main program entry point
  * 
- * Demonstrates the complete BEJ parsing workflow:
+ * Demonstrates the complete BEJ parsing workflow when called without
+ * arguments:
  * - Writes sample BEJ data to a binary file
- * - Loads the binary file
- * - Parses the BEJ data structure
- * - Converts to JSON format
- * - Cleans up allocated memory
+ * - Maps the binary file
+ * - Transcodes the BEJ data to JSON format
  * 
+ * Otherwise converts the files given on the command line in parallel.
+ * 
+ * @param argc Argument count
+ * @param argv Arguments
  * @return 0 on success, 1 on error
  */
-int main()
+int main(int argc, char **argv)
 { 
+  /* Constant-time name lookups for the built-in dictionaries */
+  if (bej_dictionary_init() != 0)
+  {
+    printf("Out of memory\n");
+    return 1;
+  }
+
+  if (argc > 1)
+    return run_batch(argc, argv);
+  
   /* Write data to bej.bin */
   FILE *f = fopen("../bin/bej.bin", "wb");
   fwrite(bej_data, 1, sizeof(bej_data), f);
   fclose(f);
   
-  /* Load data from bej.bin */
-  uint8_t *bin_data = bej_load_file("../bin/bej.bin");
-  if(!bin_data) 
+  /* Convert bej.bin to JSON in one pass, without building a tree */
+  BejError error = bej_transcode_file("../bin/bej.bin", "../json/result.json", BEJ_JSON_PRETTY);
+  if (error == BEJ_ERR_IO)
   {
     printf("File not found\n");
     return 1;
   }
-  
-  /* Skip first three BEJ bytes [index][type][len] */
-  const uint8_t *data_ptr = bin_data;
-  
-  /* Parse BEJ data */
-  BejSet *root = bej_read_value(&data_ptr, main_dictionary);
-  
-  /* Convert to JSON */
-  bej_to_json_file(root, "../json/result.json");
-  
-  /* Free allocated memory */
-  free(bin_data);
-  bej_free(root);
+  if (error != BEJ_OK)
+  {
+    printf("Invalid BEJ data (%s)\n", bej_error_string(error));
+    return 1;
+  }
   
   return 0;
 }
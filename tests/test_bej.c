@@ -7,8 +7,27 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <locale.h>
 #include "../include/bej_parse.h"
 #include "../include/dictionary.h"
+#include "../include/bej_sax.h"
+#include "../include/bej_transcode.h"
+#include "../include/json_writer.h"
+#include "../include/dictionary_loader.h"
+#include "../include/bej_encode.h"
+#include "../include/json_parse.h"
+#include "../include/bej_tape.h"
+#include "../include/json_scan.h"
+#include "../include/bej_query.h"
+#include "../include/bej_push.h"
+#include "../include/bej_batch.h"
+#include "../include/bej_parallel.h"
+#include "../include/bej_cache.h"
+#include "../include/bej_diff.h"
+#include "../include/bej_project.h"
+#include "../include/bej_validate.h"
 
 #define TEST_PASS "\033[0;32m[PASS]\033[0m" /*color green*/
 #define TEST_FAIL "\033[0;31m[FAIL]\033[0m" /*color red*/
@@ -33,22 +52,22 @@ void test_result(const char *test_name, int passed)
 /* Test bej_read_integer - happy path */
 void test_read_integer()
 {
-    uint8_t data[] = {0x01, 0x03, 0x04, 0x00, 0x00, 0x01, 0x00};
-    const uint8_t *ptr = data;
-    ptr++;  // skip ID
+    uint8_t data[] = {0x01, 0x01, 0x03, 0x01, 0x04, 0x00, 0x00, 0x01, 0x00};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data + 3, sizeof(data) - 3);  // skip ID and type
     
-    uint32_t result = bej_read_integer(&ptr);
+    int64_t result = bej_read_integer(&ctx);
     test_result("read_integer: standard case", result == 65536);
 }
 
 /* Test bej_read_string - happy path */
 void test_read_string() 
 {
-    uint8_t data[] = {0x03, 0x05, 0x05, 'N', 'o', 'E', 'C', 'C'};
-    const uint8_t *ptr = data;
-    ptr++;  // skip ID
+    uint8_t data[] = {0x01, 0x03, 0x05, 0x01, 0x05, 'N', 'o', 'E', 'C', 'C'};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data + 3, sizeof(data) - 3);  // skip ID and type
     
-    char *result = bej_read_string(&ptr);
+    char *result = bej_read_string(&ctx);
     int passed = (result != NULL && strcmp(result, "NoECC") == 0);
     test_result("read_string: standard case", passed);
     free(result);
@@ -57,10 +76,11 @@ void test_read_string()
 /* Test bej_read_value - happy path */
 void test_read_value_integer() 
 {
-    uint8_t data[] = {0x01, 0x03, 0x01, 0x40};
-    const uint8_t *ptr = data;
+    uint8_t data[] = {0x01, 0x01, 0x03, 0x01, 0x01, 0x40};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data, sizeof(data));
     
-    BejSet *val = bej_read_value(&ptr, main_dictionary);
+    BejSet *val = bej_read_value(&ctx, main_dictionary);
     int passed = (val != NULL && val->type == BEJ_INTEGER && val->integer_value == 64);
     test_result("read_value: integer", passed);
     bej_free(val);
@@ -68,10 +88,11 @@ void test_read_value_integer()
 
 void test_read_value_string() 
 {
-    uint8_t data[] = {0x03, 0x05, 0x05, 'N', 'o', 'E', 'C', 'C'};
-    const uint8_t *ptr = data;
+    uint8_t data[] = {0x01, 0x03, 0x05, 0x01, 0x05, 'N', 'o', 'E', 'C', 'C'};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data, sizeof(data));
     
-    BejSet *val = bej_read_value(&ptr, main_dictionary);
+    BejSet *val = bej_read_value(&ctx, main_dictionary);
     int passed = (val != NULL && val->type == BEJ_STRING);
     test_result("read_value: string", passed);
     bej_free(val);
@@ -81,20 +102,367 @@ void test_read_value_string()
 void test_parse_complete_structure() 
 {
     uint8_t data[] = {
-        0x00, 0x00, 0x0B,
-        0x01, 0x03, 0x04, 0x00, 0x00, 0x01, 0x00,
-        0x02, 0x03, 0x01, 0x40,
-        0x03, 0x05, 0x05, 0x4E, 0x6F, 0x45, 0x43, 0x43
+        0x01, 0x00, 0x00, 0x01, 0x19,
+        0x01, 0x01, 0x03, 0x01, 0x04, 0x00, 0x00, 0x01, 0x00,
+        0x01, 0x02, 0x03, 0x01, 0x01, 0x40,
+        0x01, 0x03, 0x05, 0x01, 0x05, 0x4E, 0x6F, 0x45, 0x43, 0x43
     };
-    const uint8_t *ptr = data;
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data, sizeof(data));
     
-    BejSet *root = bej_read_value(&ptr, main_dictionary);
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
     int passed = (root != NULL && root->type == BEJ_SET && 
                   root->object_value.count == 3);
     test_result("parse: complete structure", passed);
     bej_free(root);
 }
 
+/* Test nested SET followed by a sibling - ids come from the data */
+void test_parse_nested_set()
+{
+    uint8_t data[] = {
+        0x01, 0x00, 0x00, 0x01, 0x16,
+        0x01, 0x04, 0x00, 0x01, 0x06,
+        0x01, 0x02, 0x03, 0x01, 0x01, 0x07,
+        0x01, 0x02, 0x03, 0x01, 0x01, 0x40,
+        0x01, 0x01, 0x03, 0x01, 0x00
+    };
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data, sizeof(data));
+
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
+    int passed = (root != NULL && root->object_value.count == 3 &&
+                  root->object_value.pairs[0].id == 4 &&
+                  root->object_value.pairs[0].value->object_value.count == 1 &&
+                  root->object_value.pairs[0].value->object_value.pairs[0].id == 2 &&
+                  root->object_value.pairs[1].id == 2 &&
+                  root->object_value.pairs[1].value->integer_value == 64 &&
+                  ctx.cursor == ctx.end);
+    test_result("parse: nested set with sibling", passed);
+    bej_free(root);
+}
+
+/* Test truncated input - error and offset reported */
+void test_parse_truncated()
+{
+    uint8_t data[] = {0x01, 0x00, 0x00, 0x01, 0x0A, 0x01, 0x01, 0x03, 0x01, 0x04, 0x00, 0x00, 0x01};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data, sizeof(data));
+
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
+    test_result("parse: truncated input",
+                root == NULL && ctx.error == BEJ_ERR_TRUNCATED && ctx.error_offset == 5);
+}
+
+/* Test arena decoding - reset and reuse */
+void test_read_value_arena()
+{
+    uint8_t data[] = {0x01, 0x03, 0x05, 0x01, 0x05, 'N', 'o', 'E', 'C', 'C'};
+    BejArena arena;
+    bej_arena_init(&arena, 64);
+
+    int passed = 1;
+    for (int i = 0; i < 3; i++)
+    {
+        BejDecoder ctx;
+        bej_decoder_init(&ctx, data, sizeof(data));
+        ctx.arena = &arena;
+        BejSet *val = bej_read_value(&ctx, main_dictionary);
+        passed = passed && val != NULL && val->type == BEJ_STRING &&
+                 strcmp(val->string_value.data, "NoECC") == 0;
+        bej_arena_reset(&arena);
+    }
+    passed = passed && arena.head != NULL && arena.head->next == NULL;
+    test_result("read_value: arena reset and reuse", passed);
+    bej_arena_destroy(&arena);
+}
+
+/* Test zero-copy strings - view into input and JSON output */
+void test_read_value_view()
+{
+    uint8_t data[] = {0x01, 0x03, 0x05, 0x01, 0x05, 'N', 'o', 'E', 'C', 'C', 0x02};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data, sizeof(data));
+    ctx.flags = BEJ_DECODE_ZERO_COPY;
+
+    BejSet *val = bej_read_value(&ctx, main_dictionary);
+    int passed = (val != NULL && val->type == BEJ_STRING &&
+                  val->string_value.data == (char *)&data[5] && val->string_value.length == 5);
+
+    char out[16] = {0};
+    FILE *f = tmpfile();
+    if (f && val)
+    {
+        bej_to_json_val(val, main_dictionary, f, 0);
+        rewind(f);
+        fgets(out, sizeof(out), f);
+    }
+    if (f) fclose(f);
+
+    test_result("read_value: zero-copy string", passed && strcmp(out, "\"NoECC\"") == 0);
+    bej_free(val);
+}
+
+/* Test file loading - mapped and copied input with sizes */
+void test_map_file()
+{
+    uint8_t data[] = {0x01, 0x01, 0x03, 0x01, 0x01, 0x40, 0x01, 0x02, 0x03, 0x01, 0x01, 0x20};
+    char path[] = "/tmp/bej_testXXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!f)
+    {
+        test_result("map_file: concatenated messages", 0);
+        return;
+    }
+    fwrite(data, 1, sizeof(data), f);
+    fclose(f);
+
+    BejMapping map;
+    int passed = bej_map_file(path, &map) == BEJ_OK && map.size == sizeof(data);
+    if (passed)
+    {
+        BejDecoder ctx;
+        bej_decoder_init(&ctx, map.data, map.size);
+        int64_t sum = 0;
+        while (ctx.cursor < ctx.end)
+        {
+            BejSet *val = bej_read_value(&ctx, main_dictionary);
+            if (!val) break;
+            sum += val->integer_value;
+            bej_free(val);
+        }
+        passed = ctx.error == BEJ_OK && sum == 0x60;
+        bej_unmap_file(&map);
+    }
+
+    size_t size = 0;
+    uint8_t *copy = bej_load_file(path, &size);
+    passed = passed && copy != NULL && size == sizeof(data) && memcmp(copy, data, size) == 0;
+    free(copy);
+    remove(path);
+
+    test_result("map_file: concatenated messages", passed);
+}
+
+/* Memory payload used by the streaming and transcoding tests */
+static const uint8_t memory_data[] = {
+    0x01, 0x00, 0x00, 0x01, 0x2A,
+    0x01, 0x01, 0x03, 0x01, 0x04, 0x00, 0x00, 0x01, 0x00,
+    0x01, 0x02, 0x03, 0x01, 0x01, 0x40,
+    0x01, 0x03, 0x05, 0x01, 0x05, 'N', 'o', 'E', 'C', 'C',
+    0x01, 0x04, 0x00, 0x01, 0x0C,
+    0x01, 0x01, 0x03, 0x01, 0x01, 0x00,
+    0x01, 0x02, 0x03, 0x01, 0x01, 0x03
+};
+
+typedef struct SaxCounter
+{
+    int sets;
+    int ends;
+    int64_t sum;
+    int strings;
+    const char *skip; /* property name to skip */
+    const char *stop; /* property name to stop at */
+} SaxCounter;
+
+static BejSaxAction sax_start_set(void *user)
+{
+    ((SaxCounter *)user)->sets++;
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_end_set(void *user)
+{
+    ((SaxCounter *)user)->ends++;
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_property(void *user, uint16_t id, const char *name, BejType type)
+{
+    SaxCounter *counter = user;
+    (void)id;
+    (void)type;
+    if (name && counter->skip && strcmp(name, counter->skip) == 0) return BEJ_SAX_SKIP;
+    if (name && counter->stop && strcmp(name, counter->stop) == 0) return BEJ_SAX_STOP;
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_integer(void *user, int64_t value)
+{
+    ((SaxCounter *)user)->sum += value;
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_string(void *user, const char *value, uint32_t length)
+{
+    SaxCounter *counter = user;
+    if (length == 5 && memcmp(value, "NoECC", 5) == 0) counter->strings++;
+    return BEJ_SAX_CONTINUE;
+}
+
+static const BejSaxCallbacks sax_counter_cb = {
+    sax_start_set, sax_end_set, sax_property, sax_integer, sax_string,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+/* Test streaming decoder - events, skipping and stopping */
+void test_sax_parse()
+{
+    BejDecoder ctx;
+    SaxCounter all = {0};
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    int passed = bej_sax_parse(&ctx, main_dictionary, &sax_counter_cb, &all) == BEJ_OK &&
+                 all.sets == 2 && all.ends == 2 && all.sum == 65536 + 64 + 3 &&
+                 all.strings == 1 && ctx.cursor == ctx.end;
+
+    SaxCounter skipped = {0};
+    skipped.skip = "MemoryLocation";
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    passed = passed && bej_sax_parse(&ctx, main_dictionary, &sax_counter_cb, &skipped) == BEJ_OK &&
+             skipped.sets == 1 && skipped.sum == 65536 + 64 && ctx.cursor == ctx.end;
+
+    SaxCounter stopped = {0};
+    stopped.stop = "ErrorCorrection";
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    passed = passed && bej_sax_parse(&ctx, main_dictionary, &sax_counter_cb, &stopped) == BEJ_ERR_ABORTED &&
+             stopped.strings == 0 && stopped.sum == 65536 + 64;
+
+    test_result("sax: events, skip and stop", passed);
+}
+
+/* Reads a whole temporary file into a buffer */
+static void read_back(FILE *f, char *out, size_t size)
+{
+    size_t n = 0;
+    rewind(f);
+    n = fread(out, 1, size - 1, f);
+    out[n] = '\0';
+}
+
+/* Test transcoder - identical to the tree emitters in both styles */
+void test_transcode_json()
+{
+    int passed = 1;
+    for (int style = BEJ_JSON_PRETTY; style <= BEJ_JSON_COMPACT; style++)
+    {
+        char direct[512], tree[512];
+        FILE *f = tmpfile();
+        FILE *g = tmpfile();
+        if (!f || !g)
+        {
+            passed = 0;
+            break;
+        }
+
+        BejDecoder ctx;
+        bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+        passed = passed && bej_transcode_json(&ctx, main_dictionary, f, style) == BEJ_OK;
+
+        bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+        BejSet *root = bej_read_value(&ctx, main_dictionary);
+        if (style == BEJ_JSON_PRETTY)
+            bej_to_json_val(root, main_dictionary, g, 0);
+        else
+            bej_to_json_compact(root, main_dictionary, g);
+        bej_free(root);
+
+        read_back(f, direct, sizeof(direct));
+        read_back(g, tree, sizeof(tree));
+        passed = passed && strcmp(direct, tree) == 0;
+        if (style == BEJ_JSON_COMPACT)
+            passed = passed && strcmp(direct, "{\"CapacityMiB\":65536,\"DataWidthBits\":64,"
+                                      "\"ErrorCorrection\":\"NoECC\","
+                                      "\"MemoryLocation\":{\"Channel\":0,\"Slot\":3}}") == 0;
+        fclose(f);
+        fclose(g);
+    }
+
+    /* Empty SET keeps the tree layout */
+    uint8_t empty[] = {0x01, 0x00, 0x00, 0x01, 0x05, 0x01, 0x04, 0x00, 0x01, 0x00};
+    char direct[64], tree[64];
+    FILE *f = tmpfile();
+    FILE *g = tmpfile();
+    if (f && g)
+    {
+        BejDecoder ctx;
+        bej_decoder_init(&ctx, empty, sizeof(empty));
+        bej_transcode_json(&ctx, main_dictionary, f, BEJ_JSON_PRETTY);
+        bej_decoder_init(&ctx, empty, sizeof(empty));
+        BejSet *root = bej_read_value(&ctx, main_dictionary);
+        bej_to_json_val(root, main_dictionary, g, 0);
+        bej_free(root);
+        read_back(f, direct, sizeof(direct));
+        read_back(g, tree, sizeof(tree));
+        passed = passed && strcmp(direct, tree) == 0;
+    }
+    else
+    {
+        passed = 0;
+    }
+    if (f) fclose(f);
+    if (g) fclose(g);
+
+    test_result("transcode: matches tree output", passed);
+}
+
+/* Test integer formatting - edge values */
+void test_json_itoa()
+{
+    char out[21];
+    int passed = 1;
+    const int64_t values[] = {0, 7, -1, 10, 99, 100, 1234567, -65536, INT64_MAX, INT64_MIN};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        char expect[32];
+        snprintf(expect, sizeof(expect), "%lld", (long long)values[i]);
+        size_t n = json_itoa(out, values[i]);
+        out[n] = '\0';
+        passed = passed && strcmp(out, expect) == 0;
+    }
+    test_result("json_writer: integer formatting", passed);
+}
+
+/* Test writer - escaping, growth and fd target */
+void test_json_writer()
+{
+    JsonWriter w;
+    json_writer_init_buffer(&w, JSON_COMPACT);
+    json_writer_begin_object(&w);
+    json_writer_key(&w, "k", 1);
+    json_writer_string(&w, "a\"b\\c\n\x01", 7);
+    json_writer_key(&w, "n", 1);
+    json_writer_integer(&w, -42);
+    json_writer_end_object(&w);
+    const char expect[] = "{\"k\":\"a\\\"b\\\\c\\n\\u0001\",\"n\":-42}";
+    int passed = w.len == strlen(expect) && memcmp(w.buf, expect, w.len) == 0;
+    json_writer_free(&w);
+
+    /* Output larger than one chunk keeps growing */
+    json_writer_init_buffer(&w, JSON_PRETTY);
+    for (int i = 0; i < 3 * JSON_WRITER_CHUNK; i++)
+        json_writer_raw(&w, "x", 1);
+    passed = passed && w.len == 3 * JSON_WRITER_CHUNK && w.error == 0;
+    json_writer_free(&w);
+
+    FILE *f = tmpfile();
+    char text[64] = {0};
+    if (f && json_writer_init_fd(&w, fileno(f), JSON_PRETTY) == 0)
+    {
+        json_writer_begin_object(&w);
+        json_writer_key(&w, "Slot", 4);
+        json_writer_integer(&w, 3);
+        json_writer_end_object(&w);
+        passed = passed && json_writer_flush(&w) == 0;
+        json_writer_free(&w);
+        read_back(f, text, sizeof(text));
+    }
+    if (f) fclose(f);
+    passed = passed && strcmp(text, "{\n  \"Slot\": 3\n}") == 0;
+
+    test_result("json_writer: escaping and targets", passed);
+}
+
 /* Test dictionary lookup - happy path */
 void test_dictionary_lookup() 
 {
@@ -103,16 +471,1499 @@ void test_dictionary_lookup()
                 name != NULL && strcmp(name, "CapacityMiB") == 0);
 }
 
+/* Test compiled dictionary - same answers as the scan, both directions */
+void test_dictionary_compile()
+{
+    BejDictionary dict[] = {
+        {7, "Seven", BEJ_INTEGER, NULL, NULL},
+        {2, "Two", BEJ_STRING, NULL, NULL},
+        {7, "Shadowed", BEJ_SET, NULL, NULL},
+        {300, "Wide", BEJ_SET, NULL, NULL},
+        {255, NULL, 0, NULL, NULL}
+    };
+
+    BejType type = BEJ_NULL;
+    int passed = bej_find_id_in_dictionary(dict, "Two", 3, &type) == 2 && type == BEJ_STRING;
+    passed = passed && bej_dictionary_compile(dict) == 0 && dict[0].index != NULL;
+
+    passed = passed && strcmp(bej_find_in_dictionary(dict, 7, &type), "Seven") == 0 && type == BEJ_INTEGER;
+    passed = passed && strcmp(bej_find_in_dictionary(dict, 300, NULL), "Wide") == 0;
+    passed = passed && bej_find_in_dictionary(dict, 3, NULL) == NULL;
+    passed = passed && bej_find_in_dictionary(dict, 4000, NULL) == NULL;
+    passed = passed && bej_find_id_in_dictionary(dict, "Shadowed", 8, &type) == 7 && type == BEJ_SET;
+    passed = passed && bej_find_id_in_dictionary(dict, "TwoX", 3, NULL) == 2;
+    passed = passed && bej_find_id_in_dictionary(dict, "Tw", 2, NULL) == -1;
+
+    bej_dictionary_release(dict);
+    passed = passed && dict[0].index == NULL &&
+             strcmp(bej_find_in_dictionary(dict, 300, NULL), "Wide") == 0;
+    test_result("dictionary: compiled lookups", passed);
+}
+
+/* Appends one DSP0218 entry, names are stored after all entries */
+static void put_dict_entry(uint8_t *out, uint16_t index, BejType type, uint16_t seq,
+                           uint16_t first_child, uint16_t child_count, const char *name, uint16_t *name_at)
+{
+    uint8_t *e = out + BEJ_DICT_HEADER_SIZE + index * BEJ_DICT_ENTRY_SIZE;
+    uint16_t child = child_count ? BEJ_DICT_HEADER_SIZE + first_child * BEJ_DICT_ENTRY_SIZE : 0;
+    uint8_t length = (uint8_t)(strlen(name) + 1);
+    e[0] = (uint8_t)(type << 4);
+    e[1] = seq & 0xFF; e[2] = seq >> 8;
+    e[3] = child & 0xFF; e[4] = child >> 8;
+    e[5] = child_count & 0xFF; e[6] = child_count >> 8;
+    e[7] = length;
+    e[8] = *name_at & 0xFF; e[9] = *name_at >> 8;
+    memcpy(out + *name_at, name, length);
+    *name_at += length;
+}
+
+/* Builds the Memory schema of main_dictionary as a DSP0218 binary */
+static size_t build_memory_dictionary(uint8_t *out, uint32_t version)
+{
+    uint16_t name_at = BEJ_DICT_HEADER_SIZE + 7 * BEJ_DICT_ENTRY_SIZE;
+    memset(out, 0, BEJ_DICT_HEADER_SIZE);
+    out[2] = 7;
+    out[4] = version & 0xFF; out[5] = (version >> 8) & 0xFF;
+    out[6] = (version >> 16) & 0xFF; out[7] = version >> 24;
+
+    put_dict_entry(out, 0, BEJ_SET, 0, 1, 4, "Memory", &name_at);
+    put_dict_entry(out, 1, BEJ_INTEGER, 1, 0, 0, "CapacityMiB", &name_at);
+    put_dict_entry(out, 2, BEJ_INTEGER, 2, 0, 0, "DataWidthBits", &name_at);
+    put_dict_entry(out, 3, BEJ_STRING, 3, 0, 0, "ErrorCorrection", &name_at);
+    put_dict_entry(out, 4, BEJ_SET, 4, 5, 2, "MemoryLocation", &name_at);
+    put_dict_entry(out, 5, BEJ_INTEGER, 1, 0, 0, "Channel", &name_at);
+    put_dict_entry(out, 6, BEJ_INTEGER, 2, 0, 0, "Slot", &name_at);
+    out[8] = name_at & 0xFF; out[9] = name_at >> 8;
+    return name_at;
+}
+
+/* Test DSP0218 loader - decodes like the built-in dictionaries */
+void test_dictionary_parse_binary()
+{
+    uint8_t binary[256];
+    size_t size = build_memory_dictionary(binary, 0x01020304);
+
+    BejSchemaDictionary dict;
+    int passed = bej_dictionary_parse(binary, size, &dict) == BEJ_OK &&
+                 strcmp(dict.schema, "Memory") == 0 && dict.version == 0x01020304;
+
+    BejDictionary *location = passed ? bej_dictionary_child(bej_dictionary_child(dict.root, 0), 4) : NULL;
+    passed = passed && location && strcmp(bej_find_in_dictionary(location, 2, NULL), "Slot") == 0;
+
+    char direct[256] = "", tree[256] = "";
+    FILE *f = tmpfile();
+    FILE *g = tmpfile();
+    if (passed && f && g)
+    {
+        BejDecoder ctx;
+        bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+        passed = bej_transcode_json(&ctx, dict.root, f, BEJ_JSON_COMPACT) == BEJ_OK;
+
+        bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+        BejSet *root = bej_read_value(&ctx, dict.root);
+        bej_to_json_compact(root, bej_dictionary_child(dict.root, 0), g);
+        bej_free(root);
+
+        read_back(f, direct, sizeof(direct));
+        read_back(g, tree, sizeof(tree));
+    }
+    if (f) fclose(f);
+    if (g) fclose(g);
+    passed = passed && strcmp(direct, tree) == 0 &&
+             strcmp(direct, "{\"CapacityMiB\":65536,\"DataWidthBits\":64,"
+                            "\"ErrorCorrection\":\"NoECC\","
+                            "\"MemoryLocation\":{\"Channel\":0,\"Slot\":3}}") == 0;
+    bej_dictionary_unload(&dict);
+
+    /* Child subset running past the entry table */
+    binary[BEJ_DICT_HEADER_SIZE + 4 * BEJ_DICT_ENTRY_SIZE + 5] = 3;
+    passed = passed && bej_dictionary_parse(binary, size, &dict) == BEJ_ERR_TRUNCATED;
+    /* Child pointer inside an entry */
+    binary[BEJ_DICT_HEADER_SIZE + 4 * BEJ_DICT_ENTRY_SIZE + 5] = 2;
+    binary[BEJ_DICT_HEADER_SIZE + 4 * BEJ_DICT_ENTRY_SIZE + 3] += 1;
+    passed = passed && bej_dictionary_parse(binary, size, &dict) == BEJ_ERR_SCHEMA;
+    passed = passed && bej_dictionary_parse(binary, 20, &dict) == BEJ_ERR_TRUNCATED;
+
+    test_result("dictionary_loader: DSP0218 binary", passed);
+}
+
+/* Test dictionary cache - one load per schema and version */
+void test_dictionary_cache()
+{
+    uint8_t binary[256];
+    size_t size = build_memory_dictionary(binary, 7);
+    char path[] = "/tmp/bej_dictXXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!f)
+    {
+        test_result("dictionary_loader: cache", 0);
+        return;
+    }
+    fwrite(binary, 1, size, f);
+    fclose(f);
+
+    BejDictCache cache;
+    bej_dict_cache_init(&cache);
+    BejSchemaDictionary *first = NULL, *second = NULL, *other = NULL;
+    int passed = bej_dict_cache_load(&cache, "Memory", 7, path, &first) == BEJ_OK &&
+                 first->mapping.data != NULL;
+    passed = passed && bej_dict_cache_load(&cache, "Memory", 8, path, &other) == BEJ_ERR_SCHEMA &&
+             bej_dict_cache_load(&cache, "Processor", 7, path, &other) == BEJ_ERR_SCHEMA;
+    remove(path);
+
+    /* Served from the cache, the file is gone */
+    passed = passed && bej_dict_cache_load(&cache, "Memory", 7, path, &second) == BEJ_OK &&
+             second == first && bej_dict_cache_find(&cache, "Memory", 7) == first;
+    passed = passed && bej_dict_cache_find(&cache, "Memory", 8) == NULL;
+    bej_dict_cache_destroy(&cache);
+
+    test_result("dictionary_loader: cache", passed && cache.head == NULL);
+}
+
+/* Test encoder - tree and text give the same minimal BEJ */
+void test_encode_memory()
+{
+    const char *json = "{\"CapacityMiB\": 65536, \"DataWidthBits\": 64,\n"
+                       " \"ErrorCorrection\": \"NoECC\",\n"
+                       " \"MemoryLocation\": {\"Channel\": 0, \"Slot\": 3}}";
+    const uint8_t expected[] = {
+        0x01, 0x00, 0x00, 0x01, 0x29,
+        0x01, 0x01, 0x03, 0x01, 0x03, 0x00, 0x00, 0x01,
+        0x01, 0x02, 0x03, 0x01, 0x01, 0x40,
+        0x01, 0x03, 0x05, 0x01, 0x05, 'N', 'o', 'E', 'C', 'C',
+        0x01, 0x04, 0x00, 0x01, 0x0C,
+        0x01, 0x01, 0x03, 0x01, 0x01, 0x00,
+        0x01, 0x02, 0x03, 0x01, 0x01, 0x03
+    };
+
+    const char *text = json;
+    BejSet *tree = json_read_value(&text);
+    BejEncoder enc;
+    bej_encoder_init(&enc, 16);
+    int passed = tree && bej_encode_tree(&enc, tree, main_dictionary) == BEJ_OK &&
+                 enc.len == sizeof(expected) && memcmp(enc.buf, expected, enc.len) == 0;
+    json_free(tree);
+
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, json, main_dictionary) == BEJ_OK &&
+             enc.len == sizeof(expected) && memcmp(enc.buf, expected, enc.len) == 0;
+    bej_encoder_free(&enc);
+
+    /* Same output without any allocation */
+    uint8_t out[sizeof(expected)];
+    bej_encoder_init_buffer(&enc, out, sizeof(out));
+    passed = passed && bej_encode_json(&enc, json, main_dictionary) == BEJ_OK &&
+             memcmp(out, expected, sizeof(out)) == 0;
+    bej_encoder_init_buffer(&enc, out, sizeof(out) - 1);
+    passed = passed && bej_encode_json(&enc, json, main_dictionary) == BEJ_ERR_LENGTH;
+
+    test_result("encode: tree and text", passed);
+}
+
+/* Test encoder - long lengths, negatives, escapes and errors */
+void test_encode_backpatch()
+{
+    char json[512];
+    char long_value[301];
+    memset(long_value, 'a', 300);
+    long_value[300] = '\0';
+    snprintf(json, sizeof(json), "{\"ErrorCorrection\":\"%s\\\"\\u00e9\",\"CapacityMiB\":-2,"
+             "\"MemoryLocation\":{\"Slot\":-129}}", long_value);
+
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    int passed = bej_encode_json(&enc, json, main_dictionary) == BEJ_OK &&
+                 enc.buf[3] == 0x02 && enc.buf[4] == ((enc.len - 6) & 0xFF) && enc.buf[5] == (enc.len - 6) >> 8;
+
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
+    passed = passed && root && ctx.cursor == ctx.end && root->object_value.count == 3;
+    if (passed)
+    {
+        BejSet *str = root->object_value.pairs[0].value;
+        BejSet *slot = root->object_value.pairs[2].value->object_value.pairs[0].value;
+        passed = str->string_value.length == 303 && memcmp(str->string_value.data + 299, "a\"\xC3\xA9", 4) == 0 &&
+                 root->object_value.pairs[1].value->integer_value == -2 &&
+                 slot->integer_value == -129;
+    }
+    bej_free(root);
+
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{\"Speed\":1}", main_dictionary) == BEJ_ERR_SCHEMA;
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{\"CapacityMiB\":\"1\"}", main_dictionary) == BEJ_ERR_TYPE;
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{\"CapacityMiB\":1", main_dictionary) == BEJ_ERR_SYNTAX;
+    bej_encoder_free(&enc);
+
+    test_result("encode: backpatched lengths", passed);
+}
+
+/* Schema with every BEJ type, element entries and enum options come first in their tables */
+static BejDictionary typed_memory_types[] = {
+    {0, "DRAM", BEJ_STRING, NULL, NULL},
+    {1, "NVDIMM_N", BEJ_STRING, NULL, NULL},
+    {255, NULL, 0, NULL, NULL}
+};
+static BejDictionary typed_speeds[] = {
+    {0, "", BEJ_INTEGER, NULL, NULL},
+    {255, NULL, 0, NULL, NULL}
+};
+static BejDictionary typed_locations[] = {
+    {0, "", BEJ_SET, child_dictionary, NULL},
+    {255, NULL, 0, NULL, NULL}
+};
+static BejDictionary typed_dictionary[] = {
+    {0, "root", BEJ_SET, typed_dictionary, NULL},
+    {1, "AllowedSpeedsMHz", BEJ_ARRAY, typed_speeds, NULL},
+    {2, "Enabled", BEJ_BOOLEAN, NULL, NULL},
+    {3, "MemoryType", BEJ_ENUM, typed_memory_types, NULL},
+    {4, "VoltageV", BEJ_REAL, NULL, NULL},
+    {5, "SerialNumber", BEJ_STRING, NULL, NULL},
+    {6, "Locations", BEJ_ARRAY, typed_locations, NULL},
+    {255, NULL, 0, NULL, NULL}
+};
+
+/* Test every type - JSON to BEJ and back through the tree and the transcoder */
+void test_all_types_round_trip()
+{
+    const char *json = "{\"AllowedSpeedsMHz\":[2400,2933,3200],\"Enabled\":true,\"MemoryType\":\"NVDIMM_N\","
+                       "\"VoltageV\":1.2,\"SerialNumber\":null,"
+                       "\"Locations\":[{\"Channel\":0,\"Slot\":3},{\"Channel\":1,\"Slot\":-1}]}";
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    int passed = bej_encode_json(&enc, json, typed_dictionary) == BEJ_OK;
+
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    BejSet *root = bej_read_value(&ctx, typed_dictionary);
+    passed = passed && root && ctx.cursor == ctx.end && root->object_value.count == 6;
+    if (passed)
+    {
+        JsonPair *pairs = root->object_value.pairs;
+        BejSet *speeds = pairs[0].value;
+        BejSet *locations = pairs[5].value;
+        passed = speeds->type == BEJ_ARRAY && speeds->object_value.count == 3 &&
+                 speeds->object_value.pairs[2].id == 2 &&
+                 speeds->object_value.pairs[2].value->integer_value == 3200 &&
+                 pairs[1].value->type == BEJ_BOOLEAN && pairs[1].value->boolean_value == 1 &&
+                 pairs[2].value->type == BEJ_ENUM && pairs[2].value->enum_value == 1 &&
+                 pairs[3].value->type == BEJ_REAL && pairs[3].value->real_value == 1.2 &&
+                 pairs[4].value->type == BEJ_NULL &&
+                 locations->object_value.count == 2 &&
+                 locations->object_value.pairs[1].value->object_value.pairs[1].value->integer_value == -1;
+    }
+
+    JsonWriter tree, direct;
+    json_writer_init_buffer(&tree, JSON_COMPACT);
+    json_writer_init_buffer(&direct, JSON_COMPACT);
+    bej_to_json_writer(root, bej_dictionary_child(typed_dictionary, 0), &tree);
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    passed = passed && bej_transcode_writer(&ctx, typed_dictionary, &direct) == BEJ_OK &&
+             tree.len == strlen(json) && memcmp(tree.buf, json, tree.len) == 0 &&
+             direct.len == tree.len && memcmp(direct.buf, tree.buf, tree.len) == 0;
+    json_writer_free(&tree);
+    json_writer_free(&direct);
+    bej_free(root);
+
+    /* Empty array, and a real that needs 17 digits */
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{\"AllowedSpeedsMHz\":[],\"VoltageV\":0.30000000000000004}", typed_dictionary) == BEJ_OK;
+    json_writer_init_buffer(&direct, JSON_COMPACT);
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    passed = passed && bej_transcode_writer(&ctx, typed_dictionary, &direct) == BEJ_OK &&
+             direct.len == strlen("{\"AllowedSpeedsMHz\":[],\"VoltageV\":0.30000000000000004}") &&
+             memcmp(direct.buf, "{\"AllowedSpeedsMHz\":[],\"VoltageV\":0.30000000000000004}", direct.len) == 0;
+    json_writer_free(&direct);
+
+    /* Reals keep a '.' under a locale with a decimal comma, when one is installed */
+    if (setlocale(LC_NUMERIC, "de_DE.UTF-8") || setlocale(LC_NUMERIC, "fr_FR.UTF-8"))
+    {
+        bej_encoder_reset(&enc);
+        passed = passed && bej_encode_json(&enc, "{\"VoltageV\":1.25e-3}", typed_dictionary) == BEJ_OK;
+        json_writer_init_buffer(&direct, JSON_COMPACT);
+        bej_decoder_init(&ctx, enc.buf, enc.len);
+        passed = passed && bej_transcode_writer(&ctx, typed_dictionary, &direct) == BEJ_OK &&
+                 direct.len == strlen("{\"VoltageV\":0.00125}") &&
+                 memcmp(direct.buf, "{\"VoltageV\":0.00125}", direct.len) == 0;
+        json_writer_free(&direct);
+        setlocale(LC_NUMERIC, "C");
+    }
+    bej_encoder_free(&enc);
+
+    test_result("types: arrays, enums, null, boolean and real round trip", passed);
+}
+
+/* Test every type - malformed payloads and values outside the schema */
+void test_all_types_errors()
+{
+    BejDecoder ctx;
+    int passed = 1;
+
+    /* Unknown option is emitted as UNKNOWN, unknown type fails */
+    uint8_t option[] = {0x01, 0x00, 0x00, 0x01, 0x07, 0x01, 0x03, 0x04, 0x01, 0x02, 0x01, 0x07};
+    bej_decoder_init(&ctx, option, sizeof(option));
+    BejSet *root = bej_read_value(&ctx, typed_dictionary);
+    JsonWriter w;
+    json_writer_init_buffer(&w, JSON_COMPACT);
+    bej_to_json_writer(root, typed_dictionary, &w);
+    passed = passed && root && w.len == strlen("{\"MemoryType\":\"UNKNOWN\"}") &&
+             memcmp(w.buf, "{\"MemoryType\":\"UNKNOWN\"}", w.len) == 0;
+    json_writer_free(&w);
+    bej_free(root);
+
+    uint8_t bad_type[] = {0x01, 0x00, 0x00, 0x01, 0x05, 0x01, 0x02, 0x09, 0x01, 0x00};
+    bej_decoder_init(&ctx, bad_type, sizeof(bad_type));
+    passed = passed && !bej_read_value(&ctx, typed_dictionary) && ctx.error == BEJ_ERR_TYPE;
+
+    uint8_t bad_boolean[] = {0x01, 0x02, 0x07, 0x01, 0x02, 0x01, 0x00};
+    bej_decoder_init(&ctx, bad_boolean, sizeof(bad_boolean));
+    passed = passed && !bej_read_value(&ctx, typed_dictionary) && ctx.error == BEJ_ERR_LENGTH;
+
+    /* Count larger than the elements can take, and bytes left after them */
+    uint8_t bad_count[] = {0x01, 0x01, 0x01, 0x01, 0x06, 0x01, 0x05, 0x00, 0x00, 0x00, 0x00};
+    bej_decoder_init(&ctx, bad_count, sizeof(bad_count));
+    passed = passed && !bej_read_value(&ctx, typed_dictionary) && ctx.error == BEJ_ERR_TRUNCATED;
+
+    uint8_t extra[] = {0x01, 0x01, 0x01, 0x01, 0x09, 0x01, 0x01, 0x01, 0x00, 0x03, 0x01, 0x01, 0x05, 0x00};
+    bej_decoder_init(&ctx, extra, sizeof(extra));
+    passed = passed && !bej_read_value(&ctx, typed_dictionary) && ctx.error == BEJ_ERR_LENGTH;
+    BejSaxCallbacks none = {0};
+    bej_decoder_init(&ctx, extra, sizeof(extra));
+    passed = passed && bej_sax_parse(&ctx, typed_dictionary, &none, NULL) == BEJ_ERR_LENGTH;
+
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    passed = passed && bej_encode_json(&enc, "{\"MemoryType\":\"SRAM\"}", typed_dictionary) == BEJ_ERR_SCHEMA;
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{\"Enabled\":1}", typed_dictionary) == BEJ_ERR_TYPE;
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{\"AllowedSpeedsMHz\":[1,]}", typed_dictionary) == BEJ_ERR_SYNTAX;
+    bej_encoder_free(&enc);
+
+    test_result("types: malformed payloads", passed);
+}
+
+/* Rebuilds JSON text from SAX events */
+static BejSaxAction sax_json_start_set(void *user)
+{
+    json_writer_begin_object(user);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_end_set(void *user)
+{
+    json_writer_end_object(user);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_property(void *user, uint16_t id, const char *name, BejType type)
+{
+    (void)id;
+    (void)type;
+    json_writer_key(user, name ? name : "UNKNOWN", name ? strlen(name) : 7);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_integer(void *user, int64_t value)
+{
+    json_writer_integer(user, value);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_string(void *user, const char *value, uint32_t length)
+{
+    json_writer_string(user, value, length);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_start_array(void *user, uint16_t count)
+{
+    (void)count;
+    json_writer_begin_array(user);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_end_array(void *user)
+{
+    json_writer_end_array(user);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_element(void *user, uint16_t index, BejType type)
+{
+    (void)index;
+    (void)type;
+    json_writer_element(user);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_null(void *user)
+{
+    json_writer_null(user);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_boolean(void *user, int value)
+{
+    json_writer_boolean(user, value);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_real(void *user, double value)
+{
+    json_writer_real(user, value);
+    return BEJ_SAX_CONTINUE;
+}
+
+static BejSaxAction sax_json_enum(void *user, uint16_t option, const char *name)
+{
+    (void)option;
+    json_writer_string(user, name ? name : "UNKNOWN", name ? strlen(name) : 7);
+    return BEJ_SAX_CONTINUE;
+}
+
+static const BejSaxCallbacks sax_json_cb = {
+    sax_json_start_set, sax_json_end_set, sax_json_property, sax_json_integer, sax_json_string,
+    sax_json_start_array, sax_json_end_array, sax_json_element, sax_json_null, sax_json_boolean,
+    sax_json_real, sax_json_enum
+};
+
+/* Pushes a message in chunks of the given size and returns the first error */
+static BejError push_chunked(BejPushDecoder *push, const uint8_t *data, size_t size, size_t chunk)
+{
+    for (size_t i = 0; i < size; i += chunk)
+        bej_push_feed(push, data + i, size - i < chunk ? size - i : chunk);
+    return bej_push_finish(push);
+}
+
+/* Test every type - the tape and push decoders produce the same JSON as the tree */
+void test_all_types_tape_push()
+{
+    const char *json = "{\"AllowedSpeedsMHz\":[2400,2933,3200],\"Enabled\":false,\"MemoryType\":\"DRAM\","
+                       "\"VoltageV\":-0.25,\"SerialNumber\":null,"
+                       "\"Locations\":[{\"Channel\":0,\"Slot\":3},{\"Channel\":1,\"Slot\":-1}]}";
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    int passed = bej_encode_json(&enc, json, typed_dictionary) == BEJ_OK;
+
+    BejDecoder ctx;
+    BejTape tape;
+    JsonWriter w;
+    bej_tape_init(&tape);
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    json_writer_init_buffer(&w, JSON_COMPACT);
+    passed = passed && bej_tape_decode(&ctx, &tape) == BEJ_OK;
+    if (passed)
+    {
+        uint32_t speeds = bej_tape_find(&tape, 0, 1);
+        uint32_t last = bej_tape_next_sibling(&tape, bej_tape_next_sibling(&tape, bej_tape_first_child(&tape, speeds)));
+        passed = tape.entries[speeds].type == BEJ_ARRAY && tape.entries[speeds].value.count == 3 &&
+                 tape.entries[last].id == 2 && tape.entries[last].value.integer == 3200 &&
+                 bej_tape_next_sibling(&tape, last) == BEJ_TAPE_NONE &&
+                 tape.entries[bej_tape_find(&tape, 0, 4)].value.real == -0.25;
+        bej_tape_to_json_writer(&tape, 0, bej_dictionary_child(typed_dictionary, 0), &w);
+        passed = passed && w.len == strlen(json) && memcmp(w.buf, json, w.len) == 0;
+    }
+    json_writer_free(&w);
+
+    size_t chunks[] = {1, 5, enc.len};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        BejPushDecoder push;
+        json_writer_init_buffer(&w, JSON_COMPACT);
+        bej_push_init(&push, typed_dictionary, &sax_json_cb, &w);
+        passed = passed && push_chunked(&push, enc.buf, enc.len, chunks[i]) == BEJ_OK &&
+                 push.offset == enc.len && w.len == strlen(json) && memcmp(w.buf, json, w.len) == 0;
+        bej_push_free(&push);
+        json_writer_free(&w);
+    }
+    bej_encoder_free(&enc);
+
+    /* Same errors as the tree decoder */
+    static const struct
+    {
+        uint8_t data[16];
+        size_t size;
+        BejError error;
+    } bad[] = {
+        {{0x01, 0x02, 0x07, 0x01, 0x02, 0x01, 0x00}, 7, BEJ_ERR_LENGTH},
+        {{0x01, 0x04, 0x06, 0x01, 0x07, 0, 0, 0, 0, 0, 0, 0}, 12, BEJ_ERR_LENGTH},
+        {{0x01, 0x02, 0x02, 0x01, 0x01, 0x00}, 6, BEJ_ERR_LENGTH},
+        {{0x01, 0x03, 0x04, 0x01, 0x00}, 5, BEJ_ERR_TRUNCATED},
+        {{0x01, 0x03, 0x04, 0x01, 0x03, 0x01, 0x01, 0x00}, 8, BEJ_ERR_LENGTH},
+        {{0x01, 0x01, 0x01, 0x01, 0x06, 0x01, 0x05, 0x00, 0x00, 0x00, 0x00}, 11, BEJ_ERR_TRUNCATED},
+        {{0x01, 0x01, 0x01, 0x01, 0x09, 0x01, 0x01, 0x01, 0x00, 0x03, 0x01, 0x01, 0x05, 0x00}, 14, BEJ_ERR_LENGTH},
+        {{0x01, 0x00, 0x08, 0x01, 0x00}, 5, BEJ_ERR_TYPE},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        bej_decoder_init(&ctx, bad[i].data, bad[i].size);
+        BejSet *root = bej_read_value(&ctx, typed_dictionary);
+        passed = passed && !root && ctx.error == bad[i].error;
+        bej_free(root);
+
+        bej_decoder_init(&ctx, bad[i].data, bad[i].size);
+        passed = passed && bej_tape_decode(&ctx, &tape) == bad[i].error;
+
+        BejPushDecoder push;
+        json_writer_init_buffer(&w, JSON_COMPACT);
+        bej_push_init(&push, typed_dictionary, &sax_json_cb, &w);
+        passed = passed && push_chunked(&push, bad[i].data, bad[i].size, 1) == bad[i].error;
+        bej_push_free(&push);
+        json_writer_free(&w);
+    }
+    bej_tape_free(&tape);
+
+    test_result("types: tape and push decoders", passed);
+}
+
+/* Test nnint IDs and lengths - size byte, then little-endian value bytes */
+void test_read_nnint()
+{
+    uint8_t data[] = {0x02, 0x81, 0x00, 0x05, 0x02, 0x00, 0x01, 'x', 'x'};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, data, sizeof(data) - 1);
+    uint16_t id = 0;
+    uint8_t type = 0;
+    uint32_t length = 0;
+    int passed = bej_read_tag(&ctx, &id, &type) && id == 129 && type == BEJ_STRING &&
+                 !bej_read_length(&ctx, &length) && ctx.error == BEJ_ERR_TRUNCATED;
+
+    uint8_t huge[] = {0x01, 0x00, 0x05, 0x05, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F};
+    bej_decoder_init(&ctx, huge, sizeof(huge));
+    passed = passed && bej_read_tag(&ctx, &id, &type) && !bej_read_length(&ctx, &length) &&
+             ctx.error == BEJ_ERR_LENGTH && ctx.error_offset == 3;
+
+    uint8_t wide_id[] = {0x03, 0x00, 0x00, 0x01, 0x05, 0x01, 0x00};
+    bej_decoder_init(&ctx, wide_id, sizeof(wide_id));
+    passed = passed && !bej_read_tag(&ctx, &id, &type) && ctx.error == BEJ_ERR_LENGTH;
+    test_result("read_length: nnint", passed);
+}
+
+/* Test tape - navigation and the same JSON as the transcoder */
+void test_tape_decode()
+{
+    BejTape tape;
+    bej_tape_init(&tape);
+    BejDecoder ctx;
+    int passed = 1;
+
+    /* Decoding twice reuses the entries */
+    for (int round = 0; round < 2; round++)
+    {
+        bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+        passed = passed && bej_tape_decode(&ctx, &tape) == BEJ_OK && tape.count == 9 &&
+                 tape.entries[0].end == 9 && tape.entries[0].value.count == 4;
+    }
+
+    uint32_t location = bej_tape_find(&tape, 0, 4);
+    uint32_t slot = location != BEJ_TAPE_NONE ? bej_tape_find(&tape, location, 2) : BEJ_TAPE_NONE;
+    uint32_t ecc = bej_tape_find(&tape, 0, 3);
+    uint32_t length = 0;
+    passed = passed && location == 4 && slot == 6 && tape.entries[slot].value.integer == 3 &&
+             bej_tape_next_sibling(&tape, location) == BEJ_TAPE_NONE &&
+             bej_tape_next_sibling(&tape, 0) == BEJ_TAPE_NONE &&
+             bej_tape_first_child(&tape, slot) == BEJ_TAPE_NONE &&
+             bej_tape_find(&tape, 0, 9) == BEJ_TAPE_NONE &&
+             memcmp(bej_tape_string(&tape, ecc, &length), "NoECC", 5) == 0 && length == 5;
+
+    /* Both emitters take the members of the root entry */
+    BejDictionary *members = bej_dictionary_child(main_dictionary, 0);
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
+    for (int style = BEJ_JSON_PRETTY; style <= BEJ_JSON_COMPACT; style++)
+    {
+        JsonWriter direct, tree, flat;
+        json_writer_init_buffer(&direct, style);
+        json_writer_init_buffer(&tree, style);
+        json_writer_init_buffer(&flat, style);
+        bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+        bej_transcode_writer(&ctx, main_dictionary, &direct);
+        bej_to_json_writer(root, members, &tree);
+        bej_tape_to_json_writer(&tape, 0, members, &flat);
+        passed = passed && direct.len == flat.len && memcmp(direct.buf, flat.buf, flat.len) == 0 &&
+                 tree.len == flat.len && memcmp(tree.buf, flat.buf, flat.len) == 0;
+        json_writer_free(&direct);
+        json_writer_free(&tree);
+        json_writer_free(&flat);
+    }
+    bej_free(root);
+
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data) - 1);
+    passed = passed && bej_tape_decode(&ctx, &tape) == BEJ_ERR_TRUNCATED;
+
+    /* String offsets are 32-bit, larger inputs are refused before any read */
+    if (sizeof(size_t) > sizeof(uint32_t))
+    {
+        bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+        ctx.end = ctx.start + ((size_t)UINT32_MAX + 1);
+        passed = passed && bej_tape_decode(&ctx, &tape) == BEJ_ERR_LENGTH &&
+                 ctx.error_offset == 0 && tape.count == 0;
+    }
+    bej_tape_free(&tape);
+
+    test_result("tape: navigation and emitter", passed);
+}
+
+/* Test exact-size pair arrays - large and empty SETs */
+void test_read_object_exact()
+{
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    size_t root = bej_encode_begin_set(&enc, 0);
+    for (uint16_t i = 0; i < 40; i++)
+        bej_encode_integer(&enc, i, i);
+    size_t empty = bej_encode_begin_set(&enc, 40);
+    bej_encode_end_set(&enc, empty);
+    bej_encode_end_set(&enc, root);
+
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    BejSet *val = bej_read_value(&ctx, main_dictionary);
+    int passed = val && val->object_value.count == 41 &&
+                 val->object_value.pairs[39].value->integer_value == 39 &&
+                 val->object_value.pairs[40].value->object_value.count == 0 &&
+                 val->object_value.pairs[40].value->object_value.pairs == NULL &&
+                 ctx.stats.bytes_allocated == sizeof(BejSet) * 42 + sizeof(JsonPair) * 41;
+    bej_free(val);
+    bej_encoder_free(&enc);
+
+    /* JSON objects grow past their initial pair array */
+    char json[1024] = "{";
+    for (int i = 0; i < 40; i++)
+    {
+        char member[32];
+        snprintf(member, sizeof(member), "%s\"k%d\": %d", i ? ", " : "", i, i);
+        strcat(json, member);
+    }
+    strcat(json, "}");
+    const char *text = json;
+    BejSet *obj = json_read_value(&text);
+    passed = passed && obj && obj->object_value.count == 40 &&
+             strcmp(obj->object_value.pairs[39].key, "k39") == 0 &&
+             obj->object_value.pairs[39].value->integer_value == 39;
+    json_free(obj);
+
+    test_result("read_object: exact-size pairs", passed);
+}
+
+/* Test scanning kernels - every supported one agrees with the scalar one */
+void test_json_scan()
+{
+    char buf[160];
+    int passed = 1;
+    JsonScanImpl detected = json_scan_impl();
+
+    for (int impl = JSON_SCAN_SCALAR; impl <= JSON_SCAN_AVX2; impl++)
+    {
+        if (json_scan_use((JsonScanImpl)impl) != 0)
+            continue;
+
+        /* Every start alignment and stop position within two blocks */
+        for (int start = 0; start < 40; start++)
+        {
+            for (int stop = start; stop < start + 70; stop++)
+            {
+                memset(buf, 'a', sizeof(buf));
+                for (int i = start; i < stop; i++)
+                    buf[i] = " \t\n\r"[i % 4];
+                buf[stop] = 'x';
+                buf[stop + 1] = '\0';
+                passed = passed && json_scan_spaces(buf + start) == buf + stop;
+
+                memset(buf, 'a', sizeof(buf));
+                buf[stop] = "\"\\"[stop % 2];
+                buf[stop + 1] = '\0';
+                passed = passed && json_scan_string_run(buf + start) == buf + stop;
+                buf[stop] = '\0';
+                passed = passed && json_scan_string_run(buf + start) == buf + stop;
+            }
+        }
+
+        int escaped;
+        const char *text = "ab\\\"c\\\\\" tail";
+        passed = passed && json_scan_string(text, &escaped) == text + 7 && escaped;
+        text = "plain\"";
+        passed = passed && json_scan_string(text, &escaped) == text + 5 && !escaped;
+        passed = passed && json_scan_string("open\\", &escaped) == NULL;
+    }
+    passed = passed && json_scan_use(detected) == 0;
+
+    test_result("json_scan: kernels agree", passed);
+}
+
+/* Test JSON string escapes - decoded by the tree parser and the encoder */
+void test_json_escapes()
+{
+    const char *text = "\"a\\\"b\\\\c\\/d\\n\\t\\u00e9\\u20ac\\ud83d\\ude00\"";
+    const char *expected = "a\"b\\c/d\n\t\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+    char *value = json_read_string(&text);
+    int passed = value && strcmp(value, expected) == 0 && *text == '\0';
+    free(value);
+
+    text = "\"bad \\x escape\"";
+    passed = passed && json_read_string(&text) == NULL;
+    text = "\"unterminated";
+    passed = passed && json_read_string(&text) == NULL;
+
+    /* NUL and unpaired surrogates have no place in the null-terminated UTF-8 result */
+    const char *invalid[] = {"\"a\\u0000b\"", "\"\\ud800\"", "\"\\ud800x\"", "\"\\ud800\\u0041\"",
+                             "\"\\udc00\"", "\"\\ude00\\ud83d\""};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        text = invalid[i];
+        passed = passed && json_read_string(&text) == NULL;
+    }
+
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    passed = passed && bej_encode_json(&enc, "{\"ErrorCorrection\": \"bad \\q\"}",
+                                       main_dictionary) == BEJ_ERR_SYNTAX;
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{\"ErrorCorrection\": \"\\ud83d\"}",
+                                       main_dictionary) == BEJ_ERR_SYNTAX;
+    bej_encoder_reset(&enc);
+    passed = passed && bej_encode_json(&enc, "{ \"ErrorCorrection\" : \"x\\u0041\\n\" }",
+                                       main_dictionary) == BEJ_OK;
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, enc.buf, enc.len);
+    BejSet *val = bej_read_value(&ctx, main_dictionary);
+    passed = passed && val && val->object_value.count == 1 &&
+             val->object_value.pairs[0].value->string_value.length == 3 &&
+             memcmp(val->object_value.pairs[0].value->string_value.data, "xA\n", 3) == 0;
+    bej_free(val);
+    bej_encoder_free(&enc);
+
+    test_result("json_scan: string escapes", passed);
+}
+
+/* Test path queries - only the target value is decoded */
+void test_query_path()
+{
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    BejSet *slot = bej_query(&ctx, main_dictionary, "/MemoryLocation/Slot");
+    int passed = slot && slot->type == BEJ_INTEGER && slot->integer_value == 3 &&
+                 ctx.stats.values == 1 && ctx.cursor == ctx.end;
+    bej_free(slot);
+
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    BejSet *ecc = bej_query(&ctx, main_dictionary, "ErrorCorrection");
+    passed = passed && ecc && ecc->string_value.length == 5 && memcmp(ecc->string_value.data, "NoECC", 5) == 0;
+    bej_free(ecc);
+
+    BejDictionary *entry_dict;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    passed = passed && bej_query_locate(&ctx, main_dictionary, "/MemoryLocation", &entry_dict) == BEJ_OK &&
+             entry_dict == main_dictionary && ctx.cursor == memory_data + 30;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    passed = passed && bej_query_locate(&ctx, main_dictionary, "/", NULL) == BEJ_OK &&
+             ctx.cursor == memory_data;
+
+    /* Unknown names, absent values and paths through leaves */
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    passed = passed && bej_query(&ctx, main_dictionary, "/Speed") == NULL && ctx.error == BEJ_ERR_SCHEMA;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    passed = passed && bej_query(&ctx, main_dictionary, "/CapacityMiB/Slot") == NULL &&
+             ctx.error == BEJ_ERR_NOT_FOUND;
+    bej_decoder_init(&ctx, memory_data, 30);
+    passed = passed && bej_query(&ctx, main_dictionary, "/MemoryLocation") == NULL &&
+             ctx.error == BEJ_ERR_TRUNCATED;
+
+    uint8_t partial[] = {0x01, 0x00, 0x00, 0x01, 0x06, 0x01, 0x01, 0x03, 0x01, 0x01, 0x08};
+    bej_decoder_init(&ctx, partial, sizeof(partial));
+    passed = passed && bej_query(&ctx, main_dictionary, "/DataWidthBits") == NULL &&
+             ctx.error == BEJ_ERR_NOT_FOUND;
+
+    test_result("query: path lookup", passed);
+}
+
+/* Collects the strings reported by the push decoder */
+static BejSaxAction push_string(void *user, const char *value, uint32_t length)
+{
+    char *out = user;
+    memcpy(out, value, length);
+    out[length] = '\0';
+    return BEJ_SAX_CONTINUE;
+}
+
+/* Test bej_read_integer - signed values of every width, away from and at the buffer end */
+void test_read_integer_widths()
+{
+    static const struct
+    {
+        uint8_t bytes[9];
+        uint32_t length;
+        int64_t expected;
+    } cases[] = {
+        {{0}, 0, 0},
+        {{0x7F}, 1, 127},
+        {{0x80}, 1, -128},
+        {{0xFF, 0xFF}, 2, -1},
+        {{0x00, 0x80, 0x00}, 3, 32768},
+        {{0x00, 0x00, 0x00, 0x80}, 4, INT32_MIN},
+        {{0x00, 0x00, 0x00, 0x00, 0x01}, 5, 4294967296LL},
+        {{0xFF, 0xFF, 0xFF, 0xFF, 0xFE}, 5, -4294967297LL},
+        {{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F}, 8, INT64_MAX},
+        {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80}, 8, INT64_MIN},
+        {{0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 9, -2},
+    };
+    int passed = 1;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        uint8_t data[2 + 9 + 8];
+        memset(data, 0xAA, sizeof(data));
+        data[0] = 1;
+        data[1] = (uint8_t)cases[i].length;
+        memcpy(data + 2, cases[i].bytes, cases[i].length);
+
+        /* Padded input takes the 8-byte load, the exact size the byte loop */
+        for (size_t pad = 0; pad <= 8; pad += 8)
+        {
+            BejDecoder ctx;
+            bej_decoder_init(&ctx, data, 2 + cases[i].length + pad);
+            passed = passed && bej_read_integer(&ctx) == cases[i].expected && ctx.error == BEJ_OK &&
+                     ctx.cursor == data + 2 + cases[i].length;
+        }
+    }
+
+    uint8_t wide[] = {0x01, 0x09, 0, 0, 0, 0, 0, 0, 0, 0, 0x01};
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, wide, sizeof(wide));
+    passed = passed && bej_read_integer(&ctx) == 0 && ctx.error == BEJ_ERR_LENGTH;
+
+    /* Push decoder, 8-byte -2 then a value wider than 64 bits */
+    uint8_t message[] = {0x01, 0x00, 0x00, 0x01, 0x0D, 0x01, 0x01, 0x03, 0x01, 0x08,
+                         0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    SaxCounter counter = {0};
+    BejPushDecoder push;
+    bej_push_init(&push, main_dictionary, &sax_counter_cb, &counter);
+    for (size_t i = 0; i < sizeof(message); i++)
+        bej_push_feed(&push, message + i, 1);
+    passed = passed && bej_push_finish(&push) == BEJ_OK && counter.sum == -2;
+    bej_push_free(&push);
+
+    uint8_t overflow[] = {0x01, 0x00, 0x00, 0x01, 0x0E, 0x01, 0x01, 0x03, 0x01, 0x09,
+                          0, 0, 0, 0, 0, 0, 0, 0x80, 0x00};
+    bej_push_init(&push, main_dictionary, &sax_counter_cb, &counter);
+    passed = passed && bej_push_feed(&push, overflow, sizeof(overflow)) == BEJ_ERR_LENGTH &&
+             push.error_offset == sizeof(overflow) - 1;
+    bej_push_free(&push);
+
+    test_result("read_integer: widths and signs", passed);
+}
+
+/* Test push decoder - any split of the input gives the same events */
+void test_push_chunks()
+{
+    BejPushDecoder push;
+    int passed = 1;
+
+    for (size_t split = 0; split <= sizeof(memory_data); split++)
+    {
+        SaxCounter all = {0};
+        bej_push_init(&push, main_dictionary, &sax_counter_cb, &all);
+        passed = passed && bej_push_feed(&push, memory_data, split) == BEJ_OK &&
+                 bej_push_feed(&push, memory_data + split, sizeof(memory_data) - split) == BEJ_OK &&
+                 bej_push_finish(&push) == BEJ_OK && push.offset == sizeof(memory_data) &&
+                 all.sets == 2 && all.ends == 2 && all.sum == 65536 + 64 + 3 && all.strings == 1;
+        bej_push_free(&push);
+    }
+
+    /* One byte at a time, skipping a SET */
+    SaxCounter skipped = {0};
+    skipped.skip = "MemoryLocation";
+    bej_push_init(&push, main_dictionary, &sax_counter_cb, &skipped);
+    for (size_t i = 0; i < sizeof(memory_data); i++)
+        bej_push_feed(&push, memory_data + i, 1);
+    passed = passed && bej_push_finish(&push) == BEJ_OK &&
+             skipped.sets == 1 && skipped.ends == 1 && skipped.sum == 65536 + 64;
+    bej_push_free(&push);
+
+    SaxCounter cut = {0};
+    bej_push_init(&push, main_dictionary, &sax_counter_cb, &cut);
+    passed = passed && bej_push_feed(&push, memory_data, sizeof(memory_data) - 1) == BEJ_OK &&
+             bej_push_finish(&push) == BEJ_ERR_TRUNCATED && cut.sum == 65536 + 64;
+    bej_push_free(&push);
+
+    /* A long string split across chunks is reassembled */
+    char long_value[301];
+    char received[301] = "";
+    memset(long_value, 'x', 300);
+    long_value[300] = '\0';
+    long_value[150] = 'y';
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    size_t root = bej_encode_begin_set(&enc, 0);
+    bej_encode_string(&enc, 3, long_value, 300);
+    bej_encode_end_set(&enc, root);
+
+    BejSaxCallbacks strings = {0};
+    strings.string = push_string;
+    bej_push_init(&push, main_dictionary, &strings, received);
+    for (size_t i = 0; i < enc.len; i += 7)
+        bej_push_feed(&push, enc.buf + i, enc.len - i < 7 ? enc.len - i : 7);
+    passed = passed && bej_push_finish(&push) == BEJ_OK && strcmp(received, long_value) == 0 &&
+             push.buf != NULL;
+
+    /* The buffer survives a reset for the next message */
+    received[0] = '\0';
+    bej_push_reset(&push);
+    passed = passed && push.buf != NULL && bej_push_feed(&push, enc.buf, enc.len) == BEJ_OK &&
+             bej_push_finish(&push) == BEJ_OK && strcmp(received, long_value) == 0;
+    bej_push_free(&push);
+    bej_encoder_free(&enc);
+
+    test_result("push: chunked input", passed);
+}
+
+/* Marks a task as run, the first tasks take longer so others get stolen */
+static void pool_task(void *user, uint32_t worker, size_t task)
+{
+    (void)worker;
+    ((int *)user)[task]++;
+    if (task < 4)
+        usleep(20000);
+}
+
+/* Test work-stealing pool and batch conversion */
+void test_batch_convert()
+{
+    int runs[1000] = {0};
+    BejPoolStats pool;
+    int passed = bej_pool_run(4, 1000, pool_task, runs, &pool) == 0 && pool.workers == 4;
+    for (int i = 0; i < 1000; i++)
+        passed = passed && runs[i] == 1;
+
+    char dir[] = "/tmp/bej_batchXXXXXX";
+    if (!mkdtemp(dir))
+    {
+        test_result("batch: pool and conversion", 0);
+        return;
+    }
+    char paths[3][64];
+    const char *files[3];
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(paths[i], sizeof(paths[i]), "%s/m%d.bin", dir, i);
+        FILE *f = fopen(paths[i], "wb");
+        if (f)
+        {
+            /* The last file is cut short */
+            fwrite(memory_data, 1, i == 2 ? 10 : sizeof(memory_data), f);
+            fclose(f);
+        }
+        files[i] = paths[i];
+    }
+
+    BejBatchOptions options = {2, JSON_COMPACT, dir, -1, main_dictionary};
+    BejBatchStats stats;
+    /* The failed file is reported on stderr */
+    int saved = dup(2);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, 2);
+    passed = passed && bej_batch_run(files, 3, &options, &stats) == BEJ_ERR_IO &&
+             stats.files == 3 && stats.failed == 1 && stats.bytes_in == 2 * sizeof(memory_data) + 10;
+
+    char json[256];
+    char path[96];
+    snprintf(path, sizeof(path), "%s/m1.json", dir);
+    FILE *f = fopen(path, "r");
+    passed = passed && f;
+    if (f)
+    {
+        read_back(f, json, sizeof(json));
+        fclose(f);
+        passed = passed && strcmp(json, "{\"CapacityMiB\":65536,\"DataWidthBits\":64,"
+                                        "\"ErrorCorrection\":\"NoECC\",\"MemoryLocation\":"
+                                        "{\"Channel\":0,\"Slot\":3}}\n") == 0;
+    }
+
+    /* NDJSON: one line per converted file */
+    snprintf(path, sizeof(path), "%s/all.ndjson", dir);
+    FILE *out = fopen(path, "w+");
+    options.ndjson_fd = out ? fileno(out) : -1;
+    passed = passed && out && bej_batch_run(files, 2, &options, &stats) == BEJ_OK;
+    if (out)
+    {
+        char lines[512];
+        read_back(out, lines, sizeof(lines));
+        fclose(out);
+        int count = 0;
+        for (char *p = lines; *p; p++)
+            count += *p == '\n';
+        passed = passed && count == 2 && strstr(lines, "{\"file\":\"") == lines &&
+                 strstr(lines, "\"value\":{\"CapacityMiB\":65536") != NULL;
+    }
+    dup2(saved, 2);
+    close(saved);
+    close(null_fd);
+
+    for (int i = 0; i < 3; i++)
+    {
+        remove(paths[i]);
+        snprintf(path, sizeof(path), "%s/m%d.json", dir, i);
+        remove(path);
+    }
+    snprintf(path, sizeof(path), "%s/all.ndjson", dir);
+    remove(path);
+    rmdir(dir);
+
+    test_result("batch: pool and conversion", passed);
+}
+
+/* Test parallel decoding - same tree and text as the sequential decoders */
+void test_parallel_split()
+{
+    BejEncoder enc;
+    bej_encoder_init(&enc, 0);
+    size_t root = bej_encode_begin_set(&enc, 0);
+    for (uint16_t i = 0; i < 40; i++)
+    {
+        if (i % 4 == 3)
+        {
+            size_t location = bej_encode_begin_set(&enc, 4);
+            bej_encode_integer(&enc, 1, i);
+            bej_encode_integer(&enc, 2, -i);
+            bej_encode_end_set(&enc, location);
+        }
+        else if (i % 4 == 2)
+            bej_encode_string(&enc, 3, "NoECC", 5);
+        else
+            bej_encode_integer(&enc, i % 4 ? 1 : 99, 1000 * i);
+    }
+    bej_encode_end_set(&enc, root);
+
+    BejDictionary *members = bej_dictionary_child(main_dictionary, 0);
+    JsonWriter expected, actual;
+    json_writer_init_buffer(&expected, JSON_PRETTY);
+    json_writer_init_buffer(&actual, JSON_PRETTY);
+    int passed = 1;
+
+    for (int style = 0; style < 2; style++)
+    {
+        expected.pretty = actual.pretty = style == 0;
+        expected.len = actual.len = 0;
+
+        BejDecoder seq, par;
+        bej_decoder_init(&seq, enc.buf, enc.len);
+        bej_decoder_init(&par, enc.buf, enc.len);
+        BejSet *seq_tree = bej_read_value(&seq, main_dictionary);
+        BejSet *par_tree = bej_read_value_parallel(&par, main_dictionary, 4);
+        passed = passed && seq_tree && par_tree && par.cursor == par.end &&
+                 par.stats.values == seq.stats.values &&
+                 par_tree->object_value.count == 40;
+        bej_to_json_writer(seq_tree, members, &expected);
+        bej_to_json_writer(par_tree, members, &actual);
+        passed = passed && expected.len == actual.len &&
+                 memcmp(expected.buf, actual.buf, expected.len) == 0;
+        bej_free(seq_tree);
+        bej_free(par_tree);
+
+        expected.len = actual.len = 0;
+        bej_decoder_init(&seq, enc.buf, enc.len);
+        bej_decoder_init(&par, enc.buf, enc.len);
+        passed = passed && bej_transcode_writer(&seq, main_dictionary, &expected) == BEJ_OK &&
+                 bej_transcode_parallel(&par, main_dictionary, &actual, 3) == BEJ_OK &&
+                 par.cursor == par.end && expected.len == actual.len &&
+                 memcmp(expected.buf, actual.buf, expected.len) == 0;
+    }
+
+    /* A bad member fails the value with the same error as sequentially */
+    enc.buf[enc.len - 4] = 0x0F; /* not a BEJ type */
+    BejDecoder seq, par;
+    bej_decoder_init(&seq, enc.buf, enc.len);
+    bej_decoder_init(&par, enc.buf, enc.len);
+    passed = passed && bej_read_value(&seq, main_dictionary) == NULL &&
+             bej_read_value_parallel(&par, main_dictionary, 4) == NULL &&
+             par.error == seq.error && par.error_offset == seq.error_offset;
+    bej_decoder_init(&par, enc.buf, enc.len);
+    passed = passed && bej_transcode_parallel(&par, main_dictionary, &actual, 4) == BEJ_ERR_TYPE;
+
+    /* Small values are decoded on the calling thread */
+    bej_decoder_init(&par, memory_data, sizeof(memory_data));
+    BejSet *small = bej_read_value_parallel(&par, main_dictionary, 0);
+    passed = passed && small && small->object_value.count == 4 && par.cursor == par.end;
+    bej_free(small);
+
+    json_writer_free(&expected);
+    json_writer_free(&actual);
+    bej_encoder_free(&enc);
+    test_result("parallel: split root members", passed);
+}
+
+/* Test decode cache - repeated payloads are served from the cache */
+void test_decode_cache()
+{
+    BejDecodeCache cache;
+    const char *json;
+    size_t length;
+    const BejSet *tree;
+    int passed = bej_cache_init(&cache, 2, JSON_COMPACT) == 0;
+
+    const char *expected = "{\"CapacityMiB\":65536,\"DataWidthBits\":64,"
+                           "\"ErrorCorrection\":\"NoECC\",\"MemoryLocation\":"
+                           "{\"Channel\":0,\"Slot\":3}}";
+    passed = passed && bej_cache_json(&cache, memory_data, sizeof(memory_data), main_dictionary,
+                                      &json, &length) == BEJ_OK &&
+             length == strlen(expected) && memcmp(json, expected, length) == 0;
+    const char *first = json;
+    uint8_t copy[sizeof(memory_data)];
+    memcpy(copy, memory_data, sizeof(copy));
+    passed = passed && bej_cache_json(&cache, copy, sizeof(copy), main_dictionary, &json, &length) == BEJ_OK &&
+             json == first && bej_cache_tree(&cache, copy, sizeof(copy), main_dictionary, &tree) == BEJ_OK &&
+             tree && tree->object_value.count == 4 &&
+             cache.stats.hits == 2 && cache.stats.misses == 1 && cache.count == 1;
+
+    /* Another dictionary is another key; a third payload evicts the oldest */
+    copy[sizeof(copy) - 1] = 4;
+    passed = passed && bej_cache_tree(&cache, memory_data, sizeof(memory_data), child_dictionary,
+                                      &tree) == BEJ_OK &&
+             bej_cache_tree(&cache, memory_data, sizeof(memory_data), main_dictionary, &tree) == BEJ_OK &&
+             bej_cache_tree(&cache, copy, sizeof(copy), main_dictionary, &tree) == BEJ_OK &&
+             tree->object_value.pairs[3].value->object_value.pairs[1].value->integer_value == 4 &&
+             cache.stats.misses == 3 && cache.stats.evictions == 1 && cache.count == 2;
+    passed = passed && bej_cache_tree(&cache, memory_data, sizeof(memory_data), main_dictionary,
+                                      &tree) == BEJ_OK && cache.stats.hits == 4 &&
+             bej_cache_tree(&cache, memory_data, sizeof(memory_data), child_dictionary, &tree) == BEJ_OK &&
+             cache.stats.misses == 4 && cache.stats.evictions == 2;
+
+    /* Payloads that fail are not kept */
+    passed = passed && bej_cache_json(&cache, memory_data, 10, main_dictionary, &json, &length) ==
+             BEJ_ERR_TRUNCATED && json == NULL && cache.count == 1;
+    bej_cache_clear(&cache);
+    passed = passed && cache.count == 0 && cache.newest == NULL &&
+             bej_cache_hash(memory_data, sizeof(memory_data), 0) != bej_cache_hash(copy, sizeof(copy), 0);
+    bej_cache_destroy(&cache);
+
+    test_result("cache: repeated payloads", passed);
+}
+
+/* Encodes JSON text into a fresh encoder for the diff tests */
+static int diff_encode(BejEncoder *enc, const char *json)
+{
+    bej_encoder_init(enc, 0);
+    return bej_encode_json(enc, json, main_dictionary) == BEJ_OK;
+}
+
+/* Runs bej_diff() on two encoded values */
+static BejError diff_run(const BejEncoder *from, const BejEncoder *to, JsonWriter *w, size_t *operations)
+{
+    BejDecoder a, b;
+    bej_decoder_init(&a, from->buf, from->len);
+    bej_decoder_init(&b, to->buf, to->len);
+    if (w)
+        w->len = 0;
+    return bej_diff(&a, &b, main_dictionary, w, operations);
+}
+
+/* Test structural diff - JSON Patch for the changed members only */
+void test_diff_patch()
+{
+    BejEncoder old_value, new_value, shuffled;
+    int passed = diff_encode(&old_value, "{\"CapacityMiB\": 65536, \"DataWidthBits\": 64,"
+                                         " \"ErrorCorrection\": \"NoECC\","
+                                         " \"MemoryLocation\": {\"Channel\": 0, \"Slot\": 3}}") &&
+                 diff_encode(&new_value, "{\"DataWidthBits\": 64, \"ErrorCorrection\": \"SingleBitECC\","
+                                         " \"MemoryLocation\": {\"Channel\": 0, \"Slot\": 5}}") &&
+                 diff_encode(&shuffled, "{\"MemoryLocation\": {\"Slot\": 3, \"Channel\": 0},"
+                                        " \"ErrorCorrection\": \"NoECC\", \"DataWidthBits\": 64,"
+                                        " \"CapacityMiB\": 65536}");
+
+    JsonWriter w;
+    size_t operations;
+    json_writer_init_buffer(&w, JSON_COMPACT);
+    const char *forward = "[{\"op\":\"remove\",\"path\":\"/CapacityMiB\"},"
+                          "{\"op\":\"replace\",\"path\":\"/ErrorCorrection\",\"value\":\"SingleBitECC\"},"
+                          "{\"op\":\"replace\",\"path\":\"/MemoryLocation/Slot\",\"value\":5}]";
+    passed = passed && diff_run(&old_value, &new_value, &w, &operations) == BEJ_OK && operations == 3 &&
+             w.len == strlen(forward) && memcmp(w.buf, forward, w.len) == 0;
+
+    const char *backward = "{\"op\":\"add\",\"path\":\"/CapacityMiB\",\"value\":65536}";
+    passed = passed && diff_run(&new_value, &old_value, &w, &operations) == BEJ_OK && operations == 3 &&
+             w.len > strlen(backward) && memcmp(w.buf + 1, backward, strlen(backward)) == 0;
+
+    /* Member order does not matter; without a writer only changes are counted */
+    passed = passed && diff_run(&old_value, &shuffled, &w, &operations) == BEJ_OK && operations == 0 &&
+             w.len == 2 && memcmp(w.buf, "[]", 2) == 0 &&
+             diff_run(&shuffled, &new_value, NULL, &operations) == BEJ_OK && operations == 3;
+
+    /* A cut value fails with the error of its decoder */
+    BejDecoder a, b;
+    bej_decoder_init(&a, old_value.buf, old_value.len);
+    bej_decoder_init(&b, new_value.buf, new_value.len - 2);
+    passed = passed && bej_diff(&a, &b, main_dictionary, NULL, NULL) == BEJ_ERR_TRUNCATED &&
+             b.error == BEJ_ERR_TRUNCATED && a.error == BEJ_OK;
+
+    json_writer_free(&w);
+    bej_encoder_free(&old_value);
+    bej_encoder_free(&new_value);
+    bej_encoder_free(&shuffled);
+    test_result("diff: JSON Patch", passed);
+}
+
+/* Test projections - only the selected members are decoded */
+void test_projection()
+{
+    BejDictionary *members = bej_dictionary_child(main_dictionary, 0);
+    const char *paths[] = {"CapacityMiB", "/MemoryLocation/Slot"};
+    const char *expected = "{\"CapacityMiB\":65536,\"MemoryLocation\":{\"Slot\":3}}";
+    BejProjection proj;
+    int passed = bej_projection_compile(&proj, members, paths, 2) == BEJ_OK;
+
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    ctx.projection = &proj;
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
+    passed = passed && root && root->object_value.count == 2 && ctx.stats.values == 4 &&
+             ctx.cursor == ctx.end;
+
+    JsonWriter w;
+    json_writer_init_buffer(&w, JSON_COMPACT);
+    bej_to_json_writer(root, members, &w);
+    passed = passed && w.len == strlen(expected) && memcmp(w.buf, expected, w.len) == 0;
+    bej_free(root);
+
+    /* Same sparse text straight from the transcoder */
+    w.len = 0;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    ctx.projection = &proj;
+    passed = passed && bej_transcode_writer(&ctx, main_dictionary, &w) == BEJ_OK &&
+             w.len == strlen(expected) && memcmp(w.buf, expected, w.len) == 0;
+
+    /* The parallel decoder splits only the selected members */
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    ctx.projection = &proj;
+    root = bej_read_value_parallel(&ctx, main_dictionary, 2);
+    passed = passed && root && root->object_value.count == 2 && ctx.stats.values == 4 &&
+             root->object_value.pairs[1].value->object_value.count == 1;
+    bej_free(root);
+    bej_projection_free(&proj);
+
+    /* "/" keeps everything, bad paths are rejected */
+    const char *everything[] = {"/"};
+    const char *unknown[] = {"Speed"};
+    const char *through_leaf[] = {"ErrorCorrection/Slot"};
+    passed = passed && bej_projection_compile(&proj, members, everything, 1) == BEJ_OK;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    ctx.projection = &proj;
+    root = bej_read_value(&ctx, main_dictionary);
+    passed = passed && root && root->object_value.count == 4 && ctx.stats.values == 7;
+    bej_free(root);
+    bej_projection_free(&proj);
+    passed = passed && bej_projection_compile(&proj, members, unknown, 1) == BEJ_ERR_SCHEMA &&
+             bej_projection_compile(&proj, members, through_leaf, 1) == BEJ_ERR_SCHEMA;
+
+    json_writer_free(&w);
+    test_result("projection: sparse decode", passed);
+}
+
+/* Builds levels SETs around an empty one, 8 bytes per level */
+static uint8_t *build_nested_sets(uint32_t levels, size_t *size)
+{
+    *size = (size_t)levels * 8 + 4;
+    uint8_t *data = malloc(*size);
+    if (!data)
+        return NULL;
+    for (uint32_t i = 0; i < levels; i++)
+    {
+        uint8_t *level = data + (size_t)i * 8;
+        uint32_t rest = (uint32_t)(*size - (size_t)i * 8 - 8);
+        level[0] = 0x01; level[1] = 0x00; level[2] = BEJ_SET; level[3] = 0x04;
+        level[4] = rest & 0xFF; level[5] = (rest >> 8) & 0xFF;
+        level[6] = (rest >> 16) & 0xFF; level[7] = rest >> 24;
+    }
+    uint8_t *inner = data + (size_t)levels * 8;
+    inner[0] = 0x01; inner[1] = 0x00; inner[2] = BEJ_SET; inner[3] = 0x00;
+    return data;
+}
+
+/* Test validation - nesting past BEJ_DECODE_DEPTH fails at the SET too deep */
+void test_validate_depth()
+{
+    size_t size;
+    BejDecoder ctx;
+    uint8_t *data = build_nested_sets(BEJ_DECODE_DEPTH - 1, &size);
+    bej_decoder_init(&ctx, data, size);
+    int passed = data && bej_validate(&ctx) == BEJ_OK && ctx.cursor == ctx.end && ctx.depth == 0;
+    free(data);
+
+    /* One level more, and a depth bomb of 100000 levels */
+    uint32_t levels[] = {BEJ_DECODE_DEPTH, 100000};
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+    {
+        data = build_nested_sets(levels[i], &size);
+        bej_decoder_init(&ctx, data, size);
+        passed = passed && data && bej_validate(&ctx) == BEJ_ERR_LENGTH &&
+                 ctx.error_offset == BEJ_DECODE_DEPTH * 8 + 3;
+        free(data);
+    }
+
+    test_result("validate: nesting depth", passed);
+}
+
+/* Test decoders - nesting past BEJ_DECODE_DEPTH fails as in the validator */
+void test_decode_depth()
+{
+    uint32_t levels[] = {BEJ_DECODE_DEPTH - 1, BEJ_DECODE_DEPTH, 100000};
+    int passed = 1;
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+    {
+        size_t size;
+        uint8_t *data = build_nested_sets(levels[i], &size);
+        if (!data)
+        {
+            passed = 0;
+            break;
+        }
+        BejError expected = levels[i] < BEJ_DECODE_DEPTH ? BEJ_OK : BEJ_ERR_LENGTH;
+        size_t offset = expected == BEJ_OK ? 0 : BEJ_DECODE_DEPTH * 8 + 3;
+        BejDecoder ctx;
+
+        for (uint32_t flags = 0; flags <= BEJ_DECODE_TRUSTED; flags += BEJ_DECODE_TRUSTED)
+        {
+            bej_decoder_init(&ctx, data, size);
+            ctx.flags = flags;
+            BejSet *root = bej_read_value(&ctx, main_dictionary);
+            passed = passed && (root != NULL) == (expected == BEJ_OK) && ctx.error == expected &&
+                     ctx.error_offset == offset && ctx.depth == 0;
+            bej_free(root);
+        }
+
+        JsonWriter w;
+        json_writer_init_buffer(&w, JSON_COMPACT);
+        bej_decoder_init(&ctx, data, size);
+        passed = passed && bej_transcode_writer(&ctx, main_dictionary, &w) == expected &&
+                 ctx.error_offset == offset && ctx.depth == 0;
+        json_writer_free(&w);
+
+        BejTape tape;
+        bej_tape_init(&tape);
+        bej_decoder_init(&ctx, data, size);
+        passed = passed && bej_tape_decode(&ctx, &tape) == expected &&
+                 ctx.error_offset == offset && ctx.depth == 0;
+        bej_tape_free(&tape);
+
+        /* The diff opens every level, the innermost SET becomes a NULL */
+        uint8_t *changed = malloc(size);
+        if (changed)
+        {
+            memcpy(changed, data, size);
+            changed[size - 2] = BEJ_NULL;
+            BejDecoder from, to;
+            bej_decoder_init(&from, data, size);
+            bej_decoder_init(&to, changed, size);
+            BejError error = bej_diff(&from, &to, main_dictionary, NULL, NULL);
+            passed = passed && (levels[i] <= BEJ_DECODE_DEPTH ? error == BEJ_OK :
+                                error == BEJ_ERR_LENGTH && from.error_offset == offset);
+            free(changed);
+        }
+        free(data);
+    }
+
+    test_result("decode: nesting depth", passed);
+}
+
+/* Test validation - same verdict as the decoder, then a trusted decode */
+void test_validate()
+{
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    int passed = bej_validate(&ctx) == BEJ_OK && ctx.cursor == ctx.end;
+
+    /* A trusted decode of the validated bytes gives the same tree */
+    JsonWriter checked, trusted;
+    json_writer_init_buffer(&checked, JSON_COMPACT);
+    json_writer_init_buffer(&trusted, JSON_COMPACT);
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    BejSet *root = bej_read_value(&ctx, main_dictionary);
+    bej_to_json_writer(root, bej_dictionary_child(main_dictionary, 0), &checked);
+    bej_free(root);
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    ctx.flags |= BEJ_DECODE_TRUSTED;
+    root = bej_read_value(&ctx, main_dictionary);
+    bej_to_json_writer(root, bej_dictionary_child(main_dictionary, 0), &trusted);
+    passed = passed && root && ctx.cursor == ctx.end && checked.len == trusted.len &&
+             memcmp(checked.buf, trusted.buf, checked.len) == 0;
+    bej_free(root);
+    json_writer_free(&checked);
+    json_writer_free(&trusted);
+
+    /* Every truncation fails with the decoder's error and offset */
+    for (size_t size = 0; size < sizeof(memory_data); size++)
+    {
+        BejDecoder check;
+        bej_decoder_init(&ctx, memory_data, size);
+        bej_decoder_init(&check, memory_data, size);
+        root = bej_read_value(&check, main_dictionary);
+        passed = passed && !root && bej_validate(&ctx) == check.error &&
+                 ctx.error_offset == check.error_offset;
+    }
+
+    /* Bad type, boolean size, array count, bytes after the elements */
+    uint8_t bad_type[] = {0x01, 0x00, 0x00, 0x01, 0x05, 0x01, 0x02, 0x09, 0x01, 0x00};
+    uint8_t bad_boolean[] = {0x01, 0x02, 0x07, 0x01, 0x02, 0x01, 0x00};
+    uint8_t bad_count[] = {0x01, 0x01, 0x01, 0x01, 0x06, 0x01, 0x05, 0x00, 0x00, 0x00, 0x00};
+    uint8_t extra[] = {0x01, 0x01, 0x01, 0x01, 0x09, 0x01, 0x01, 0x01, 0x00, 0x03, 0x01, 0x01, 0x05, 0x00};
+    bej_decoder_init(&ctx, bad_type, sizeof(bad_type));
+    passed = passed && bej_validate(&ctx) == BEJ_ERR_TYPE && ctx.error_offset == 8;
+    bej_decoder_init(&ctx, bad_boolean, sizeof(bad_boolean));
+    passed = passed && bej_validate(&ctx) == BEJ_ERR_LENGTH && ctx.error_offset == 5;
+    bej_decoder_init(&ctx, bad_count, sizeof(bad_count));
+    passed = passed && bej_validate(&ctx) == BEJ_ERR_TRUNCATED && ctx.error_offset == 7;
+    bej_decoder_init(&ctx, extra, sizeof(extra));
+    passed = passed && bej_validate(&ctx) == BEJ_ERR_LENGTH && ctx.error_offset == 13;
+
+    test_result("validate: agrees with the decoder", passed);
+}
+
 int main() 
 {
     printf("\n=== BEJ Parser Unit Tests ===\n\n");
     
     test_read_integer();
+    test_read_integer_widths();
     test_read_string();
     test_read_value_integer();
     test_read_value_string();
     test_parse_complete_structure();
+    test_parse_nested_set();
+    test_parse_truncated();
+    test_read_value_arena();
+    test_read_value_view();
+    test_map_file();
+    test_sax_parse();
+    test_transcode_json();
+    test_json_itoa();
+    test_json_writer();
     test_dictionary_lookup();
+    test_dictionary_compile();
+    test_dictionary_parse_binary();
+    test_dictionary_cache();
+    test_read_nnint();
+    test_encode_memory();
+    test_encode_backpatch();
+    test_all_types_round_trip();
+    test_all_types_errors();
+    test_all_types_tape_push();
+    test_tape_decode();
+    test_read_object_exact();
+    test_json_scan();
+    test_json_escapes();
+    test_query_path();
+    test_push_chunks();
+    test_batch_convert();
+    test_parallel_split();
+    test_decode_cache();
+    test_diff_patch();
+    test_projection();
+    test_validate();
+    test_validate_depth();
+    test_decode_depth();
     
     printf("\n=== Summary ===\n");
     printf("Passed: %d/%d\n", tests_passed, tests_run);
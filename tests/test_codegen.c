@@ -0,0 +1,134 @@
+/**
+ * @file test_codegen.c
+ * @brief Unit tests for the decoders generated from main_dictionary and
+ *        tests/codegen_names.bin
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../include/bej_parse.h"
+#include "../include/dictionary.h"
+#include "memory_decode.h"
+#include "names_decode.h"
+
+#define TEST_PASS "\033[0;32m[PASS]\033[0m" /*color green*/
+#define TEST_FAIL "\033[0;31m[FAIL]\033[0m" /*color red*/
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+void test_result(const char *test_name, int passed)
+{
+    tests_run++;
+    if (passed)
+    {
+        tests_passed++;
+        printf("%s %s\n", TEST_PASS, test_name);
+    }
+    else
+    {
+        printf("%s %s\n", TEST_FAIL, test_name);
+    }
+}
+
+/* Memory payload, as in test_bej.c */
+static const uint8_t memory_data[] = {
+    0x01, 0x00, 0x00, 0x01, 0x2A,
+    0x01, 0x01, 0x03, 0x01, 0x04, 0x00, 0x00, 0x01, 0x00,
+    0x01, 0x02, 0x03, 0x01, 0x01, 0x40,
+    0x01, 0x03, 0x05, 0x01, 0x05, 'N', 'o', 'E', 'C', 'C',
+    0x01, 0x04, 0x00, 0x01, 0x0C,
+    0x01, 0x01, 0x03, 0x01, 0x01, 0x00,
+    0x01, 0x02, 0x03, 0x01, 0x01, 0x03
+};
+
+/* Test generated decoder - same values as the generic decoder */
+void test_generated_decode()
+{
+    Memory memory;
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    int passed = Memory_decode(&ctx, &memory) == BEJ_OK && ctx.cursor == ctx.end &&
+                 memory.has_CapacityMiB && memory.CapacityMiB == 65536 &&
+                 memory.has_DataWidthBits && memory.DataWidthBits == 64 &&
+                 memory.has_ErrorCorrection && memory.ErrorCorrection_length == 5 &&
+                 memcmp(memory.ErrorCorrection, "NoECC", 5) == 0 &&
+                 memory.has_MemoryLocation && memory.MemoryLocation.has_Channel &&
+                 memory.MemoryLocation.Channel == 0 && memory.MemoryLocation.Slot == 3;
+
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data));
+    BejSet *tree = bej_read_value(&ctx, main_dictionary);
+    passed = passed && tree && tree->object_value.pairs[0].value->integer_value == memory.CapacityMiB;
+    bej_free(tree);
+
+    test_result("codegen: decode into struct", passed);
+}
+
+/* Test generated decoder - absent members, wrong types and cut input */
+void test_generated_errors()
+{
+    Memory memory;
+    BejDecoder ctx;
+
+    uint8_t partial[] = {0x01, 0x00, 0x00, 0x01, 0x06, 0x01, 0x02, 0x03, 0x01, 0x01, 0x08};
+    bej_decoder_init(&ctx, partial, sizeof(partial));
+    int passed = Memory_decode(&ctx, &memory) == BEJ_OK && !memory.has_CapacityMiB &&
+                 memory.has_DataWidthBits && memory.DataWidthBits == 8 && !memory.has_MemoryLocation;
+
+    uint8_t wrong_type[sizeof(memory_data)];
+    memcpy(wrong_type, memory_data, sizeof(wrong_type));
+    wrong_type[7] = 0x05;
+    bej_decoder_init(&ctx, wrong_type, sizeof(wrong_type));
+    passed = passed && Memory_decode(&ctx, &memory) == BEJ_ERR_TYPE && ctx.error_offset == 8;
+
+    bej_decoder_init(&ctx, memory_data, sizeof(memory_data) - 1);
+    passed = passed && Memory_decode(&ctx, &memory) == BEJ_ERR_TRUNCATED;
+
+    uint8_t not_root[] = {0x01, 0x04, 0x00, 0x01, 0x00};
+    bej_decoder_init(&ctx, not_root, sizeof(not_root));
+    passed = passed && Memory_decode(&ctx, &memory) == BEJ_ERR_SCHEMA;
+
+    test_result("codegen: errors", passed);
+}
+
+/* Names payload for tests/codegen_names.bin, whose members are int,
+   Name (STRING), Name_length, X, has_X, switch (SET of Slot), 1st and a*\/b */
+static const uint8_t names_data[] = {
+    0x01, 0x00, 0x00, 0x01, 0x24,
+    0x01, 0x01, 0x03, 0x01, 0x01, 0x05,
+    0x01, 0x02, 0x05, 0x01, 0x02, 'a', 'b',
+    0x01, 0x03, 0x03, 0x01, 0x01, 0x07,
+    0x01, 0x05, 0x03, 0x01, 0x01, 0x09,
+    0x01, 0x06, 0x00, 0x01, 0x06,
+    0x01, 0x01, 0x03, 0x01, 0x01, 0x02
+};
+
+/* Test generated decoder - keywords and clashing names get a '_' appended */
+void test_generated_names()
+{
+    Names names;
+    BejDecoder ctx;
+    bej_decoder_init(&ctx, names_data, sizeof(names_data));
+    int passed = Names_decode(&ctx, &names) == BEJ_OK && ctx.cursor == ctx.end &&
+                 names.has_int_ && names.int_ == 5 &&
+                 names.has_Name && names.Name_length == 2 && memcmp(names.Name, "ab", 2) == 0 &&
+                 names.has_Name_length_ && names.Name_length_ == 7 &&
+                 !names.has_X && names.has_has_X_ && names.has_X_ == 9 &&
+                 names.has_switch_ && names.switch_.has_Slot && names.switch_.Slot == 2 &&
+                 !names.has__1st && !names.has_a__b;
+
+    test_result("codegen: mangled field names", passed);
+}
+
+int main()
+{
+    printf("\n=== Generated Decoder Tests ===\n\n");
+
+    test_generated_decode();
+    test_generated_errors();
+    test_generated_names();
+
+    printf("\n=== Summary ===\n");
+    printf("Passed: %d/%d\n", tests_passed, tests_run);
+    return tests_passed == tests_run ? 0 : 1;
+}
@@ -0,0 +1,667 @@
+/**
+ * @file bej_codegen.c
+ * @brief Generates a BEJ decoder specialized for one schema
+ *
+ * Walks a dictionary and writes a header with one plain C struct per SET
+ * entry and a source file with a decoder per struct. The generated code
+ * switches on the member sequence numbers as constants and checks each
+ * member type against the dictionary, then stores the value straight into
+ * its struct field: no BejSet nodes, no dictionary lookups and no
+ * allocation. Strings are views into the input buffer.
+ *
+ * INTEGER, STRING and SET entries become fields. Other types, and SETs
+ * whose member table is already being generated (the self-referencing
+ * root of main_dictionary), are skipped when decoding.
+ *
+ * Field names are the dictionary names made into C identifiers, with '_'
+ * appended to C keywords and to names whose struct members (the field,
+ * has_<field>, <field>_length) would repeat those of an earlier field.
+ * Type and reader names that still clash, such as a SET named "read",
+ * stop the generator with an error.
+ *
+ * Usage: bej_codegen [--dict FILE] [--name NAME] OUT_DIR
+ *   --dict  DSP0218 binary dictionary, the built-in main_dictionary by default
+ *   --name  Name of the root struct, the schema entry name by default
+ *
+ * Writes OUT_DIR/<name>_decode.h and OUT_DIR/<name>_decode.c, with the
+ * name in lower case.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/dictionary.h"
+#include "../include/dictionary_loader.h"
+
+#define CODEGEN_NAME_SIZE 256
+#define CODEGEN_MEMBER_SIZE (CODEGEN_NAME_SIZE + 8)
+#define CODEGEN_TYPE_SIZE (2 * CODEGEN_NAME_SIZE)
+#define CODEGEN_PATH_SIZE 4096
+#define CODEGEN_DEPTH 32
+
+/*member tables of the SETs being generated, to stop at cycles*/
+typedef struct CodegenStack
+{
+  const BejDictionary *tables[CODEGEN_DEPTH];
+  int depth;
+} CodegenStack;
+
+/*field name of each member of a SET, empty for members without a field*/
+typedef char CodegenName[CODEGEN_NAME_SIZE];
+
+/*file-scope name of the generated code and the entry it comes from*/
+typedef struct CodegenSymbol
+{
+  char name[CODEGEN_TYPE_SIZE + 8];
+  const char *entry;
+} CodegenSymbol;
+
+typedef struct CodegenSymbols
+{
+  CodegenSymbol *items;
+  size_t count;
+  size_t cap;
+} CodegenSymbols;
+
+/*C keywords, GNU C ones included, and the lower-case macros of the
+  headers the generated code includes*/
+static const char *const codegen_reserved[] = {
+  "asm", "auto", "break", "case", "char", "const", "continue", "default",
+  "do", "double", "else", "enum", "extern", "float", "for", "goto", "if",
+  "inline", "int", "long", "register", "restrict", "return", "short",
+  "signed", "sizeof", "static", "struct", "switch", "typedef", "typeof",
+  "union", "unsigned", "void", "volatile", "while", "_Alignas", "_Alignof",
+  "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary", "_Noreturn",
+  "_Static_assert", "_Thread_local", "offsetof", "stderr", "stdin", "stdout"
+};
+
+/**
+ * @brief Turns a dictionary name into a C identifier
+ *
+ * Characters other than letters, digits and '_' become '_', a leading
+ * digit gets a '_' in front and an empty name becomes "_".
+ *
+ * @param out Buffer of CODEGEN_NAME_SIZE bytes
+ * @param name Dictionary name
+ */
+static void codegen_identifier(char *out, const char *name)
+{
+  size_t n = 0;
+  if (isdigit((unsigned char)name[0]) || name[0] == '\0')
+    out[n++] = '_';
+  for (const char *c = name; *c && n < CODEGEN_NAME_SIZE - 1; c++)
+    out[n++] = isalnum((unsigned char)*c) ? *c : '_';
+  out[n] = '\0';
+}
+
+/**
+ * @brief Tells whether an identifier is a C keyword or a standard macro
+ *
+ * @param name Identifier
+ * @return 1 if reserved, 0 otherwise
+ */
+static int codegen_is_reserved(const char *name)
+{
+  for (size_t i = 0; i < sizeof(codegen_reserved) / sizeof(codegen_reserved[0]); i++)
+  {
+    if (strcmp(codegen_reserved[i], name) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Appends '_' to an identifier
+ *
+ * @param name Identifier, CODEGEN_NAME_SIZE bytes
+ * @return 0 on success, -1 if the buffer is full
+ */
+static int codegen_mangle(char *name)
+{
+  size_t n = strlen(name);
+  if (n == CODEGEN_NAME_SIZE - 1)
+    return -1;
+  name[n] = '_';
+  name[n + 1] = '\0';
+  return 0;
+}
+
+/**
+ * @brief Tells whether a member gets a field in the struct
+ *
+ * @param entry Dictionary entry of the member
+ * @param stack SETs being generated
+ * @return 1 for a field, 0 if the member is skipped
+ */
+static int codegen_has_field(const BejDictionary *entry, const CodegenStack *stack)
+{
+  if (entry->type == BEJ_INTEGER || entry->type == BEJ_STRING)
+    return 1;
+  if (entry->type != BEJ_SET)
+    return 0;
+  if (stack->depth == CODEGEN_DEPTH)
+    return 0;
+  for (int i = 0; i < stack->depth; i++)
+  {
+    if (stack->tables[i] == entry->children)
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Lists the struct members a field adds
+ *
+ * @param field Field name
+ * @param type Member type
+ * @param out Receives the field, has_<field> and, for a STRING, <field>_length
+ * @return Number of members
+ */
+static size_t codegen_members(const char *field, BejType type, char out[3][CODEGEN_MEMBER_SIZE])
+{
+  snprintf(out[0], CODEGEN_MEMBER_SIZE, "%s", field);
+  snprintf(out[1], CODEGEN_MEMBER_SIZE, "has_%s", field);
+  if (type != BEJ_STRING)
+    return 2;
+  snprintf(out[2], CODEGEN_MEMBER_SIZE, "%s_length", field);
+  return 3;
+}
+
+/**
+ * @brief Tells whether a field name is a keyword or repeats a struct member
+ *
+ * @param fields Field names picked so far
+ * @param members Member table of the SET
+ * @param index Member whose name is checked against the earlier ones
+ * @return 1 on a clash, 0 otherwise
+ */
+static int codegen_field_clashes(CodegenName *fields, const BejDictionary *members, size_t index)
+{
+  char mine[3][CODEGEN_MEMBER_SIZE];
+  char other[3][CODEGEN_MEMBER_SIZE];
+  if (codegen_is_reserved(fields[index]))
+    return 1;
+
+  size_t n = codegen_members(fields[index], members[index].type, mine);
+  for (size_t i = 0; i < index; i++)
+  {
+    if (fields[i][0] == '\0')
+      continue;
+    size_t m = codegen_members(fields[i], members[i].type, other);
+    for (size_t a = 0; a < n; a++)
+    {
+      for (size_t b = 0; b < m; b++)
+      {
+        if (strcmp(mine[a], other[b]) == 0)
+          return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Picks the field names of a SET
+ *
+ * Each name is the C identifier of the dictionary name, with '_' appended
+ * while it is reserved or clashes with an earlier field. The struct and
+ * the reader both use these names.
+ *
+ * @param members Member table of the SET
+ * @param stack SETs being generated
+ * @return One name per member, free() it; NULL on error
+ */
+static CodegenName *codegen_fields(const BejDictionary *members, const CodegenStack *stack)
+{
+  size_t count = 0;
+  while (members && members[count].name)
+    count++;
+
+  CodegenName *fields = calloc(count ? count : 1, sizeof(CodegenName));
+  if (!fields)
+  {
+    fprintf(stderr, "Out of memory\n");
+    return NULL;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    if (!codegen_has_field(&members[i], stack))
+      continue;
+    codegen_identifier(fields[i], members[i].name);
+    while (codegen_field_clashes(fields, members, i))
+    {
+      if (codegen_mangle(fields[i]) != 0)
+      {
+        fprintf(stderr, "%s: no unique field name\n", members[i].name);
+        free(fields);
+        return NULL;
+      }
+    }
+  }
+  return fields;
+}
+
+/**
+ * @brief Records a file-scope name of the generated code
+ *
+ * @param symbols Names so far
+ * @param entry Dictionary entry the name comes from
+ * @param format printf format of the name
+ * @param type Struct name
+ * @return 0 on success, -1 on allocation failure
+ */
+static int codegen_symbol(CodegenSymbols *symbols, const char *entry, const char *format, const char *type)
+{
+  if (symbols->count == symbols->cap)
+  {
+    size_t cap = symbols->cap ? symbols->cap * 2 : 64;
+    CodegenSymbol *items = realloc(symbols->items, sizeof(CodegenSymbol) * cap);
+    if (!items)
+    {
+      fprintf(stderr, "Out of memory\n");
+      return -1;
+    }
+    symbols->items = items;
+    symbols->cap = cap;
+  }
+
+  CodegenSymbol *symbol = &symbols->items[symbols->count++];
+  snprintf(symbol->name, sizeof(symbol->name), format, type);
+  symbol->entry = entry;
+  return 0;
+}
+
+/**
+ * @brief Collects the struct and reader names of a SET and its members
+ *
+ * @param symbols Names so far
+ * @param type Struct name
+ * @param set Dictionary entry of the SET
+ * @param stack SETs being generated
+ * @return 0 on success, -1 on error
+ */
+static int codegen_types(CodegenSymbols *symbols, const char *type, const BejDictionary *set, CodegenStack *stack)
+{
+  if (codegen_symbol(symbols, set->name, "%s", type) != 0 ||
+      codegen_symbol(symbols, set->name, "%s_read", type) != 0)
+    return -1;
+
+  const BejDictionary *members = set->children;
+  stack->tables[stack->depth++] = members;
+  CodegenName *fields = codegen_fields(members, stack);
+  if (!fields)
+  {
+    stack->depth--;
+    return -1;
+  }
+
+  int result = 0;
+  for (size_t i = 0; result == 0 && members && members[i].name; i++)
+  {
+    if (members[i].type != BEJ_SET || fields[i][0] == '\0')
+      continue;
+    char nested[CODEGEN_TYPE_SIZE];
+    snprintf(nested, sizeof(nested), "%s_%s", type, fields[i]);
+    result = codegen_types(symbols, nested, &members[i], stack);
+  }
+
+  stack->depth--;
+  free(fields);
+  return result;
+}
+
+static int codegen_symbol_compare(const void *a, const void *b)
+{
+  return strcmp(((const CodegenSymbol *)a)->name, ((const CodegenSymbol *)b)->name);
+}
+
+/**
+ * @brief Checks that the generated structs and functions have distinct names
+ *
+ * @param name Root struct name
+ * @param root Schema entry, a SET
+ * @return 0 if the names are distinct, -1 otherwise
+ */
+static int codegen_check(const char *name, const BejDictionary *root)
+{
+  CodegenSymbols symbols = {NULL, 0, 0};
+  CodegenStack stack;
+  stack.depth = 0;
+
+  int result = codegen_symbol(&symbols, root->name, "%s_decode", name);
+  if (result == 0)
+    result = codegen_types(&symbols, name, root, &stack);
+  if (result == 0)
+  {
+    qsort(symbols.items, symbols.count, sizeof(CodegenSymbol), codegen_symbol_compare);
+    for (size_t i = 1; i < symbols.count; i++)
+    {
+      if (strcmp(symbols.items[i - 1].name, symbols.items[i].name) == 0)
+      {
+        fprintf(stderr, "%s, %s: both generate %s\n", symbols.items[i - 1].entry,
+                symbols.items[i].entry, symbols.items[i].name);
+        result = -1;
+      }
+    }
+  }
+  free(symbols.items);
+  return result;
+}
+
+/**
+ * @brief Writes a dictionary name into a comment
+ *
+ * A space goes between '*' and '/' so the name cannot end the comment or
+ * open another one.
+ *
+ * @param f File being written
+ * @param name Dictionary name
+ */
+static void codegen_comment(FILE *f, const char *name)
+{
+  for (const char *c = name; *c; c++)
+  {
+    fputc(*c, f);
+    if ((c[0] == '*' && c[1] == '/') || (c[0] == '/' && c[1] == '*'))
+      fputc(' ', f);
+  }
+}
+
+/**
+ * @brief Writes the struct of a SET and, before it, the structs of its members
+ *
+ * @param h Header being written
+ * @param type Struct name
+ * @param members Member table of the SET
+ * @param stack SETs being generated
+ * @return 0 on success, -1 on allocation failure
+ */
+static int codegen_struct(FILE *h, const char *type, const BejDictionary *members, CodegenStack *stack)
+{
+  stack->tables[stack->depth++] = members;
+  CodegenName *fields = codegen_fields(members, stack);
+  if (!fields)
+  {
+    stack->depth--;
+    return -1;
+  }
+
+  int result = 0;
+  for (size_t i = 0; result == 0 && members && members[i].name; i++)
+  {
+    if (members[i].type != BEJ_SET || fields[i][0] == '\0')
+      continue;
+    char nested[CODEGEN_TYPE_SIZE];
+    snprintf(nested, sizeof(nested), "%s_%s", type, fields[i]);
+    result = codegen_struct(h, nested, members[i].children, stack);
+  }
+
+  fprintf(h, "typedef struct %s\n{\n", type);
+  int count = 0;
+  for (size_t i = 0; members && members[i].name; i++)
+  {
+    const char *field = fields[i];
+    if (field[0] == '\0')
+      continue;
+    if (members[i].type == BEJ_INTEGER)
+      fprintf(h, "  int64_t %s;\n", field);
+    else if (members[i].type == BEJ_STRING)
+      fprintf(h, "  const char *%s; /*view into the input, not terminated*/\n  uint32_t %s_length;\n",
+              field, field);
+    else
+      fprintf(h, "  %s_%s %s;\n", type, field, field);
+    count++;
+  }
+  for (size_t i = 0; members && members[i].name; i++)
+  {
+    if (fields[i][0] != '\0')
+      fprintf(h, "  uint8_t has_%s;\n", fields[i]);
+  }
+  if (count == 0)
+    fprintf(h, "  uint8_t unused;\n");
+  fprintf(h, "} %s;\n\n", type);
+
+  stack->depth--;
+  free(fields);
+  return result;
+}
+
+/**
+ * @brief Writes the reader of a SET and, before it, the readers of its members
+ *
+ * The reader expects the cursor at the SET length. Members not in the
+ * dictionary, or without a field, are stepped over by their length.
+ *
+ * @param c Source being written
+ * @param type Struct name
+ * @param members Member table of the SET
+ * @param stack SETs being generated
+ * @return 0 on success, -1 on allocation failure
+ */
+static int codegen_reader(FILE *c, const char *type, const BejDictionary *members, CodegenStack *stack)
+{
+  stack->tables[stack->depth++] = members;
+  CodegenName *fields = codegen_fields(members, stack);
+  if (!fields)
+  {
+    stack->depth--;
+    return -1;
+  }
+
+  int result = 0;
+  for (size_t i = 0; result == 0 && members && members[i].name; i++)
+  {
+    if (members[i].type != BEJ_SET || fields[i][0] == '\0')
+      continue;
+    char nested[CODEGEN_TYPE_SIZE];
+    snprintf(nested, sizeof(nested), "%s_%s", type, fields[i]);
+    result = codegen_reader(c, nested, members[i].children, stack);
+  }
+
+  fprintf(c, "static int %s_read(BejDecoder *ctx, %s *out)\n{\n", type, type);
+  fprintf(c, "  uint32_t length;\n"
+             "  if (!bej_read_length(ctx, &length))\n"
+             "    return 0;\n\n"
+             "  const uint8_t *outer_end = ctx->end;\n"
+             "  ctx->end = ctx->cursor + length;\n"
+             "  while (ctx->error == BEJ_OK && ctx->cursor < ctx->end)\n"
+             "  {\n"
+             "    uint16_t id;\n"
+             "    uint8_t type;\n"
+             "    uint32_t size;\n"
+             "    if (!bej_read_tag(ctx, &id, &type))\n"
+             "      break;\n\n"
+             "    switch (id)\n"
+             "    {\n");
+
+  for (size_t i = 0; members && members[i].name; i++)
+  {
+    const BejDictionary *entry = &members[i];
+    const char *field = fields[i];
+    if (field[0] == '\0')
+      continue;
+    const char *type_name = entry->type == BEJ_INTEGER ? "BEJ_INTEGER"
+                            : entry->type == BEJ_STRING ? "BEJ_STRING" : "BEJ_SET";
+
+    fprintf(c, "      case %u: /*", entry->id);
+    codegen_comment(c, entry->name);
+    fprintf(c, "*/\n");
+    fprintf(c, "        if (type != %s)\n"
+               "          bej_decoder_fail(ctx, BEJ_ERR_TYPE);\n", type_name);
+    if (entry->type == BEJ_INTEGER)
+      fprintf(c, "        else\n"
+                 "        {\n"
+                 "          out->%s = bej_read_integer(ctx);\n"
+                 "          out->has_%s = ctx->error == BEJ_OK;\n"
+                 "        }\n", field, field);
+    else if (entry->type == BEJ_STRING)
+      fprintf(c, "        else if (bej_read_length(ctx, &size))\n"
+                 "        {\n"
+                 "          out->%s = (const char *)ctx->cursor;\n"
+                 "          out->%s_length = size;\n"
+                 "          out->has_%s = 1;\n"
+                 "          ctx->cursor += size;\n"
+                 "        }\n", field, field, field);
+    else
+      fprintf(c, "        else\n"
+                 "          out->has_%s = %s_%s_read(ctx, &out->%s);\n", field, type, field, field);
+    fprintf(c, "        break;\n\n");
+  }
+
+  fprintf(c, "      default:\n"
+             "        if (bej_read_length(ctx, &size))\n"
+             "          ctx->cursor += size;\n"
+             "        break;\n"
+             "    }\n"
+             "  }\n"
+             "  ctx->end = outer_end;\n"
+             "  return ctx->error == BEJ_OK;\n"
+             "}\n\n");
+
+  stack->depth--;
+  free(fields);
+  return result;
+}
+
+/**
+ * @brief Writes the header and the source of a decoder
+ *
+ * @param dir Output directory
+ * @param name Root struct name
+ * @param root Schema entry, a SET
+ * @return 0 on success, -1 if a file cannot be written or on allocation failure
+ */
+static int codegen_write(const char *dir, const char *name, const BejDictionary *root)
+{
+  char base[CODEGEN_NAME_SIZE];
+  char guard[CODEGEN_NAME_SIZE];
+  char path[CODEGEN_PATH_SIZE];
+  size_t n;
+  for (n = 0; name[n] && n < CODEGEN_NAME_SIZE - 1; n++)
+  {
+    base[n] = (char)tolower((unsigned char)name[n]);
+    guard[n] = (char)toupper((unsigned char)name[n]);
+  }
+  base[n] = '\0';
+  guard[n] = '\0';
+
+  snprintf(path, sizeof(path), "%s/%s_decode.h", dir, base);
+  FILE *h = fopen(path, "w");
+  snprintf(path, sizeof(path), "%s/%s_decode.c", dir, base);
+  FILE *c = fopen(path, "w");
+  if (!h || !c)
+  {
+    if (h) fclose(h);
+    if (c) fclose(c);
+    return -1;
+  }
+
+  CodegenStack stack;
+  stack.depth = 0;
+
+  fprintf(h, "/* Generated by bej_codegen from the \"");
+  codegen_comment(h, root->name);
+  fprintf(h, "\" dictionary, do not edit */\n\n");
+  fprintf(h, "#ifndef %s_DECODE_H\n#define %s_DECODE_H\n\n#include \"bej_parse.h\"\n\n", guard, guard);
+  int failed = codegen_struct(h, name, root->children, &stack);
+  fprintf(h, "BejError %s_decode(BejDecoder *ctx, %s *out);\n\n#endif\n", name, name);
+
+  fprintf(c, "/* Generated by bej_codegen from the \"");
+  codegen_comment(c, root->name);
+  fprintf(c, "\" dictionary, do not edit */\n\n");
+  fprintf(c, "#include <string.h>\n#include \"%s_decode.h\"\n\n", base);
+  failed |= codegen_reader(c, name, root->children, &stack);
+  fprintf(c, "/**\n"
+             " * @brief Decodes a ");
+  codegen_comment(c, root->name);
+  fprintf(c, " value into its struct\n"
+             " *\n"
+             " * @param ctx Decoder context, the cursor must be at the value ID\n"
+             " * @param out Struct to fill, members absent from the payload have has_ 0\n"
+             " * @return BEJ_OK, BEJ_ERR_SCHEMA if the value is not the ");
+  codegen_comment(c, root->name);
+  fprintf(c, " entry,\n"
+             " *         BEJ_ERR_TYPE if a member has another type than in the\n"
+             " *         dictionary, otherwise the decoding error\n"
+             " */\n");
+  fprintf(c, "BejError %s_decode(BejDecoder *ctx, %s *out)\n"
+             "{\n"
+             "  uint16_t id;\n"
+             "  uint8_t type;\n"
+             "  memset(out, 0, sizeof(*out));\n"
+             "  if (!bej_read_tag(ctx, &id, &type))\n"
+             "    return ctx->error;\n"
+             "  if (id != %u || type != BEJ_SET)\n"
+             "    bej_decoder_fail(ctx, BEJ_ERR_SCHEMA);\n"
+             "  else\n"
+             "    %s_read(ctx, out);\n"
+             "  return ctx->error;\n"
+             "}\n", name, name, root->id, name);
+
+  failed |= ferror(h) || ferror(c);
+  failed |= fclose(h) != 0;
+  failed |= fclose(c) != 0;
+  return failed ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *dict_file = NULL;
+  const char *name = NULL;
+  const char *dir = NULL;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--dict") == 0 && i + 1 < argc)
+      dict_file = argv[++i];
+    else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+      name = argv[++i];
+    else if (!dir)
+      dir = argv[i];
+    else
+    {
+      fprintf(stderr, "usage: %s [--dict FILE] [--name NAME] OUT_DIR\n", argv[0]);
+      return 2;
+    }
+  }
+  if (!dir)
+  {
+    fprintf(stderr, "usage: %s [--dict FILE] [--name NAME] OUT_DIR\n", argv[0]);
+    return 2;
+  }
+
+  BejSchemaDictionary schema;
+  const BejDictionary *root = main_dictionary;
+  if (dict_file)
+  {
+    BejError error = bej_dictionary_load(dict_file, &schema);
+    if (error != BEJ_OK)
+    {
+      fprintf(stderr, "%s: cannot load dictionary, %s\n", dict_file, bej_error_string(error));
+      return 1;
+    }
+    root = schema.root;
+  }
+  if (root->type != BEJ_SET)
+  {
+    fprintf(stderr, "schema entry %s is not a SET\n", root->name);
+    return 1;
+  }
+
+  char identifier[CODEGEN_NAME_SIZE];
+  codegen_identifier(identifier, name ? name : root->name);
+  if (codegen_is_reserved(identifier))
+    codegen_mangle(identifier);
+  int failed = codegen_check(identifier, root);
+  if (!failed)
+  {
+    failed = codegen_write(dir, identifier, root);
+    if (failed)
+      fprintf(stderr, "%s: cannot write the decoder\n", dir);
+  }
+
+  if (dict_file)
+    bej_dictionary_unload(&schema);
+  return failed ? 1 : 0;
+}